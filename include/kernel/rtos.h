@@ -1,8 +1,7 @@
 #ifndef RTOS_H
 #define RTOS_H
 
-#include "types.h"
-#include "process.h"
+#include "kronos.h"
 
 /* RTOS Configuration */
 #define RTOS_MAX_RT_PRIORITY    99      /* Real-time priority range: 0-99 */
@@ -35,6 +34,19 @@ struct rtos_timing_stats {
     u32 missed_deadlines;               /* Missed real-time deadlines */
 };
 
+/* Periodic task response times (release to job completion) */
+struct rtos_periodic_stats {
+    u32 pid;                            /* Thread running the jobs */
+    u32 period_ms;
+    u64 releases;                       /* Jobs released */
+    u64 completed;                      /* Jobs finished */
+    u64 overruns;                       /* Releases dropped while a job was pending */
+    u64 min_response_us;
+    u64 avg_response_us;
+    u64 max_response_us;
+    u64 max_start_delay_us;             /* Release to job start */
+};
+
 /* RTOS Task Control Block Extensions */
 struct rtos_task_info {
     u32 period_ms;                      /* Task period in milliseconds */
@@ -46,18 +58,38 @@ struct rtos_task_info {
 };
 
 /* RTOS Memory Pool for Real-Time Allocation */
+#define RTOS_MAX_POOLS          16
+
 struct rtos_memory_pool {
     void* pool_start;                   /* Start of memory pool */
     u32 block_size;                     /* Size of each block */
+    u32 stride;                         /* Block plus guard words, 16-byte aligned */
     u32 total_blocks;                   /* Total number of blocks */
-    u32 free_blocks;                    /* Number of free blocks */
-    u8* allocation_bitmap;              /* Bitmap for block allocation */
+    volatile u32 free_blocks;           /* Number of free blocks */
+    volatile u64 free_head;             /* Free list head: tag << 32 | (index + 1), 0 = empty */
+    volatile u64* allocated;            /* Bit per block, set while handed out */
+    volatile u32 high_water;            /* Most blocks in use at once */
+    volatile u32 guard_violations;      /* Overwritten guard words seen on alloc/free */
+    volatile u32 failed_allocs;         /* Allocations that found the pool empty */
+    bool guard_words;                   /* Guard word before and after each block */
     bool initialized;                   /* Pool initialization status */
 };
 
+struct rtos_pool_stats {
+    u32 block_size;
+    u32 total_blocks;
+    u32 free_blocks;
+    u32 high_water;
+    u32 failed_allocs;
+    u32 guard_violations;
+};
+
 /* RTOS Mutex with Priority Inheritance */
+#define RTOS_MAX_MUTEXES        64
+#define RTOS_MUTEX_HAS_WAITERS  0x80000000  /* owner_pid flag: unlock must hand over */
+
 struct rtos_mutex {
-    u32 owner_pid;                      /* Process ID of current owner */
+    volatile u32 owner_pid;             /* Owner PID | HAS_WAITERS, 0 when free (lock word) */
     u32 original_priority;              /* Original priority of owner */
     u32 inherited_priority;             /* Inherited priority */
     bool priority_inherited;            /* Priority inheritance active */
@@ -65,15 +97,22 @@ struct rtos_mutex {
     u32 waiting_count;                  /* Number of waiting processes */
     bool recursive;                     /* Allow recursive locking */
     u32 lock_count;                     /* Recursive lock count */
+    bool in_use;
 };
 
 /* RTOS Event Flags */
+#define RTOS_MAX_EVENT_GROUPS   32
+
 struct rtos_event_flags {
     u32 flags;                          /* Current flag state */
-    struct process* waiting_processes[32]; /* Processes waiting for events */
+    struct process* waiting_processes[32]; /* Processes waiting for events, by slot */
     u32 wait_conditions[32];            /* Wait conditions for each process */
+    u32 bit_waiters[32];                /* Per flag bit: slots waiting on that bit */
+    u32 wait_all_slots;                 /* Slots that need every bit of their condition */
+    u32 used_slots;
     u32 waiting_count;                  /* Number of waiting processes */
     bool auto_clear;                    /* Auto-clear flags on wait */
+    bool in_use;
 };
 
 /* Function Declarations */
@@ -86,9 +125,10 @@ struct process* rtos_schedule_next(void);
 
 /* Real-Time Task Management */
 i32 rtos_set_realtime_priority(u32 pid, u32 priority);
-i32 rtos_create_periodic_task(void (*task_func)(void), u32 period_ms, u32 priority);
+i32 rtos_create_periodic_task(void (*task_func)(void), u32 period_ms, u32 wcet_us);
 i32 rtos_register_periodic_task(void (*task_func)(void), u32 period_ms, u32 priority);
 void rtos_execute_periodic_tasks(void);
+i32 rtos_get_periodic_stats(i32 task_id, struct rtos_periodic_stats* stats);
 i32 rtos_set_deadline(u32 pid, u32 deadline_ms);
 i32 rtos_monitor_deadline(u32 pid, bool enable);
 
@@ -120,12 +160,16 @@ i32 rtos_event_set(i32 event_id, u32 flags);
 i32 rtos_event_clear(i32 event_id, u32 flags);
 i32 rtos_event_wait(i32 event_id, u32 flags, bool wait_all, u32 timeout_ms);
 i32 rtos_event_destroy(i32 event_id);
+i32 rtos_event_set_auto_clear(i32 event_id, bool enabled);
+u32 rtos_event_get(i32 event_id);
 
 /* Memory Management */
 i32 rtos_pool_create(u32 block_size, u32 num_blocks);
+i32 rtos_pool_create_guarded(u32 block_size, u32 num_blocks);
 void* rtos_pool_alloc(i32 pool_id);
 i32 rtos_pool_free(i32 pool_id, void* ptr);
 i32 rtos_pool_destroy(i32 pool_id);
+i32 rtos_pool_get_stats(i32 pool_id, struct rtos_pool_stats* stats);
 
 /* Deadline Monitoring */
 void rtos_deadline_monitor_init(void);
@@ -175,6 +219,7 @@ void rtos_set_max_scheduling_latency(u32 microseconds);
 #define RTOS_NO_MEMORY          -4
 #define RTOS_DEADLINE_MISSED    -5
 #define RTOS_PRIORITY_INVALID   -6
+#define RTOS_INTERRUPTED        -7  /* Wait ended by a signal */
 
 /* RTOS Assert Macro for Debug Builds */
 #ifdef RTOS_DEBUG
@@ -21,6 +21,7 @@
 
 /* Global variables for demo */
 static u32 task_counters[3] = {0, 0, 0};
+static i32 task_ids[3] = {-1, -1, -1};
 static i32 demo_semaphore;
 static i32 demo_mutex;
 static i32 demo_event_flags;
@@ -47,7 +48,7 @@ void high_priority_task(void) {
     
     /* Display status every 50 executions */
     if (execution_count % 50 == 0) {
-        vga_printf("High Priority Task: %u executions, sensor: %u\n", 
+        vga_printf("High Priority Task: %d executions, sensor: %d\n", 
                    execution_count, sensor_data);
     }
 }
@@ -63,7 +64,7 @@ void medium_priority_task(void) {
     
     if (result == RTOS_OK) {
         /* Process the event */
-        vga_printf("Medium Priority Task: Received event (exec: %u)\n", execution_count);
+        vga_printf("Medium Priority Task: Received event (exec: %d)\n", execution_count);
         
         /* Clear the event flag */
         rtos_event_clear(demo_event_flags, 0x01);
@@ -89,7 +90,7 @@ void low_priority_task(void) {
     /* Acquire semaphore for resource access */
     if (rtos_sem_wait_timeout(demo_semaphore, 500) == RTOS_OK) {
         /* Simulate background processing */
-        vga_printf("Low Priority Task: Processing background work (exec: %u)\n", execution_count);
+        vga_printf("Low Priority Task: Processing background work (exec: %d)\n", execution_count);
         
         /* Simulate longer processing time */
         rtos_delay_ms(50);
@@ -112,14 +113,14 @@ void display_task_statistics(void) {
     rtos_get_timing_stats(&timing_stats);
     
     vga_puts("\n=== RTOS Task Statistics ===\n");
-    vga_printf("System Ticks: %llu\n", timing_stats.system_ticks);
-    vga_printf("High Priority Task Executions: %u\n", task_counters[0]);
-    vga_printf("Medium Priority Task Executions: %u\n", task_counters[1]);
-    vga_printf("Low Priority Task Executions: %u\n", task_counters[2]);
-    vga_printf("Max Interrupt Latency: %u us\n", timing_stats.max_interrupt_latency_us);
-    vga_printf("Max Scheduling Latency: %u us\n", timing_stats.max_scheduling_latency_us);
-    vga_printf("Active Timeouts: %u\n", timing_stats.active_timeouts);
-    vga_printf("RT Processes Ready: %u\n", timing_stats.rt_processes_ready);
+    vga_printf("System Ticks: %d\n", (u32)timing_stats.system_ticks);
+    vga_printf("High Priority Task Executions: %d\n", task_counters[0]);
+    vga_printf("Medium Priority Task Executions: %d\n", task_counters[1]);
+    vga_printf("Low Priority Task Executions: %d\n", task_counters[2]);
+    vga_printf("Max Interrupt Latency: %d us\n", timing_stats.max_interrupt_latency_us);
+    vga_printf("Max Scheduling Latency: %d us\n", timing_stats.max_scheduling_latency_us);
+    vga_printf("Active Timeouts: %d\n", timing_stats.active_timeouts);
+    vga_printf("RT Processes Ready: %d\n", timing_stats.rt_processes_ready);
     vga_printf("Preemption: %s\n", timing_stats.preemption_enabled ? "Enabled" : "Disabled");
     vga_puts("============================\n\n");
 }
@@ -133,13 +134,13 @@ void deadline_monitor_task(void) {
     for (u32 pid = 1; pid < 32; pid++) {
         i32 deadline_status = rtos_deadline_check(pid);
         if (deadline_status == RTOS_DEADLINE_MISSED) {
-            vga_printf("WARNING: Deadline missed for PID %u\n", pid);
+            vga_printf("WARNING: Deadline missed for PID %d\n", pid);
         }
     }
     
     /* Display deadline monitoring status */
     if (check_count % 20 == 0) {
-        vga_printf("Deadline Monitor: %u checks completed\n", check_count);
+        vga_printf("Deadline Monitor: %d checks completed\n", check_count);
     }
 }
 
@@ -153,7 +154,7 @@ void performance_monitor_task(void) {
     rtos_get_cpu_utilization(&cpu_utilization);
     
     /* Display performance metrics */
-    vga_printf("Performance Monitor: CPU Utilization: %u%%\n", cpu_utilization);
+    vga_printf("Performance Monitor: CPU Utilization: %d%%\n", cpu_utilization);
     
     /* Check for system overload */
     if (cpu_utilization > 90) {
@@ -176,9 +177,9 @@ void rtos_demo_init(void) {
     }
     
     /* Register periodic real-time tasks */
-    i32 task1 = rtos_register_periodic_task(high_priority_task, FAST_TASK_PERIOD, HIGH_PRIORITY_TASK);
-    i32 task2 = rtos_register_periodic_task(medium_priority_task, MEDIUM_TASK_PERIOD, MEDIUM_PRIORITY_TASK);
-    i32 task3 = rtos_register_periodic_task(low_priority_task, SLOW_TASK_PERIOD, LOW_PRIORITY_TASK);
+    i32 task1 = task_ids[0] = rtos_register_periodic_task(high_priority_task, FAST_TASK_PERIOD, HIGH_PRIORITY_TASK);
+    i32 task2 = task_ids[1] = rtos_register_periodic_task(medium_priority_task, MEDIUM_TASK_PERIOD, MEDIUM_PRIORITY_TASK);
+    i32 task3 = task_ids[2] = rtos_register_periodic_task(low_priority_task, SLOW_TASK_PERIOD, LOW_PRIORITY_TASK);
     
     /* Register monitoring tasks */
     i32 deadline_task = rtos_register_periodic_task(deadline_monitor_task, 250, HIGH_PRIORITY_TASK + 5);
@@ -242,18 +243,29 @@ void display_final_statistics(void) {
     struct rtos_timing_stats final_stats;
     rtos_get_timing_stats(&final_stats);
     
-    vga_printf("Total Context Switches: %u\n", final_stats.context_switches);
-    vga_printf("Missed Deadlines: %u\n", final_stats.missed_deadlines);
+    vga_printf("Total Context Switches: %d\n", final_stats.context_switches);
+    vga_printf("Missed Deadlines: %d\n", final_stats.missed_deadlines);
     
     /* Calculate task execution rates */
     u32 total_time_ms = RTOS_TICKS_TO_MS(final_stats.system_ticks);
     if (total_time_ms > 0) {
-        vga_printf("High Priority Task Rate: %.2f Hz\n", 
-                   (float)task_counters[0] * 1000.0f / total_time_ms);
-        vga_printf("Medium Priority Task Rate: %.2f Hz\n", 
-                   (float)task_counters[1] * 1000.0f / total_time_ms);
-        vga_printf("Low Priority Task Rate: %.2f Hz\n", 
-                   (float)task_counters[2] * 1000.0f / total_time_ms);
+        vga_printf("High Priority Task Rate: %d Hz\n", 
+                   (u32)((u64)task_counters[0] * 1000 / total_time_ms));
+        vga_printf("Medium Priority Task Rate: %d Hz\n", 
+                   (u32)((u64)task_counters[1] * 1000 / total_time_ms));
+        vga_printf("Low Priority Task Rate: %d Hz\n", 
+                   (u32)((u64)task_counters[2] * 1000 / total_time_ms));
+    }
+    
+    /* Response times measured from each release instant */
+    for (u32 i = 0; i < 3; i++) {
+        struct rtos_periodic_stats periodic;
+        if (rtos_get_periodic_stats(task_ids[i], &periodic) == RTOS_OK) {
+            vga_printf("Task %d (%d ms): response min/avg/max %d/%d/%d us, %d overruns\n",
+                       i, periodic.period_ms, (u32)periodic.min_response_us,
+                       (u32)periodic.avg_response_us, (u32)periodic.max_response_us,
+                       (u32)periodic.overruns);
+        }
     }
     
     vga_puts("==================================\n");
@@ -584,6 +584,88 @@ static void draw_storage_content(u32* buffer, u32 buffer_width, struct system_in
     }
 }
 
+/* Draw performance content - scheduler wake-to-run latency */
+static void draw_performance_content(u32* buffer, u32 buffer_width, struct system_info_app* app) {
+    u32 content_x = 220;
+    struct sched_latency_stats lat;
+    sched_get_latency_stats(&lat);
+
+    /* Clear content area */
+    for (u32 y = 0; y < 600; y++) {
+        for (u32 x = content_x; x < buffer_width; x++) {
+            buffer[y * buffer_width + x] = COLOR_WHITE;
+        }
+    }
+
+    /* Draw title */
+    sysinfo_draw_text_to_buffer(buffer, buffer_width, content_x + 20, 20,
+                               "Scheduling Latency", COLOR_BLACK);
+
+    u32 line_height = 20;
+    u32 current_y = 60;
+
+    char count_str[32];
+    snprintf(count_str, sizeof(count_str), "%llu", lat.count);
+    sysinfo_draw_text_to_buffer(buffer, buffer_width, content_x + 20, current_y,
+                               "Wakeups:", COLOR_BLACK);
+    sysinfo_draw_text_to_buffer(buffer, buffer_width, content_x + 120, current_y,
+                               count_str, COLOR_BLUE);
+    current_y += line_height;
+
+    /* Percentiles, in microseconds with ns resolution */
+    static const char* labels[] = {"p50:", "p99:", "p99.9:", "Max:"};
+    u64 values[4] = {
+        sched_latency_percentile(&lat, 5000),
+        sched_latency_percentile(&lat, 9900),
+        sched_latency_percentile(&lat, 9990),
+        lat.max_ns
+    };
+
+    for (u32 i = 0; i < 4; i++) {
+        char value_str[32];
+        snprintf(value_str, sizeof(value_str), "%llu.%03llu us", values[i] / 1000, values[i] % 1000);
+        sysinfo_draw_text_to_buffer(buffer, buffer_width, content_x + 20, current_y,
+                                   labels[i], COLOR_BLACK);
+        sysinfo_draw_text_to_buffer(buffer, buffer_width, content_x + 120, current_y,
+                                   value_str, i == 3 ? COLOR_RED : COLOR_BLUE);
+        current_y += line_height;
+    }
+    current_y += 20;
+
+    if (lat.count == 0) {
+        return;
+    }
+
+    /* Histogram, one bar per populated log2 bucket */
+    sysinfo_draw_text_to_buffer(buffer, buffer_width, content_x + 20, current_y,
+                               "Distribution (log2 ns buckets):", COLOR_BLACK);
+    current_y += 25;
+
+    u64 peak = 0;
+    for (u32 i = 0; i < SCHED_LAT_BUCKETS; i++) {
+        if (lat.buckets[i] > peak) peak = lat.buckets[i];
+    }
+
+    for (u32 i = 0; i < SCHED_LAT_BUCKETS && current_y < 580; i++) {
+        if (lat.buckets[i] == 0) continue;
+
+        char bucket_str[32];
+        snprintf(bucket_str, sizeof(bucket_str), ">= %llu ns", 1ULL << i);
+        sysinfo_draw_text_to_buffer(buffer, buffer_width, content_x + 20, current_y,
+                                   bucket_str, COLOR_BLACK);
+        draw_usage_bar(buffer, buffer_width, content_x + 160, current_y, 300, 12,
+                       (float)lat.buckets[i] * 100.0f / (float)peak, COLOR_GREEN);
+
+        if (app->show_advanced) {
+            char n_str[32];
+            snprintf(n_str, sizeof(n_str), "%llu", lat.buckets[i]);
+            sysinfo_draw_text_to_buffer(buffer, buffer_width, content_x + 470, current_y,
+                                       n_str, COLOR_GRAY);
+        }
+        current_y += 16;
+    }
+}
+
 /* Render system info application */
 void sysinfo_render(struct system_info_app* app) {
     if (!app->active) return;
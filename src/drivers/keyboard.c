@@ -40,11 +40,13 @@ static bool caps_lock = false;
 static char keyboard_buffer[KEYBOARD_BUFFER_SIZE];
 static volatile size_t buffer_head = 0;
 static volatile size_t buffer_tail = 0;
+static struct wait_queue_head keyboard_wait;  /* Pollers waiting for input */
 
 /* Initialize keyboard */
 void keyboard_init(void) {
     buffer_head = 0;
     buffer_tail = 0;
+    wait_queue_init(&keyboard_wait);
     shift_pressed = false;
     ctrl_pressed = false;
     alt_pressed = false;
@@ -56,6 +58,11 @@ bool keyboard_has_input(void) {
     return buffer_head != buffer_tail;
 }
 
+/* Queue woken whenever a character is buffered */
+struct wait_queue_head* keyboard_wait_queue(void) {
+    return &keyboard_wait;
+}
+
 /* Get character from keyboard buffer */
 char keyboard_getchar(void) {
     if (!keyboard_has_input()) {
@@ -73,6 +80,7 @@ static void keyboard_buffer_add(char c) {
     if (next_head != buffer_tail) {
         keyboard_buffer[buffer_head] = c;
         buffer_head = next_head;
+        wake_up_all(&keyboard_wait);
     }
 }
 
@@ -2,6 +2,8 @@
 
 /* Main GUI System for Kronos OS */
 
+#define GUI_FRAME_MS 16  /* Redraw at least this often while idle */
+
 static bool gui_mode = false;
 static bool mouse_enabled = false;
 
@@ -52,29 +54,42 @@ void gui_init(void) {
 
 /* Main GUI event loop */
 void gui_main_loop(void) {
+    /* Sleep until a key arrives or the next frame is due */
+    i32 events = epoll_create();
+    struct epoll_event event = { EPOLLIN, 0 };
+    if (events >= 0) {
+        epoll_ctl(events, EPOLL_CTL_ADD, EPOLL_TARGET(EPOLL_SRC_KEYBOARD, 0), &event);
+    }
+    
+    u64 next_second = get_system_time() + 1000000;
+    
     while (gui_mode) {
         /* Handle input events */
         gui_handle_input();
         
         /* Update desktop time */
-        static u32 time_counter = 0;
-        if (++time_counter > 1000000) {  /* Update every ~1 second */
-            time_counter = 0;
+        if (get_system_time() >= next_second) {
+            next_second += 1000000;
             gui_update_time();
         }
         
         /* Render everything */
         gui_render();
         
-        /* Small delay to prevent 100% CPU usage */
-        for (volatile u32 i = 0; i < 1000; i++);
+        if (events >= 0) {
+            epoll_wait(events, &event, 1, GUI_FRAME_MS);
+        }
+    }
+    
+    if (events >= 0) {
+        epoll_close(events);
     }
 }
 
 /* Handle input events */
 void gui_handle_input(void) {
     /* Handle keyboard input */
-    if (keyboard_has_input()) {
+    while (keyboard_has_input()) {
         char c = keyboard_getchar();
         gui_handle_keyboard(c);
     }
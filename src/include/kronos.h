@@ -18,6 +18,26 @@ typedef int16_t  i16;
 typedef int32_t  i32;
 typedef int64_t  i64;
 
+/* Error numbers, returned negated */
+#define EPERM      1
+#define ENOENT     2
+#define ESRCH      3
+#define EINTR      4
+#define EBADF      9
+#define ECHILD    10
+#define EAGAIN    11
+#define ENOMEM    12
+#define EFAULT    14
+#define EBUSY     16
+#define EEXIST    17
+#define EINVAL    22
+#define EMFILE    24
+#define ENOSPC    28
+#define ESPIPE    29
+#define EPIPE     32
+#define ENOSYS    38
+#define ETIMEDOUT 110
+
 /* Memory constants */
 #define PAGE_SIZE 4096
 #define KERNEL_VIRTUAL_BASE 0xFFFFFFFF80000000UL
@@ -70,6 +90,7 @@ void vga_putentryat(char c, u8 color, size_t x, size_t y);
 void keyboard_init(void);
 char keyboard_getchar(void);
 bool keyboard_has_input(void);
+struct wait_queue_head* keyboard_wait_queue(void);
 void keyboard_interrupt_handler(void);
 
 /* Memory Management */
@@ -77,14 +98,369 @@ void mm_init(void);
 void* kmalloc(size_t size);
 void kfree(void* ptr);
 void get_memory_stats(size_t* total, size_t* used, size_t* free);
+struct page_directory;
+u64 vmm_page_directory_phys(struct page_directory* pd);
+struct page_directory* vmm_create_page_directory(void);
+void vmm_destroy_page_directory(struct page_directory* pd);
+struct vma;
+void vma_free_list(struct vma* vma);
+u64 pmm_alloc_page(void);
+void pmm_free_page(u64 physical_addr);
+u64 pmm_alloc_huge_page(void);
+void pmm_free_huge_page(u64 physical_addr);
+void pmm_page_get(u64 physical_addr);
+u64 vmm_share_user_page(u64 vaddr);
+i32 vmm_map_cow_page(u64 vaddr, u64 physical_addr);
+u64 vmm_virt_to_phys(u64 vaddr);
+bool vmm_access_ok(u64 addr, u64 size, bool write);
+
+/* Memory mapping permissions */
+#define PROT_READ   0x1
+#define PROT_WRITE  0x2
+#define PROT_EXEC   0x4
+#define PROT_NONE   0x0
+
+/* Shared mappings: fault returns the physical page backing offset (with a
+ * reference for the mapping) and sets *page_size to PAGE_SIZE or 2 MB;
+ * close runs once when the mapping goes, by unmap or address-space teardown */
+#define HUGE_PAGE_SIZE 0x200000
+typedef u64 (*vma_fault_t)(void* private, u64 offset, u64* page_size);
+typedef void (*vma_close_t)(void* private);
+void* vmm_map_shared(u64 addr, u64 size, u32 prot, bool huge, vma_fault_t fault,
+                     vma_close_t close, void* private);
+void* vmm_unmap_shared(u64 addr);
+
+/* Open files: what a process's fd_table points at */
+struct file;
+struct file_descriptor {
+    struct file* file;
+    u64 offset;
+    i32 flags;
+};
+i64 file_read(struct file* file, u64 offset, void* buffer, u64 size);
+i64 file_write(struct file* file, u64 offset, const void* buffer, u64 size);
+
+/* Pipes */
+i32 pipe_create(i32 pipefd[2]);
+i32 pipe_read(u32 pipe_id, void* buffer, u32 size);
+i32 pipe_write(u32 pipe_id, const void* buffer, u32 size);
+i32 pipe_set_size(u32 pipe_id, u32 size);
+i32 pipe_get_size(u32 pipe_id);
+bool pipe_end_get(struct file_descriptor* entry, u32 fd);
+bool pipe_end_put(struct file_descriptor* entry, u32 fd);
+
+/* fcntl commands on pipe descriptors (Linux values) */
+#define F_SETPIPE_SZ 1031
+#define F_GETPIPE_SZ 1032
+i32 pipe_fcntl(i32 fd, i32 cmd, u32 arg);
+
+/* Pipes: zero-copy page transfer */
+struct iovec {
+    void* iov_base;
+    size_t iov_len;
+};
+i64 splice(i32 fd_in, i64* off_in, i32 fd_out, i64* off_out, size_t len, u32 flags);
+i64 vmsplice(i32 fd, const struct iovec* iov, u32 nr_segs, u32 flags);
 
 /* Interrupt Handling */
+#define IRQ_BASE_VECTOR  32  /* PIC lines 0..15 are remapped to vectors 32..47 */
+
 void idt_init(void);
 void irq_install(void);
 
+/* Log2 latency histograms: bucket n counts delays in [2^n, 2^(n+1)) ns,
+ * the last bucket also everything longer */
+static inline u32 latency_log2_bucket(u64 ns, u32 nr_buckets) {
+    if (ns == 0) {
+        return 0;
+    }
+
+    u32 bucket = 63 - __builtin_clzll(ns);
+    return bucket < nr_buckets ? bucket : nr_buckets - 1;
+}
+
+/* Interrupt latency per IRQ line, handler entry to dispatch. IRQ0 also
+ * counts the time since assertion, which the PIT count tells. */
+#define IRQ_LINES        16
+#define IRQ_LAT_BUCKETS  32
+
+struct irq_latency_stats {
+    u64 buckets[IRQ_LAT_BUCKETS];  /* Bucket n counts delays in [2^n, 2^(n+1)) ns */
+    u64 count;
+    u64 total_ns;
+    u64 min_ns;
+    u64 max_ns;
+    u64 over_budget;               /* Samples above the latency budget */
+};
+
+i32 irq_get_latency_stats(u32 irq, struct irq_latency_stats* stats);
+void irq_reset_latency_stats(void);
+u64 irq_latency_max_ns(void);
+void irq_set_latency_budget(u64 budget_ns);
+u64 irq_get_latency_budget(void);
+
 /* GDT */
 void gdt_init(void);
 
+/* RTOS tick: timeouts and periodic task releases */
+void rtos_tick_handler(void);
+
+/* Clock Source */
+void clocksource_init(void);
+void clocksource_tick(void);
+u64 clock_monotonic_ns(void);
+u64 clock_get_jiffies(void);
+u64 clock_get_tsc_khz(void);
+void clock_sleep_ns(u64 nanoseconds);
+u64 get_system_time(void);
+void timer_sleep(u64 microseconds);
+u64 clock_read_cycles(void);
+u64 clock_cycles_to_ns(u64 cycles);
+u64 clock_pit_elapsed_ns(void);
+
+/* FPU (lazy x87/SSE/AVX state switching) */
+struct fpu_context {
+    void* area;                 /* 64-byte aligned XSAVE/FXSAVE image */
+    void* area_raw;             /* Allocation backing area */
+    bool used;                  /* Task has touched the FPU at least once */
+};
+
+void fpu_init(void);
+void fpu_switch_to(struct fpu_context* next);
+void fpu_handle_device_not_available(struct fpu_context* ctx);
+void fpu_release(struct fpu_context* ctx);
+u64 fpu_get_lazy_restores(void);
+
+/* Scheduler */
+struct process;
+extern struct process* task_list;  /* All live tasks */
+
+/* clone() flags */
+#define CLONE_VM             0x00000100  /* Share address space */
+#define CLONE_FILES          0x00000400  /* Share file descriptor table */
+#define CLONE_SIGHAND        0x00000800  /* Share signal dispositions */
+#define CLONE_THREAD         0x00010000  /* Same thread group (PID) */
+#define CLONE_PARENT_SETTID  0x00100000  /* Store child TID at parent_tid */
+
+#define WNOHANG 1   /* process_wait: return 0 instead of blocking */
+
+void schedule(void);
+struct process* get_current_process(void);
+struct process* get_process_by_pid(u32 pid);
+void process_reap(struct process* proc);
+struct rusage;
+i32 process_wait(i32 pid, i32* status, i32 options, struct rusage* rusage);
+struct fpu_context* get_current_fpu(void);
+void cfs_wake_up_process(struct process* proc);
+struct process* sched_pick_next_task(void);
+i32 process_clone(struct process* parent, u64 flags, void* entry_point, void* stack_top, void* arg);
+i32 kthread_create(const char* name, void (*fn)(void*), void* arg);
+void kthread_discard(u32 pid);
+void process_exit(u32 exit_code);
+bool process_is_kernel_thread(struct process* proc);
+void scheduler_timer_interrupt(void);
+void scheduler_preempt_point(void);
+struct trap_frame;
+void scheduler_preempt_return(const struct trap_frame* regs);
+
+/* Signals: pending and blocked masks are per thread, dispositions are
+ * shared by CLONE_SIGHAND/CLONE_THREAD threads. Bit n of a mask is signal n. */
+#define SIGHUP    1   /* Hangup */
+#define SIGINT    2   /* Interrupt */
+#define SIGQUIT   3   /* Quit */
+#define SIGILL    4   /* Illegal instruction */
+#define SIGTRAP   5   /* Trace trap */
+#define SIGABRT   6   /* Abort */
+#define SIGBUS    7   /* Bus error */
+#define SIGFPE    8   /* Floating point exception */
+#define SIGKILL   9   /* Kill */
+#define SIGUSR1   10  /* User signal 1 */
+#define SIGSEGV   11  /* Segmentation violation */
+#define SIGUSR2   12  /* User signal 2 */
+#define SIGPIPE   13  /* Broken pipe */
+#define SIGALRM   14  /* Alarm */
+#define SIGTERM   15  /* Termination */
+#define SIGCHLD   17  /* Child status changed */
+#define SIGCONT   18  /* Continue */
+#define SIGSTOP   19  /* Stop */
+#define NSIG      64
+
+#define SIGMASK(sig)  (1ULL << (sig))
+
+#define SIG_DFL   ((void (*)(int))0)
+#define SIG_IGN   ((void (*)(int))1)
+
+#define SA_RESTORER   0x04000000  /* sa_restorer is valid; required for handlers */
+#define SA_NODEFER    0x40000000  /* Do not block the signal inside its handler */
+#define SA_RESETHAND  0x80000000  /* Back to SIG_DFL once delivered */
+
+#define SIG_BLOCK     0
+#define SIG_UNBLOCK   1
+#define SIG_SETMASK   2
+
+struct sigaction {
+    void (*sa_handler)(int);
+    u64 sa_flags;
+    void (*sa_restorer)(void);          /* Handler returns here; it must call rt_sigreturn */
+    u64 sa_mask;                        /* Blocked while the handler runs */
+};
+
+/* Registers saved by the interrupt and syscall stubs, lowest address first */
+struct trap_frame {
+    u64 r15, r14, r13, r12, r11, r10, r9, r8;
+    u64 rbp, rdi, rsi, rdx, rcx, rbx, rax;
+    u64 int_no, err_code;
+    u64 rip, cs, rflags, rsp, ss;       /* Pushed by the CPU */
+};
+
+/* Pushed on the user stack for a handler; the handler's return pops restorer */
+struct sigframe {
+    u64 restorer;
+    struct trap_frame regs;             /* Interrupted context */
+    u64 blocked;                        /* Mask to restore */
+};
+
+/* Non-zero while the running thread has an unblocked signal pending; the
+ * only thing the interrupt and syscall exit path tests */
+extern volatile u32 signal_work_pending;
+
+bool signal_pending(struct process* proc);
+i32 signal_send(u32 pid, i32 signal);
+i32 signal_action(i32 signum, const struct sigaction* act, struct sigaction* oldact);
+i32 signal_procmask(i32 how, const u64* set, u64* oldset);
+void signal_deliver(struct trap_frame* regs);
+void signal_return(struct trap_frame* regs);
+
+/* Wait queues: intrusive entries, usually on the sleeper's stack */
+#define WQ_FLAG_EXCLUSIVE 0x01  /* Counted against a wakeup's nr_exclusive */
+#define WQ_FLAG_PRIORITY  0x02  /* Exclusive entry queued by process priority */
+
+struct wait_queue_entry;
+typedef bool (*wait_queue_func_t)(struct wait_queue_entry* entry, void* key);
+
+struct wait_queue_head {
+    struct wait_queue_entry* first;
+    struct wait_queue_entry* last;
+};
+
+struct wait_queue_entry {
+    struct process* proc;
+    u32 flags;
+    wait_queue_func_t func;             /* Returns true if it took the wakeup */
+    void* private;
+    struct wait_queue_head* head;       /* NULL while not queued */
+    struct wait_queue_entry* next;
+    struct wait_queue_entry* prev;
+};
+
+void wait_queue_init(struct wait_queue_head* wq);
+void wait_entry_init(struct wait_queue_entry* entry, u32 flags, wait_queue_func_t func, void* private);
+void add_wait_queue(struct wait_queue_head* wq, struct wait_queue_entry* entry);
+void remove_wait_queue(struct wait_queue_entry* entry);
+bool default_wake_function(struct wait_queue_entry* entry, void* key);
+u32 wake_up_key(struct wait_queue_head* wq, u32 nr_exclusive, void* key);
+void wait_queue_sleep(struct wait_queue_head* wq, struct wait_queue_entry* entry);
+
+static inline bool wait_queue_active(const struct wait_queue_head* wq) {
+    return wq->first != NULL;
+}
+
+static inline u32 wake_up(struct wait_queue_head* wq) {
+    return wake_up_key(wq, 1, NULL);
+}
+
+static inline u32 wake_up_all(struct wait_queue_head* wq) {
+    return wake_up_key(wq, 0, NULL);
+}
+
+/* Scheduling latency (wake-to-run delay) */
+#define SCHED_LAT_BUCKETS 32    /* Bucket i counts delays in [2^i, 2^(i+1)) ns */
+
+struct sched_latency_stats {
+    u64 buckets[SCHED_LAT_BUCKETS];
+    u64 count;
+    u64 total_ns;
+    u64 max_ns;
+};
+
+void sched_get_latency_stats(struct sched_latency_stats* stats);
+i32 sched_get_task_latency(u32 pid, struct sched_latency_stats* stats);
+void sched_reset_latency_stats(void);
+u64 sched_latency_percentile(const struct sched_latency_stats* stats, u32 per_10000);
+
+/* Scheduling classes: deadline (EDF + CBS), then fixed-priority FIFO, then CFS */
+#define SCHED_NORMAL   0
+#define SCHED_FIFO     1
+#define SCHED_DEADLINE 6
+
+i32 sched_setscheduler(u32 pid, u32 policy, u32 rt_priority);
+void sched_rt_mutex_setprio(struct process* proc, u32 prio);
+u32 sched_rt_nr_running(void);
+
+struct sched_dl_info {
+    u64 runtime_ns;
+    u64 deadline_ns;
+    u64 period_ns;
+    u64 abs_deadline_ns;        /* Current instance, clock_monotonic_ns() base */
+    u64 remaining_ns;           /* Budget left in the current instance */
+    u64 deadline_misses;
+    bool throttled;
+};
+
+bool sched_dl_can_admit(u64 runtime_ns, u64 period_ns);
+i32 sched_setattr_deadline(u32 pid, u64 runtime_ns, u64 deadline_ns, u64 period_ns);
+void sched_dl_yield(void);
+i32 sched_get_deadline_info(u32 pid, struct sched_dl_info* info);
+i64 sched_dl_check_misses(u32 pid);
+u64 sched_dl_total_misses(void);
+u32 sched_dl_utilization(void);
+
+/* CPU affinity (bit n = CPU n) */
+#define SCHED_MAX_CPUS 64
+
+i32 sched_setaffinity(u32 pid, u64 mask);
+i32 sched_getaffinity(u32 pid, u64* mask);
+i32 sched_set_isolated_cpus(const char* cpulist);
+u64 sched_housekeeping_mask(void);
+
+/* Task groups (CPU bandwidth control) */
+#define MAX_TASK_GROUPS 16
+
+struct task_group;
+
+struct task_group_stats {
+    u32 id;
+    u32 parent_id;
+    char name[32];
+    u64 shares;
+    u64 quota_us;               /* 0 = unlimited */
+    u64 period_us;
+    u64 usage_us;               /* Total CPU time consumed */
+    u64 nr_periods;
+    u64 nr_throttled;
+    u64 throttled_us;           /* Total time spent throttled */
+    u32 nr_tasks;
+    bool throttled;
+};
+
+struct process_stats {
+    u32 total_processes;
+    u32 running_processes;
+    u32 zombie_processes;
+    u32 current_pid;
+    bool scheduler_enabled;
+    struct task_group_stats groups[MAX_TASK_GROUPS];
+    u32 group_count;
+};
+
+void get_process_stats(struct process_stats* stats);
+i32 task_group_create(const char* name, u32 parent_id, u64 shares);
+i32 task_group_destroy(u32 group_id);
+struct task_group* task_group_find(u32 group_id);
+i32 task_group_set_shares(u32 group_id, u64 shares);
+i32 task_group_set_bandwidth(u32 group_id, u64 quota_us, u64 period_us);
+i32 task_group_attach(u32 pid, u32 group_id);
+
 /* Shell */
 void shell_init(void);
 void shell_run(void);
@@ -103,6 +479,9 @@ void* memcpy(void* dest, const void* src, size_t size);
 int strncmp(const char* str1, const char* str2, size_t n);
 char* strchr(const char* str, int c);
 char* strtok(char* str, const char* delim);
+char* strncpy(char* dest, const char* src, size_t n);
+size_t strlcpy(char* dest, const char* src, size_t size);
+int atoi(const char* str);
 static void itoa(int value, char* buffer, int base);
 
 /* I/O Port functions */
@@ -116,6 +495,312 @@ static inline u8 inb(u16 port) {
     return ret;
 }
 
+/* Interrupt flag */
+static inline void disable_interrupts(void) {
+    __asm__ volatile ("cli" ::: "memory");
+}
+
+static inline void enable_interrupts(void) {
+    __asm__ volatile ("sti" ::: "memory");
+}
+
+#define RFLAGS_IF 0x200
+
+static inline bool irqs_enabled(void) {
+    u64 flags;
+    __asm__ volatile ("pushfq; pop %0" : "=r"(flags) :: "memory");
+    return (flags & RFLAGS_IF) != 0;
+}
+
+/* Nestable irq-off section: restoring puts IF back as it was, so a section
+ * entered with interrupts already off leaves them off */
+static inline u64 irq_save(void) {
+    u64 flags;
+    __asm__ volatile ("pushfq; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void irq_restore(u64 flags) {
+    __asm__ volatile ("push %0; popfq" :: "g"(flags) : "memory", "cc");
+}
+
+/* Futexes: sleep on a 32-bit word, keyed by its physical address so
+ * processes sharing the page meet in the same wait queue */
+#define FUTEX_WAIT          0
+#define FUTEX_WAKE          1
+#define FUTEX_REQUEUE       3
+#define FUTEX_CMP_REQUEUE   4
+#define FUTEX_PRIVATE_FLAG  128
+
+i32 futex_wait(u32* uaddr, u32 val, u32 timeout_ms);
+i32 futex_wake(u32* uaddr, u32 nr_wake);
+i32 futex_requeue(u32* uaddr, u32 nr_wake, u32* uaddr2, u32 nr_requeue, bool compare, u32 cmpval);
+
+/* Event polling: one thread waits on many sources. Items hook the sources'
+ * wait queues, so a wakeup moves them to a ready list instead of anyone
+ * scanning. A target names the source kind and its id; plain fds are pipes. */
+#define EPOLLIN         0x001
+#define EPOLLOUT        0x004
+#define EPOLLONESHOT    (1U << 30)
+#define EPOLLET         (1U << 31)
+
+#define EPOLL_CTL_ADD   1
+#define EPOLL_CTL_DEL   2
+#define EPOLL_CTL_MOD   3
+
+#define EPOLL_SRC_PIPE      0   /* id is a pipe fd */
+#define EPOLL_SRC_MSGQ      1   /* id from msgget */
+#define EPOLL_SRC_SEM       2   /* id from semget; readable while the count is positive */
+#define EPOLL_SRC_KEYBOARD  3
+
+#define EPOLL_TARGET(source, id)    (((u32)(source) << 24) | ((u32)(id) & 0xFFFFFF))
+#define EPOLL_TARGET_SOURCE(target) ((target) >> 24)
+#define EPOLL_TARGET_ID(target)     ((i32)((target) & 0xFFFFFF))
+
+struct epoll_event {
+    u32 events;
+    u64 data;
+} __attribute__((packed));
+
+i32 epoll_create(void);
+i32 epoll_ctl(i32 epid, i32 op, u32 target, const struct epoll_event* event);
+i32 epoll_wait(i32 epid, struct epoll_event* events, i32 maxevents, i32 timeout_ms);
+i32 epoll_close(i32 epid);
+
+/* System V shared memory: frames are shared by reference between every
+ * attacher and populated on first touch */
+#define IPC_PRIVATE 0
+#define IPC_RMID    0
+#define IPC_CREAT   01000
+#define IPC_NOWAIT  04000
+#define SHM_RDONLY  010000
+#define SHM_HUGETLB 04000
+
+i32 shmget(u32 key, u64 size, i32 flags);
+void* shmat(i32 shmid, const void* addr, i32 flags);
+i32 shmdt(const void* addr);
+i32 shmctl(i32 shmid, i32 cmd);
+void shm_exit(u32 tgid);
+
+/* Shared-memory SPSC channels: one producer and one consumer pass messages
+ * through a ring in a shared segment. The kernel is only entered (futex) to
+ * sleep when the ring is empty (consumer) or full (producer), and to wake a sleeper. */
+#define CACHE_LINE_SIZE 64
+#define SPSC_WAIT_PRODUCER 0x1
+#define SPSC_WAIT_CONSUMER 0x2
+
+struct spsc_ring {
+    /* Producer's line */
+    volatile u32 head __attribute__((aligned(CACHE_LINE_SIZE)));  /* Slots published, free-running */
+    u32 cached_tail;                    /* Producer's last view of tail */
+
+    /* Consumer's line */
+    volatile u32 tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    u32 cached_head;
+
+    /* SPSC_WAIT_* bits, only touched on the slow path */
+    volatile u32 waiting __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    /* Fixed at creation */
+    u32 slot_size __attribute__((aligned(CACHE_LINE_SIZE)));  /* Stride, including the length word */
+    u32 mask;                           /* Slot count - 1 */
+    u32 shmid;
+    char slots[] __attribute__((aligned(CACHE_LINE_SIZE)));
+};
+
+i32 spsc_create(u32 key, u32 max_message, u32 nr_slots);
+struct spsc_ring* spsc_attach(i32 shmid);
+void spsc_detach(struct spsc_ring* ring);
+
+/* Slow path: advertise the sleeper, then futex-wait on the other side's
+ * index. The other side checks the bit after publishing its index, and
+ * futex_wait refuses to sleep once the index has moved, so no wakeup is lost. */
+static inline void spsc_wait(struct spsc_ring* ring, u32 side) {
+    __sync_fetch_and_or(&ring->waiting, side);
+
+    if (side == SPSC_WAIT_CONSUMER) {
+        u32 head = ring->head;
+        if (head == ring->tail) {
+            futex_wait((u32*)&ring->head, head, 0);
+        }
+    } else {
+        u32 tail = ring->tail;
+        if (ring->head - tail > ring->mask) {
+            futex_wait((u32*)&ring->tail, tail, 0);
+        }
+    }
+
+    __sync_fetch_and_and(&ring->waiting, ~side);
+}
+
+static inline void spsc_wake(struct spsc_ring* ring, u32 side) {
+    futex_wake((u32*)(side == SPSC_WAIT_CONSUMER ? &ring->head : &ring->tail), 1);
+}
+
+static inline bool spsc_try_send(struct spsc_ring* ring, const void* msg, u32 len) {
+    u32 head = ring->head;
+    if (head - ring->cached_tail > ring->mask) {
+        ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (head - ring->cached_tail > ring->mask) {
+            return false;
+        }
+    }
+
+    char* slot = ring->slots + (u64)(head & ring->mask) * ring->slot_size;
+    *(u32*)slot = len;
+    memcpy(slot + sizeof(u32), msg, len);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Returns the message length (truncated to size), or -1 if the ring is empty */
+static inline i32 spsc_try_recv(struct spsc_ring* ring, void* buf, u32 size) {
+    u32 tail = ring->tail;
+    if (tail == ring->cached_head) {
+        ring->cached_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (tail == ring->cached_head) {
+            return -1;
+        }
+    }
+
+    const char* slot = ring->slots + (u64)(tail & ring->mask) * ring->slot_size;
+    u32 len = *(const u32*)slot;
+    if (len > size) {
+        len = size;
+    }
+    memcpy(buf, slot + sizeof(u32), len);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return (i32)len;
+}
+
+/* Blocking send: sleeps only while the ring is full */
+static inline i32 spsc_send(struct spsc_ring* ring, const void* msg, u32 len) {
+    if (len > ring->slot_size - sizeof(u32)) {
+        return -1;
+    }
+
+    while (!spsc_try_send(ring, msg, len)) {
+        spsc_wait(ring, SPSC_WAIT_PRODUCER);
+    }
+
+    /* Publish head before looking for a sleeping consumer */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (ring->waiting & SPSC_WAIT_CONSUMER) {
+        spsc_wake(ring, SPSC_WAIT_CONSUMER);
+    }
+    return 0;
+}
+
+/* Blocking receive: sleeps only while the ring is empty */
+static inline i32 spsc_recv(struct spsc_ring* ring, void* buf, u32 size) {
+    i32 len;
+    while ((len = spsc_try_recv(ring, buf, size)) < 0) {
+        spsc_wait(ring, SPSC_WAIT_CONSUMER);
+    }
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (ring->waiting & SPSC_WAIT_PRODUCER) {
+        spsc_wake(ring, SPSC_WAIT_PRODUCER);
+    }
+    return len;
+}
+
+/* Asynchronous submission rings: the process queues operations in a shared
+ * submission ring and a worker thread in its thread group runs them, posting
+ * results to a completion ring. Neither side traps while the worker is busy;
+ * io_ring_enter is only needed to wake an idle worker or to wait for results. */
+#define IO_OP_NOP       0
+#define IO_OP_READ      1   /* fd, buf, count */
+#define IO_OP_WRITE     2   /* fd, buf, count */
+#define IO_OP_OPEN      3   /* path, flags, mode */
+#define IO_OP_CLOSE     4   /* fd */
+#define IO_OP_PIPE      5   /* i32 fds[2] */
+#define IO_OP_MSGSND    6   /* msqid, msgp, msgsz, msgflg */
+#define IO_OP_MSGRCV    7   /* msqid, msgp, msgsz, msgtyp, msgflg */
+#define IO_OP_SPLICE    8   /* fd_in, off_in, fd_out, off_out, len, flags */
+#define IO_OP_COUNT     9
+
+#define IO_RING_NEED_WAKEUP 0x1 /* Worker is asleep; submitters must call io_ring_enter */
+
+struct io_sqe {
+    u32 opcode;
+    u32 flags;
+    u64 user_data;                      /* Copied to the completion */
+    u64 args[6];
+};
+
+struct io_cqe {
+    u64 user_data;
+    i64 result;                         /* The operation's return value */
+};
+
+struct io_ring {
+    /* Submission side: the process produces at sq_tail, the worker consumes at sq_head */
+    volatile u32 sq_tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    u32 sq_local_tail;                  /* Queued by io_ring_get_sqe, not yet submitted */
+    volatile u32 sq_head __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    /* Completion side: the worker produces at cq_tail, the process consumes at cq_head */
+    volatile u32 cq_tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    volatile u32 cq_head __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    volatile u32 flags __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    /* Fixed at setup */
+    u32 sq_entries __attribute__((aligned(CACHE_LINE_SIZE)));
+    u32 sq_mask;
+    u32 cq_entries;
+    u32 cq_mask;
+    u32 sqes_offset;                    /* From the start of the ring */
+    u32 cqes_offset;
+};
+
+struct io_ring* io_ring_setup(u32 entries);
+i32 io_ring_enter(struct io_ring* ring, u32 min_complete);
+i32 io_ring_destroy(struct io_ring* ring);
+
+static inline struct io_sqe* io_ring_sqes(struct io_ring* ring) {
+    return (struct io_sqe*)((char*)ring + ring->sqes_offset);
+}
+
+static inline struct io_cqe* io_ring_cqes(struct io_ring* ring) {
+    return (struct io_cqe*)((char*)ring + ring->cqes_offset);
+}
+
+/* Next free submission slot, or NULL while the ring is full */
+static inline struct io_sqe* io_ring_get_sqe(struct io_ring* ring) {
+    u32 tail = ring->sq_local_tail;
+    if (tail - __atomic_load_n(&ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        return NULL;
+    }
+    ring->sq_local_tail = tail + 1;
+    return &io_ring_sqes(ring)[tail & ring->sq_mask];
+}
+
+/* Hand every queued slot to the worker at once */
+static inline void io_ring_submit(struct io_ring* ring) {
+    __atomic_store_n(&ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    /* Publish the tail before looking for a sleeping worker */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (ring->flags & IO_RING_NEED_WAKEUP) {
+        io_ring_enter(ring, 0);
+    }
+}
+
+/* Oldest unreaped completion, or NULL */
+static inline struct io_cqe* io_ring_peek_cqe(struct io_ring* ring) {
+    u32 head = ring->cq_head;
+    if (head == __atomic_load_n(&ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return &io_ring_cqes(ring)[head & ring->cq_mask];
+}
+
+static inline void io_ring_cqe_seen(struct io_ring* ring) {
+    __atomic_store_n(&ring->cq_head, ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
 /* GUI and Graphics */
 #define COLOR_TRANSPARENT 0xFF000000
 
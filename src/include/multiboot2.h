@@ -9,6 +9,10 @@
 #define MULTIBOOT2_HEADER_TAG_END 0
 #define MULTIBOOT2_HEADER_TAG_INFORMATION_REQUEST 1
 
+/* Boot information tag types */
+#define MULTIBOOT2_TAG_TYPE_END 0
+#define MULTIBOOT2_TAG_TYPE_CMDLINE 1
+
 /* Multiboot2 header structure */
 struct multiboot2_header {
     uint32_t magic;
@@ -30,6 +34,13 @@ struct multiboot2_info {
     uint32_t reserved;
 } __attribute__((packed));
 
+/* Command line tag */
+struct multiboot2_tag_string {
+    uint32_t type;
+    uint32_t size;
+    char string[0];
+} __attribute__((packed));
+
 /* Memory map entry */
 struct multiboot2_mmap_entry {
     uint64_t addr;
@@ -0,0 +1,235 @@
+#include "kronos.h"
+
+/* Clock Source - TSC-based monotonic nanosecond clock for Kronos OS */
+
+#define PIT_FREQUENCY_HZ     1193182
+#define PIT_CHANNEL0_PORT    0x40
+#define PIT_CHANNEL2_PORT    0x42
+#define PIT_COMMAND_PORT     0x43
+#define PIT_GATE_PORT        0x61
+#define PIT_TICK_RATE_HZ     1000    /* Matches RTOS_TICK_RATE_HZ */
+
+#define CALIBRATION_MS       10      /* PIT gate window for TSC calibration */
+#define CALIBRATION_RUNS     3       /* Best-of-N to filter SMI/VM noise */
+#define NSEC_PER_SEC         1000000000ULL
+#define NSEC_PER_TICK        (NSEC_PER_SEC / PIT_TICK_RATE_HZ)
+#define CYC2NS_SHIFT         24
+
+/* Clock source state */
+static struct {
+    bool tsc_invariant;         /* CPUID reports constant, non-stop TSC */
+    bool tsc_calibrated;        /* Calibration succeeded, TSC is in use */
+    u64 tsc_khz;                /* Measured TSC frequency */
+    u64 tsc_base;               /* TSC value at clock zero */
+    u64 cyc2ns_mult;            /* ns = (cycles * mult) >> CYC2NS_SHIFT */
+    volatile u64 jiffies;       /* PIT ticks since boot (fallback source) */
+    u64 last_ns;                /* Last value returned, keeps clock monotonic */
+} clock;
+
+static inline u64 rdtsc(void) {
+    u32 lo, hi;
+    __asm__ volatile ("lfence; rdtsc" : "=a"(lo), "=d"(hi) :: "memory");
+    return ((u64)hi << 32) | lo;
+}
+
+static inline void cpuid(u32 leaf, u32* eax, u32* ebx, u32* ecx, u32* edx) {
+    __asm__ volatile ("cpuid"
+                      : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                      : "a"(leaf), "c"(0));
+}
+
+/* Check CPUID.80000007H:EDX[8] - invariant TSC */
+static bool tsc_is_invariant(void) {
+    u32 eax, ebx, ecx, edx;
+
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax < 0x80000007) {
+        return false;
+    }
+
+    cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return (edx & (1 << 8)) != 0;
+}
+
+/* Measure TSC cycles across a PIT channel 2 one-shot of CALIBRATION_MS */
+static u64 tsc_calibrate_once(void) {
+    u32 latch = (PIT_FREQUENCY_HZ * CALIBRATION_MS) / 1000;
+
+    /* Gate high, speaker off */
+    outb(PIT_GATE_PORT, (inb(PIT_GATE_PORT) & ~0x02) | 0x01);
+
+    /* Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count) */
+    outb(PIT_COMMAND_PORT, 0xB0);
+    outb(PIT_CHANNEL2_PORT, latch & 0xFF);
+    outb(PIT_CHANNEL2_PORT, (latch >> 8) & 0xFF);
+
+    u64 start = rdtsc();
+    u64 loops = 0;
+
+    /* OUT2 (bit 5) goes high when the count expires */
+    while (!(inb(PIT_GATE_PORT) & 0x20)) {
+        loops++;
+    }
+
+    u64 end = rdtsc();
+
+    /* PIT never fired - broken or missing timer */
+    if (loops == 0) {
+        return 0;
+    }
+
+    return end - start;
+}
+
+/* Calibrate the TSC against the PIT and derive the cycles-to-ns multiplier */
+static bool tsc_calibrate(void) {
+    u64 best = 0;
+
+    for (u32 i = 0; i < CALIBRATION_RUNS; i++) {
+        u64 cycles = tsc_calibrate_once();
+        if (cycles == 0) {
+            continue;
+        }
+        /* Shortest window had the least interference */
+        if (best == 0 || cycles < best) {
+            best = cycles;
+        }
+    }
+
+    if (best == 0) {
+        return false;
+    }
+
+    clock.tsc_khz = best / CALIBRATION_MS;
+    if (clock.tsc_khz == 0) {
+        return false;
+    }
+
+    /* mult = (10^6 << shift) / khz, i.e. ns per cycle in fixed point */
+    clock.cyc2ns_mult = (1000000ULL << CYC2NS_SHIFT) / clock.tsc_khz;
+    return true;
+}
+
+/* Program PIT channel 0 as the periodic system tick */
+static void pit_set_periodic(u32 hz) {
+    u32 divisor = PIT_FREQUENCY_HZ / hz;
+
+    /* Channel 0, lobyte/hibyte, mode 2 (rate generator) */
+    outb(PIT_COMMAND_PORT, 0x34);
+    outb(PIT_CHANNEL0_PORT, divisor & 0xFF);
+    outb(PIT_CHANNEL0_PORT, (divisor >> 8) & 0xFF);
+}
+
+static inline u64 cycles_to_ns(u64 cycles) {
+    return (u64)(((unsigned __int128)cycles * clock.cyc2ns_mult) >> CYC2NS_SHIFT);
+}
+
+/* Initialize clock source - call once with interrupts disabled */
+void clocksource_init(void) {
+    clock.jiffies = 0;
+    clock.last_ns = 0;
+    clock.tsc_invariant = tsc_is_invariant();
+    clock.tsc_calibrated = false;
+
+    if (clock.tsc_invariant) {
+        clock.tsc_calibrated = tsc_calibrate();
+    }
+
+    pit_set_periodic(PIT_TICK_RATE_HZ);
+    clock.tsc_base = rdtsc();
+
+    if (clock.tsc_calibrated) {
+        vga_printf("Clock source: invariant TSC at %d MHz\n", (u32)(clock.tsc_khz / 1000));
+    } else {
+        vga_puts("Clock source: PIT jiffies (TSC unusable)\n");
+    }
+}
+
+/* Timer interrupt hook - advances the fallback tick count */
+void clocksource_tick(void) {
+    clock.jiffies++;
+}
+
+/* Monotonic nanoseconds since clocksource_init */
+u64 clock_monotonic_ns(void) {
+    u64 now;
+
+    if (clock.tsc_calibrated) {
+        now = cycles_to_ns(rdtsc() - clock.tsc_base);
+    } else {
+        now = clock.jiffies * NSEC_PER_TICK;
+    }
+
+    /* Never step backwards, even across TSC/PIT jitter */
+    if (now < clock.last_ns) {
+        return clock.last_ns;
+    }
+    clock.last_ns = now;
+
+    return now;
+}
+
+/* System time in microseconds, used by existing callers */
+u64 get_system_time(void) {
+    return clock_monotonic_ns() / 1000;
+}
+
+/* PIT ticks since boot */
+u64 clock_get_jiffies(void) {
+    return clock.jiffies;
+}
+
+/* TSC frequency in kHz, 0 when running from the PIT */
+u64 clock_get_tsc_khz(void) {
+    return clock.tsc_calibrated ? clock.tsc_khz : 0;
+}
+
+/* Sleep for at least the given number of nanoseconds */
+void clock_sleep_ns(u64 nanoseconds) {
+    u64 deadline = clock_monotonic_ns() + nanoseconds;
+
+    /* Sub-tick sleeps spin on the TSC; the next timer IRQ would overshoot */
+    if (nanoseconds < NSEC_PER_TICK && clock.tsc_calibrated) {
+        while (clock_monotonic_ns() < deadline) {
+            __asm__ volatile ("pause");
+        }
+        return;
+    }
+
+    /* Longer sleeps give the CPU away until the deadline passes */
+    while (clock_monotonic_ns() < deadline) {
+        schedule();
+        __asm__ volatile ("hlt");
+    }
+}
+
+/* Legacy microsecond sleep used by apps and utilities */
+void timer_sleep(u64 microseconds) {
+    clock_sleep_ns(microseconds * 1000);
+}
+
+/* Raw TSC for short interval measurement, 0 when the TSC is not in use */
+u64 clock_read_cycles(void) {
+    return clock.tsc_calibrated ? rdtsc() : 0;
+}
+
+u64 clock_cycles_to_ns(u64 cycles) {
+    return clock.tsc_calibrated ? cycles_to_ns(cycles) : 0;
+}
+
+/* Time since PIT channel 0 last reloaded, i.e. since it raised IRQ0.
+ * Only meaningful within one tick period of the interrupt. */
+u64 clock_pit_elapsed_ns(void) {
+    u32 divisor = PIT_FREQUENCY_HZ / PIT_TICK_RATE_HZ;
+
+    /* Latch channel 0, then read lobyte/hibyte */
+    outb(PIT_COMMAND_PORT, 0x00);
+    u32 count = inb(PIT_CHANNEL0_PORT);
+    count |= (u32)inb(PIT_CHANNEL0_PORT) << 8;
+
+    /* Mode 2 counts divisor..1 and fires on the way to the reload */
+    if (count == 0 || count > divisor) {
+        return 0;
+    }
+    return (u64)(divisor - count) * NSEC_PER_SEC / PIT_FREQUENCY_HZ;
+}
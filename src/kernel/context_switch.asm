@@ -8,8 +8,8 @@ global restore_context
 section .text
 bits 64
 
-; void context_switch(struct process* prev, struct process* next)
-; RDI = prev process, RSI = next process
+; void context_switch(struct cpu_context* prev, struct cpu_context* next)
+; RDI = prev context, RSI = next context
 context_switch:
     ; Save current process context if prev is not NULL
     test rdi, rdi
@@ -48,12 +48,17 @@ context_switch:
 
 .restore_next:
     ; Restore next process context
-    ; RSI = next process
+    ; RSI = next context
     
-    ; Switch page directory
+    ; Switch page directory, unless next shares it (thread of the same
+    ; process) - reloading CR3 would flush the TLB for nothing
     mov rax, [rsi + 144]    ; next->context.cr3
+    mov rdx, cr3
+    cmp rax, rdx
+    je .same_address_space
     mov cr3, rax
     
+.same_address_space:
     ; Restore RFLAGS
     mov rax, [rsi + 136]    ; next->context.rflags
     push rax
@@ -0,0 +1,220 @@
+#include "kronos.h"
+
+/* Lazy FPU/SSE/AVX context switching for Kronos OS */
+
+#define CR0_MP  (1 << 1)    /* Monitor coprocessor */
+#define CR0_EM  (1 << 2)    /* x87 emulation */
+#define CR0_TS  (1 << 3)    /* Task switched - next FPU use raises #NM */
+#define CR0_NE  (1 << 5)    /* Native FPU error reporting */
+#define CR4_OSFXSR     (1 << 9)
+#define CR4_OSXMMEXCPT (1 << 10)
+#define CR4_OSXSAVE    (1 << 18)
+
+#define XFEATURE_X87   (1 << 0)
+#define XFEATURE_SSE   (1 << 1)
+#define XFEATURE_AVX   (1 << 2)
+
+#define FXSAVE_AREA_SIZE  512
+#define XSAVE_ALIGN       64
+
+/* Legacy area offsets and the values FNINIT/reset leave in them */
+#define FXSAVE_FCW        0
+#define FXSAVE_MXCSR      24
+#define XSAVE_XSTATE_BV   512       /* First field of the XSAVE header */
+#define FCW_DEFAULT       0x037F    /* All x87 exceptions masked */
+#define MXCSR_DEFAULT     0x1F80    /* All SIMD exceptions masked */
+
+/* FPU subsystem state */
+static struct {
+    bool has_xsave;
+    bool has_xsaveopt;
+    u64 xfeatures;              /* Components enabled in XCR0 */
+    u32 area_size;              /* Bytes needed per task */
+    struct fpu_context* owner;  /* Task whose state is live in the registers */
+    u64 lazy_restores;          /* #NM traps taken */
+} fpu;
+
+static inline void cpuid_count(u32 leaf, u32 subleaf, u32* eax, u32* ebx, u32* ecx, u32* edx) {
+    __asm__ volatile ("cpuid"
+                      : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                      : "a"(leaf), "c"(subleaf));
+}
+
+static inline u64 read_cr0(void) {
+    u64 cr0;
+    __asm__ volatile ("mov %%cr0, %0" : "=r"(cr0));
+    return cr0;
+}
+
+static inline void write_cr0(u64 cr0) {
+    __asm__ volatile ("mov %0, %%cr0" :: "r"(cr0) : "memory");
+}
+
+static inline u64 read_cr4(void) {
+    u64 cr4;
+    __asm__ volatile ("mov %%cr4, %0" : "=r"(cr4));
+    return cr4;
+}
+
+static inline void write_cr4(u64 cr4) {
+    __asm__ volatile ("mov %0, %%cr4" :: "r"(cr4) : "memory");
+}
+
+static inline void xsetbv(u32 index, u64 value) {
+    __asm__ volatile ("xsetbv" :: "c"(index), "a"((u32)value), "d"((u32)(value >> 32)));
+}
+
+static inline void clts(void) {
+    __asm__ volatile ("clts" ::: "memory");
+}
+
+static inline void stts(void) {
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+/* Save live registers into a task's area */
+static void fpu_save(struct fpu_context* ctx) {
+    u32 lo = (u32)fpu.xfeatures;
+    u32 hi = (u32)(fpu.xfeatures >> 32);
+
+    if (fpu.has_xsaveopt) {
+        /* Skips components still in their init state or unmodified since xrstor */
+        __asm__ volatile ("xsaveopt64 (%0)" :: "r"(ctx->area), "a"(lo), "d"(hi) : "memory");
+    } else if (fpu.has_xsave) {
+        __asm__ volatile ("xsave64 (%0)" :: "r"(ctx->area), "a"(lo), "d"(hi) : "memory");
+    } else {
+        __asm__ volatile ("fxsave64 (%0)" :: "r"(ctx->area) : "memory");
+    }
+}
+
+/* Load a task's area into the registers */
+static void fpu_restore(struct fpu_context* ctx) {
+    u32 lo = (u32)fpu.xfeatures;
+    u32 hi = (u32)(fpu.xfeatures >> 32);
+
+    if (fpu.has_xsave) {
+        __asm__ volatile ("xrstor64 (%0)" :: "r"(ctx->area), "a"(lo), "d"(hi) : "memory");
+    } else {
+        __asm__ volatile ("fxrstor64 (%0)" :: "r"(ctx->area) : "memory");
+    }
+}
+
+/* Allocate a 64-byte aligned save area on first FPU use, holding the
+ * default control words; an all-zero MXCSR would unmask every SIMD exception */
+static bool fpu_alloc_area(struct fpu_context* ctx) {
+    void* raw = kmalloc(fpu.area_size + XSAVE_ALIGN);
+    if (!raw) {
+        return false;
+    }
+
+    memset(raw, 0, fpu.area_size + XSAVE_ALIGN);
+    ctx->area_raw = raw;
+    ctx->area = (void*)(((u64)raw + XSAVE_ALIGN - 1) & ~(u64)(XSAVE_ALIGN - 1));
+
+    u8* area = (u8*)ctx->area;
+    *(u16*)(area + FXSAVE_FCW) = FCW_DEFAULT;
+    *(u32*)(area + FXSAVE_MXCSR) = MXCSR_DEFAULT;
+    if (fpu.has_xsave) {
+        /* x87 and SSE come from the area, AVX from its init state */
+        *(u64*)(area + XSAVE_XSTATE_BV) = XFEATURE_X87 | XFEATURE_SSE;
+    }
+    return true;
+}
+
+/* Enable the FPU and vector units and pick the save mechanism */
+void fpu_init(void) {
+    u32 eax, ebx, ecx, edx;
+
+    cpuid_count(1, 0, &eax, &ebx, &ecx, &edx);
+    fpu.has_xsave = (ecx & (1 << 26)) != 0;
+    bool has_avx = (ecx & (1 << 28)) != 0;
+
+    /* Native x87 with #NM on first use after a switch */
+    write_cr0((read_cr0() & ~CR0_EM) | CR0_MP | CR0_NE);
+    write_cr4(read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT);
+
+    fpu.xfeatures = XFEATURE_X87 | XFEATURE_SSE;
+    fpu.area_size = FXSAVE_AREA_SIZE;
+    fpu.has_xsaveopt = false;
+
+    if (fpu.has_xsave) {
+        write_cr4(read_cr4() | CR4_OSXSAVE);
+
+        if (has_avx) {
+            fpu.xfeatures |= XFEATURE_AVX;
+        }
+        xsetbv(0, fpu.xfeatures);
+
+        /* EBX reports the area size for the features now enabled in XCR0 */
+        cpuid_count(0xD, 0, &eax, &ebx, &ecx, &edx);
+        fpu.area_size = ebx;
+
+        cpuid_count(0xD, 1, &eax, &ebx, &ecx, &edx);
+        fpu.has_xsaveopt = (eax & 1) != 0;
+    }
+
+    fpu.owner = NULL;
+    fpu.lazy_restores = 0;
+
+    /* Start clean, then trap the first user */
+    __asm__ volatile ("fninit");
+    stts();
+
+    vga_printf("FPU: %s, %d byte save area%s\n",
+               fpu.has_xsave ? (fpu.xfeatures & XFEATURE_AVX ? "XSAVE x87/SSE/AVX" : "XSAVE x87/SSE") : "FXSAVE x87/SSE",
+               fpu.area_size, fpu.has_xsaveopt ? ", XSAVEOPT" : "");
+}
+
+/* Context switch hook: only the current owner may touch the registers without a trap */
+void fpu_switch_to(struct fpu_context* next) {
+    if (next && next == fpu.owner) {
+        clts();
+    } else {
+        stts();
+    }
+}
+
+/* #NM handler - hand the registers to the current task */
+void fpu_handle_device_not_available(struct fpu_context* ctx) {
+    clts();
+
+    if (!ctx || fpu.owner == ctx) {
+        return;
+    }
+
+    if (!ctx->area && !fpu_alloc_area(ctx)) {
+        /* No memory for state: keep trapping rather than corrupt another task */
+        stts();
+        return;
+    }
+
+    /* Save the previous owner's state */
+    if (fpu.owner) {
+        fpu_save(fpu.owner);
+    }
+
+    /* A fresh area already holds the init state, so first use restores too;
+     * FNINIT alone would keep the previous owner's MXCSR */
+    fpu_restore(ctx);
+    ctx->used = true;
+
+    fpu.owner = ctx;
+    fpu.lazy_restores++;
+}
+
+/* Drop a task's state when it exits */
+void fpu_release(struct fpu_context* ctx) {
+    if (fpu.owner == ctx) {
+        fpu.owner = NULL;
+    }
+
+    kfree(ctx->area_raw);
+    ctx->area_raw = NULL;
+    ctx->area = NULL;
+    ctx->used = false;
+}
+
+/* Number of lazy restores performed since boot */
+u64 fpu_get_lazy_restores(void) {
+    return fpu.lazy_restores;
+}
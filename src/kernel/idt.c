@@ -72,6 +72,7 @@ extern void irq12(void);
 extern void irq13(void);
 extern void irq14(void);
 extern void irq15(void);
+extern void syscall_stub(void);
 
 /* Set an IDT entry */
 static void idt_set_gate(u8 num, u64 base, u16 selector, u8 flags) {
@@ -136,8 +137,8 @@ void irq_install(void) {
     /* Remap PIC */
     outb(0x20, 0x11);
     outb(0xA0, 0x11);
-    outb(0x21, 0x20);
-    outb(0xA1, 0x28);
+    outb(0x21, IRQ_BASE_VECTOR);
+    outb(0xA1, IRQ_BASE_VECTOR + 8);
     outb(0x21, 0x04);
     outb(0xA1, 0x02);
     outb(0x21, 0x01);
@@ -163,6 +164,9 @@ void irq_install(void) {
     idt_set_gate(46, (u64)irq14, 0x08, 0x8E);
     idt_set_gate(47, (u64)irq15, 0x08, 0x8E);
     
+    /* System call gate, reachable from ring 3 */
+    idt_set_gate(128, (u64)syscall_stub, 0x08, 0xEE);
+    
     /* Enable interrupts */
     __asm__ volatile ("sti");
 }
@@ -178,6 +182,11 @@ struct interrupt_frame {
 
 /* ISR handler */
 void isr_handler(struct interrupt_frame* frame, u64 interrupt_number) {
+    if (interrupt_number == 7) { /* Device not available - lazy FPU restore */
+        fpu_handle_device_not_available(get_current_fpu());
+        return;
+    }
+
     vga_printf("Received interrupt: %d\n", interrupt_number);
 
     if (interrupt_number == 14) { /* Page fault */
@@ -187,17 +196,89 @@ void isr_handler(struct interrupt_frame* frame, u64 interrupt_number) {
     }
 }
 
-/* IRQ handler */
-void irq_handler(struct interrupt_frame* frame, u64 irq_number) {
+/* Interrupt latency per line */
+static struct irq_latency_stats irq_latency[IRQ_LINES];
+static u64 irq_latency_budget_ns = 0;
+
+static void irq_latency_record(u32 irq, u64 latency_ns) {
+    struct irq_latency_stats* stats = &irq_latency[irq];
+
+    stats->buckets[latency_log2_bucket(latency_ns, IRQ_LAT_BUCKETS)]++;
+    stats->total_ns += latency_ns;
+    if (stats->count == 0 || latency_ns < stats->min_ns) {
+        stats->min_ns = latency_ns;
+    }
+    if (latency_ns > stats->max_ns) {
+        stats->max_ns = latency_ns;
+    }
+    if (irq_latency_budget_ns && latency_ns > irq_latency_budget_ns) {
+        stats->over_budget++;
+    }
+    stats->count++;
+}
+
+/* Latency histogram of one IRQ line */
+i32 irq_get_latency_stats(u32 irq, struct irq_latency_stats* stats) {
+    if (irq >= IRQ_LINES) {
+        return -1;
+    }
+
+    memcpy(stats, &irq_latency[irq], sizeof(struct irq_latency_stats));
+    return 0;
+}
+
+void irq_reset_latency_stats(void) {
+    memset(irq_latency, 0, sizeof(irq_latency));
+}
+
+/* Worst latency over all lines */
+u64 irq_latency_max_ns(void) {
+    u64 max = 0;
+    for (u32 i = 0; i < IRQ_LINES; i++) {
+        if (irq_latency[i].max_ns > max) {
+            max = irq_latency[i].max_ns;
+        }
+    }
+    return max;
+}
+
+/* Samples above budget_ns are counted as over budget (0 = no budget) */
+void irq_set_latency_budget(u64 budget_ns) {
+    irq_latency_budget_ns = budget_ns;
+}
+
+u64 irq_get_latency_budget(void) {
+    return irq_latency_budget_ns;
+}
+
+/* IRQ handler - the stubs push the remapped vector, not the PIC line */
+void irq_handler(struct trap_frame* regs, u64 vector) {
+    u32 irq_number = (u32)(vector - IRQ_BASE_VECTOR);
+    u64 entry = clock_read_cycles();
+    u64 pending_ns = 0;
+
+    /* The timer also knows when it was raised: the PIT count says how long ago */
+    if (irq_number == 0) {
+        pending_ns = clock_pit_elapsed_ns();
+        entry = clock_read_cycles();  /* pending_ns covers everything before */
+    }
+
     /* Send EOI to PIC */
     if (irq_number >= 8) {
         outb(0xA0, 0x20);
     }
     outb(0x20, 0x20);
 
+    /* Entry to dispatch, per line; no TSC, no measurement */
+    if (entry && irq_number < IRQ_LINES) {
+        irq_latency_record(irq_number, pending_ns + clock_cycles_to_ns(clock_read_cycles() - entry));
+    }
+
     switch (irq_number) {
         case 0: /* Timer */
-            /* Timer tick - could update uptime here */
+            clocksource_tick();
+            rtos_tick_handler();
+            scheduler_timer_interrupt();
             break;
         case 1: /* Keyboard */
             keyboard_interrupt_handler();
@@ -205,4 +286,7 @@ void irq_handler(struct interrupt_frame* frame, u64 irq_number) {
         default:
             break;
     }
+    
+    /* Honour wakeup and tick preemption requests */
+    scheduler_preempt_return(regs);
 }
@@ -2,6 +2,9 @@
 
 extern isr_handler
 extern irq_handler
+extern syscall_entry
+extern signal_deliver
+extern signal_work_pending
 
 global idt_flush
 global isr0, isr1, isr2, isr3, isr4, isr5, isr6, isr7
@@ -10,6 +13,7 @@ global isr16, isr17, isr18, isr19, isr20, isr21, isr22, isr23
 global isr24, isr25, isr26, isr27, isr28, isr29, isr30, isr31
 global irq0, irq1, irq2, irq3, irq4, irq5, irq6, irq7
 global irq8, irq9, irq10, irq11, irq12, irq13, irq14, irq15
+global syscall_stub
 
 section .text
 bits 64
@@ -117,29 +121,7 @@ isr_common_stub:
     mov rdi, rsp    ; Pass stack pointer (interrupt frame)
     mov rsi, [rsp + 120]  ; Pass interrupt number
     call isr_handler
-    
-    ; Restore all registers
-    pop r15
-    pop r14
-    pop r13
-    pop r12
-    pop r11
-    pop r10
-    pop r9
-    pop r8
-    pop rbp
-    pop rdi
-    pop rsi
-    pop rdx
-    pop rcx
-    pop rbx
-    pop rax
-    
-    ; Clean up error code and interrupt number
-    add rsp, 16
-    
-    ; Return from interrupt
-    iretq
+    jmp interrupt_return
 
 ; Common IRQ stub
 irq_common_stub:
@@ -164,7 +146,41 @@ irq_common_stub:
     mov rdi, rsp    ; Pass stack pointer (interrupt frame)
     mov rsi, [rsp + 120]  ; Pass IRQ number
     call irq_handler
+    jmp interrupt_return
+
+; System call gate (int 0x80) - frame layout matches struct trap_frame
+syscall_stub:
+    push 0          ; Push dummy error code
+    push 128        ; Push vector number
     
+    ; Save all registers
+    push rax
+    push rbx
+    push rcx
+    push rdx
+    push rsi
+    push rdi
+    push rbp
+    push r8
+    push r9
+    push r10
+    push r11
+    push r12
+    push r13
+    push r14
+    push r15
+    
+    ; Call C dispatcher, which writes the result into the saved rax
+    mov rdi, rsp
+    call syscall_entry
+
+; Common exit path for all stubs
+interrupt_return:
+    ; Fast path: one load decides whether the current thread has signals to take
+    cmp dword [rel signal_work_pending], 0
+    jne .deliver
+    
+.restore:
     ; Restore all registers
     pop r15
     pop r14
@@ -182,8 +198,14 @@ irq_common_stub:
     pop rbx
     pop rax
     
-    ; Clean up error code and IRQ number
+    ; Clean up error code and interrupt number
     add rsp, 16
     
     ; Return from interrupt
     iretq
+
+.deliver:
+    ; Only rewrites the frame when returning to ring 3
+    mov rdi, rsp
+    call signal_deliver
+    jmp .restore
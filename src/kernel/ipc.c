@@ -1,4 +1,5 @@
 #include "kronos.h"
+#include "kernel/rtos.h"
 
 /* Inter-Process Communication for Kronos OS */
 
@@ -6,67 +7,89 @@
 #define MAX_MESSAGE_QUEUES 64
 #define MAX_SEMAPHORES 128
 #define MAX_SHARED_MEMORY 64
-#define PIPE_BUFFER_SIZE 4096
-#define MSG_QUEUE_SIZE 1024
-#define MAX_MSG_SIZE 256
-
-/* Signal definitions */
-#define SIGHUP    1   /* Hangup */
-#define SIGINT    2   /* Interrupt */
-#define SIGQUIT   3   /* Quit */
-#define SIGILL    4   /* Illegal instruction */
-#define SIGTRAP   5   /* Trace trap */
-#define SIGABRT   6   /* Abort */
-#define SIGBUS    7   /* Bus error */
-#define SIGFPE    8   /* Floating point exception */
-#define SIGKILL   9   /* Kill */
-#define SIGUSR1   10  /* User signal 1 */
-#define SIGSEGV   11  /* Segmentation violation */
-#define SIGUSR2   12  /* User signal 2 */
-#define SIGPIPE   13  /* Broken pipe */
-#define SIGALRM   14  /* Alarm */
-#define SIGTERM   15  /* Termination */
-#define SIGCHLD   17  /* Child status changed */
-#define SIGCONT   18  /* Continue */
-#define SIGSTOP   19  /* Stop */
+#define MAX_EVENT_POLLS 32
+#define PIPE_BUFFER_SIZE 4096  /* Default capacity, power of two */
+#define PIPE_MAX_SIZE (1024 * 1024)
+#define PIPE_BUF 4096  /* Writes up to this size are never interleaved */
+#define PIPE_MAX_PAGE_BUFS 16  /* Spliced pages queued per pipe */
+#define MSG_QUEUE_SIZE 1024  /* Messages per queue */
+#define MSG_QUEUE_BYTES 65536  /* Payload bytes per queue */
+#define MAX_MSG_SIZE 8192
+#define MSG_TYPE_HASH_BITS 4
+#define MSG_TYPE_BUCKETS (1 << MSG_TYPE_HASH_BITS)
+#define MSG_SLAB_MIN_SHIFT 6  /* Smallest slab object: 64 bytes */
+#define MSG_SLAB_CLASSES 9    /* 64 .. 16384 bytes, fits MAX_MSG_SIZE plus header */
+
+/* A page spliced into a pipe by reference. It follows the ring bytes
+ * written before it was queued, i.e. those below ring_pos. */
+struct pipe_page_buf {
+    u64 page;                   /* Physical page, holds one reference */
+    u32 offset;
+    u32 len;
+    u32 ring_pos;
+};
 
 /* Pipe structure */
 struct pipe {
     u32 id;
     u32 read_fd;
     u32 write_fd;
-    char buffer[PIPE_BUFFER_SIZE];
-    u32 read_pos;
+    char* buffer;               /* Power-of-two ring */
+    u32 capacity;
+    u32 read_pos;               /* Free-running; the offset is pos & (capacity - 1) */
     u32 write_pos;
-    u32 data_size;
+    struct pipe_page_buf page_bufs[PIPE_MAX_PAGE_BUFS];
+    u32 page_head;              /* Free-running indices into page_bufs */
+    u32 page_tail;
+    u32 page_bytes;             /* Data held in spliced pages */
+    u32 readers;                /* Open read ends, over all descriptor tables */
+    u32 writers;                /* Open write ends; none left means EOF */
     bool in_use;
-    struct process* readers[MAX_PROCESSES];
-    struct process* writers[MAX_PROCESSES];
-    u32 reader_count;
-    u32 writer_count;
+    struct wait_queue_head read_wait;
+    struct wait_queue_head write_wait;
 } pipes[MAX_PIPES];
 
-/* Message queue structure */
+/* Message layout in the caller's buffer */
 struct message {
     u32 type;
     u32 size;
-    char data[MAX_MSG_SIZE];
+    char data[];
+};
+
+/* Queued message, sized to its payload and allocated from the message slab */
+struct msg_node {
+    struct msg_node* next;              /* Queue order, or slab free list */
+    struct msg_node* prev;
+    struct msg_node* type_next;         /* FIFO of messages with the same type */
+    struct msg_type_list* type_list;
+    u32 type;
+    u32 size;
+    u32 size_class;
+    char data[];
+};
+
+/* Per-type FIFO, hashed by type and freed when it empties */
+struct msg_type_list {
+    u32 type;
+    struct msg_node* head;
+    struct msg_node* tail;
+    struct msg_type_list* next;         /* Hash chain */
 };
 
 struct message_queue {
     u32 id;
     u32 key;
-    struct message messages[MSG_QUEUE_SIZE];
-    u32 head;
-    u32 tail;
+    struct msg_node* head;
+    struct msg_node* tail;
+    struct msg_type_list* types[MSG_TYPE_BUCKETS];
     u32 count;
+    u32 bytes;
     u32 max_messages;
+    u32 max_bytes;
     u32 max_message_size;
     bool in_use;
-    struct process* waiting_senders[MAX_PROCESSES];
-    struct process* waiting_receivers[MAX_PROCESSES];
-    u32 sender_count;
-    u32 receiver_count;
+    struct wait_queue_head send_wait;
+    struct wait_queue_head recv_wait;
 } message_queues[MAX_MESSAGE_QUEUES];
 
 /* Semaphore structure */
@@ -76,50 +99,75 @@ struct semaphore {
     i32 value;
     i32 max_value;
     bool in_use;
-    struct process* waiting_processes[MAX_PROCESSES];
-    u32 waiting_count;
+    struct wait_queue_head wait;        /* Priority ordered */
 } semaphores[MAX_SEMAPHORES];
 
 /* Shared memory structure */
 struct shared_memory {
     u32 id;
     u32 key;
-    void* address;
-    u32 size;
+    void* address;                      /* Kernel-resident segments (SPSC channels) */
+    u64* frames;                        /* Backing pages, allocated on first touch */
+    u32 nr_frames;
+    bool huge;                          /* frames[] are 2 MB pages */
+    u64 size;
     u32 permissions;
     bool in_use;
-    struct process* attached_processes[MAX_PROCESSES];
-    u32 attach_count;
+    bool removed;                       /* IPC_RMID seen; destroyed at last detach */
+    u32 nattch;
     u32 creator_pid;
 } shared_memory_segments[MAX_SHARED_MEMORY];
 
-/* Signal handler structure */
-struct signal_handler {
-    void (*handler)(int);
-    u32 mask;
-    u32 flags;
-};
+/* RTOS timing and priority structures */
+#define RTOS_MAX_TIMEOUTS 256
 
-/* Process signal state */
-struct signal_state {
-    u32 pending_signals;
-    u32 blocked_signals;
-    struct signal_handler handlers[32];
-};
+/* Hierarchical timing wheel: level n slots are 64^n ticks wide */
+#define TW_LEVELS 4
+#define TW_BITS   6
+#define TW_SIZE   (1 << TW_BITS)
+#define TW_MASK   (TW_SIZE - 1)
+#define TW_MAX_DELTA ((1ULL << (TW_LEVELS * TW_BITS)) - 1)
 
-/* RTOS timing and priority structures */
 struct rtos_timeout {
     u64 deadline_ticks;
-    bool has_timeout;
+    bool has_timeout;                   /* Armed in the wheel */
     struct process* waiting_process;
+    struct rtos_timeout* next;          /* Wheel slot or free list */
+    struct rtos_timeout** pprev;
 };
 
-struct priority_queue {
-    struct process* processes[MAX_PROCESSES];
-    u32 priorities[MAX_PROCESSES];
-    u32 count;
+struct timer_wheel {
+    struct rtos_timeout* slots[TW_LEVELS][TW_SIZE];
+    u64 now;                            /* Last tick processed */
+    u32 pending;
+};
+
+/* Periodic task: a thread released once per period (times in ns, clock_monotonic_ns() base) */
+struct periodic_task {
+    void (*task_function)(void);
+    u32 period_ms;
+    u64 next_execution;                 /* Absolute release instant of the next job */
+    bool active;
+    u32 priority;
+    u32 pid;                            /* Thread running the jobs */
+    bool edf;                           /* Released by the deadline class, not by the tick */
+    volatile u32 pending;               /* Released jobs not yet started */
+    u64 release_time;                   /* Release instant of the pending job */
+
+    /* Response time = release to job completion */
+    u64 releases;
+    u64 overruns;                       /* Releases dropped because a job was still pending */
+    u64 completed;
+    u64 min_response_ns;
+    u64 max_response_ns;
+    u64 total_response_ns;
+    u64 max_start_delay_ns;             /* Release to job start */
 };
 
+static struct periodic_task periodic_tasks[RTOS_MAX_PERIODIC_TASKS];
+static u32 periodic_task_count = 0;
+static u64 next_periodic_release = ~0ULL;  /* Earliest next_execution of tick-released tasks */
+
 /* IPC system state with RTOS enhancements */
 static struct {
     u32 next_pipe_id;
@@ -130,12 +178,11 @@ static struct {
 
     /* RTOS features */
     u64 system_ticks;
-    struct rtos_timeout active_timeouts[MAX_PROCESSES];
-    u32 timeout_count;
-    struct priority_queue rt_ready_queue;
+    struct rtos_timeout timeout_pool[RTOS_MAX_TIMEOUTS];
+    struct rtos_timeout* timeout_free;
+    struct timer_wheel wheel;
     bool preemption_enabled;
-    u32 max_interrupt_latency_us;
-    u32 max_scheduling_latency_us;
+    u32 interrupt_latency_budget_us;
 } ipc_system;
 
 /* RTOS Helper Functions */
@@ -146,74 +193,124 @@ static u64 rtos_get_ticks(void) {
 }
 
 /* Convert milliseconds to ticks (assuming 1000 Hz timer) */
-static u64 rtos_ms_to_ticks(u32 ms) {
+u64 rtos_ms_to_ticks(u32 ms) {
     return (u64)ms;  /* 1 ms = 1 tick at 1000 Hz */
 }
 
-/* Priority queue operations for real-time scheduling */
-static void priority_queue_insert(struct priority_queue* pq, struct process* proc, u32 priority) {
-    if (pq->count >= MAX_PROCESSES) return;
+/* Timing wheel: place a timeout in the slot matching its distance from now */
+static void wheel_insert(struct timer_wheel* tw, struct rtos_timeout* timeout) {
+    u64 expires = timeout->deadline_ticks;
+    if (expires <= tw->now) {
+        expires = tw->now + 1;  /* Already due: fire on the next tick */
+    }
+
+    /* Beyond the wheel's range: park in the last level, re-cascaded until due */
+    u64 delta = expires - tw->now;
+    if (delta > TW_MAX_DELTA) {
+        expires = tw->now + TW_MAX_DELTA;
+        delta = TW_MAX_DELTA;
+    }
 
-    /* Insert in priority order (higher priority = lower number) */
-    u32 i = pq->count;
-    while (i > 0 && pq->priorities[i-1] > priority) {
-        pq->processes[i] = pq->processes[i-1];
-        pq->priorities[i] = pq->priorities[i-1];
-        i--;
+    u32 level = 0;
+    while (level < TW_LEVELS - 1 && delta >= (1ULL << ((level + 1) * TW_BITS))) {
+        level++;
     }
 
-    pq->processes[i] = proc;
-    pq->priorities[i] = priority;
-    pq->count++;
+    struct rtos_timeout** slot = &tw->slots[level][(expires >> (level * TW_BITS)) & TW_MASK];
+    timeout->next = *slot;
+    if (*slot) (*slot)->pprev = &timeout->next;
+    timeout->pprev = slot;
+    *slot = timeout;
 }
 
-static struct process* priority_queue_remove_highest(struct priority_queue* pq) {
-    if (pq->count == 0) return NULL;
+static void wheel_unlink(struct rtos_timeout* timeout) {
+    *timeout->pprev = timeout->next;
+    if (timeout->next) timeout->next->pprev = timeout->pprev;
+    timeout->next = NULL;
+    timeout->pprev = NULL;
+}
 
-    struct process* proc = pq->processes[0];
+/* Move one slot of an upper level down to finer slots; returns the slot index */
+static u32 wheel_cascade(struct timer_wheel* tw, u32 level) {
+    u32 index = (tw->now >> (level * TW_BITS)) & TW_MASK;
+    struct rtos_timeout* timeout = tw->slots[level][index];
+    tw->slots[level][index] = NULL;
 
-    /* Shift remaining processes */
-    for (u32 i = 0; i < pq->count - 1; i++) {
-        pq->processes[i] = pq->processes[i + 1];
-        pq->priorities[i] = pq->priorities[i + 1];
+    while (timeout) {
+        struct rtos_timeout* next = timeout->next;
+        wheel_insert(tw, timeout);
+        timeout = next;
     }
-    pq->count--;
-
-    return proc;
+    return index;
 }
 
-/* Add timeout for RTOS operations */
-static void rtos_add_timeout(struct process* proc, u32 timeout_ms) {
-    if (ipc_system.timeout_count >= MAX_PROCESSES) return;
+/* Add timeout for RTOS operations; returns a handle for rtos_cancel_timeout */
+static struct rtos_timeout* rtos_add_timeout(struct process* proc, u32 timeout_ms) {
+    struct rtos_timeout* timeout = ipc_system.timeout_free;
+    if (!timeout) return NULL;
+    ipc_system.timeout_free = timeout->next;
 
-    struct rtos_timeout* timeout = &ipc_system.active_timeouts[ipc_system.timeout_count++];
     timeout->deadline_ticks = rtos_get_ticks() + rtos_ms_to_ticks(timeout_ms);
     timeout->has_timeout = true;
     timeout->waiting_process = proc;
+    wheel_insert(&ipc_system.wheel, timeout);
+    ipc_system.wheel.pending++;
+
+    return timeout;
+}
+
+static void rtos_free_timeout(struct rtos_timeout* timeout) {
+    timeout->has_timeout = false;
+    timeout->waiting_process = NULL;
+    timeout->next = ipc_system.timeout_free;
+    ipc_system.timeout_free = timeout;
+    ipc_system.wheel.pending--;
+}
+
+/* Disarm a timeout whose wait completed first. A handle that already fired
+ * may have been recycled for another waiter, so the owner must match. */
+static void rtos_cancel_timeout(struct rtos_timeout* timeout, struct process* owner) {
+    if (!timeout || !timeout->has_timeout || timeout->waiting_process != owner) return;
+
+    wheel_unlink(timeout);
+    rtos_free_timeout(timeout);
 }
 
-/* Check and handle expired timeouts */
+/* Advance the wheel by one tick and fire what is due - constant work per tick
+ * apart from the expired timers themselves and an occasional cascade. The only
+ * caller is rtos_tick_handler on IRQ0; timed waits do not poll the wheel. */
 static void rtos_check_timeouts(void) {
-    u64 current_ticks = rtos_get_ticks();
-
-    for (u32 i = 0; i < ipc_system.timeout_count; i++) {
-        struct rtos_timeout* timeout = &ipc_system.active_timeouts[i];
-
-        if (timeout->has_timeout && current_ticks >= timeout->deadline_ticks) {
-            /* Timeout expired - wake up process */
-            if (timeout->waiting_process->state == PROCESS_BLOCKED) {
-                timeout->waiting_process->state = PROCESS_READY;
-                priority_queue_insert(&ipc_system.rt_ready_queue,
-                                    timeout->waiting_process,
-                                    timeout->waiting_process->priority);
+    struct timer_wheel* tw = &ipc_system.wheel;
+
+    while (tw->now < rtos_get_ticks()) {
+        tw->now++;
+
+        /* Level 0 wrapped: pull the next slot of each coarser level down */
+        u32 index = tw->now & TW_MASK;
+        if (index == 0) {
+            for (u32 level = 1; level < TW_LEVELS; level++) {
+                if (wheel_cascade(tw, level) != 0) break;
             }
+        }
+
+        struct rtos_timeout* timeout = tw->slots[0][index];
+        tw->slots[0][index] = NULL;
 
-            /* Remove timeout */
-            for (u32 j = i; j < ipc_system.timeout_count - 1; j++) {
-                ipc_system.active_timeouts[j] = ipc_system.active_timeouts[j + 1];
+        while (timeout) {
+            struct rtos_timeout* next = timeout->next;
+
+            if (timeout->deadline_ticks > tw->now) {
+                /* Clamped long timeout: not due yet */
+                wheel_insert(tw, timeout);
+            } else {
+                /* Timeout expired - wake up process */
+                struct process* proc = timeout->waiting_process;
+                rtos_free_timeout(timeout);
+                if (proc->state == PROCESS_BLOCKED) {
+                    cfs_wake_up_process(proc);
+                }
             }
-            ipc_system.timeout_count--;
-            i--; /* Recheck this index */
+            timeout = next;
         }
     }
 }
@@ -235,6 +332,8 @@ void ipc_init(void) {
 
     for (u32 i = 0; i < MAX_SHARED_MEMORY; i++) {
         shared_memory_segments[i].in_use = false;
+        shared_memory_segments[i].frames = NULL;
+        shared_memory_segments[i].address = NULL;
     }
 
     /* Initialize RTOS features */
@@ -243,11 +342,16 @@ void ipc_init(void) {
     ipc_system.next_sem_id = 1;
     ipc_system.next_shm_id = 1;
     ipc_system.system_ticks = 0;
-    ipc_system.timeout_count = 0;
-    ipc_system.rt_ready_queue.count = 0;
+    memset(&ipc_system.wheel, 0, sizeof(ipc_system.wheel));
+    ipc_system.timeout_free = NULL;
+    for (u32 i = 0; i < RTOS_MAX_TIMEOUTS; i++) {
+        ipc_system.timeout_pool[i].has_timeout = false;
+        ipc_system.timeout_pool[i].next = ipc_system.timeout_free;
+        ipc_system.timeout_free = &ipc_system.timeout_pool[i];
+    }
     ipc_system.preemption_enabled = true;
-    ipc_system.max_interrupt_latency_us = 10;  /* 10 microseconds max */
-    ipc_system.max_scheduling_latency_us = 100; /* 100 microseconds max */
+    ipc_system.interrupt_latency_budget_us = 10;  /* 10 microseconds max */
+    irq_set_latency_budget((u64)ipc_system.interrupt_latency_budget_us * 1000);
     ipc_system.initialized = true;
 
     vga_puts("RTOS-enhanced IPC system initialized\n");
@@ -256,6 +360,243 @@ void ipc_init(void) {
 
 /* PIPES */
 
+static inline u32 pipe_ring_used(struct pipe* p) {
+    return p->write_pos - p->read_pos;
+}
+
+/* Everything a reader can consume: ring bytes plus spliced pages */
+static inline u32 pipe_data(struct pipe* p) {
+    return pipe_ring_used(p) + p->page_bytes;
+}
+
+static inline bool pipe_pages_full(struct pipe* p) {
+    return p->page_tail - p->page_head >= PIPE_MAX_PAGE_BUFS;
+}
+
+static inline struct pipe_page_buf* pipe_page_head(struct pipe* p) {
+    return p->page_head != p->page_tail ? &p->page_bufs[p->page_head % PIPE_MAX_PAGE_BUFS] : NULL;
+}
+
+/* Ring bytes that come before the next spliced page */
+static u32 pipe_ring_run(struct pipe* p) {
+    struct pipe_page_buf* buf = pipe_page_head(p);
+    return buf ? buf->ring_pos - p->read_pos : pipe_ring_used(p);
+}
+
+/* Copy out of the ring: at most two contiguous spans */
+static void pipe_copy_out(struct pipe* p, char* dst, u32 len) {
+    u32 offset = p->read_pos & (p->capacity - 1);
+    u32 first = p->capacity - offset;
+    if (first > len) {
+        first = len;
+    }
+    
+    memcpy(dst, p->buffer + offset, first);
+    memcpy(dst + first, p->buffer, len - first);
+    p->read_pos += len;
+}
+
+/* Copy into the ring: at most two contiguous spans */
+static void pipe_copy_in(struct pipe* p, const char* src, u32 len) {
+    u32 offset = p->write_pos & (p->capacity - 1);
+    u32 first = p->capacity - offset;
+    if (first > len) {
+        first = len;
+    }
+    
+    memcpy(p->buffer + offset, src, first);
+    memcpy(p->buffer, src + first, len - first);
+    p->write_pos += len;
+}
+
+/* Queue a page behind the ring bytes written so far; takes the caller's reference */
+static void pipe_queue_page(struct pipe* p, u64 page, u32 offset, u32 len) {
+    struct pipe_page_buf* buf = &p->page_bufs[p->page_tail++ % PIPE_MAX_PAGE_BUFS];
+    buf->page = page;
+    buf->offset = offset;
+    buf->len = len;
+    buf->ring_pos = p->write_pos;
+    p->page_bytes += len;
+}
+
+/* Consume bytes from the head page, dropping the pipe's reference once it is empty */
+static void pipe_page_advance(struct pipe* p, struct pipe_page_buf* buf, u32 len) {
+    buf->offset += len;
+    buf->len -= len;
+    p->page_bytes -= len;
+    
+    if (buf->len == 0) {
+        pmm_free_page(buf->page);
+        p->page_head++;
+    }
+}
+
+/* Copy up to len bytes out in stream order, across ring runs and spliced pages */
+static u32 pipe_consume(struct pipe* p, char* dst, u32 len) {
+    u32 done = 0;
+    
+    while (done < len) {
+        u32 chunk = pipe_ring_run(p);
+        if (chunk) {
+            if (chunk > len - done) {
+                chunk = len - done;
+            }
+            pipe_copy_out(p, dst + done, chunk);
+            done += chunk;
+            continue;
+        }
+        
+        struct pipe_page_buf* buf = pipe_page_head(p);
+        if (!buf) {
+            break;
+        }
+        
+        chunk = buf->len;
+        if (chunk > len - done) {
+            chunk = len - done;
+        }
+        memcpy(dst + done, (char*)buf->page + buf->offset, chunk);
+        pipe_page_advance(p, buf, chunk);
+        done += chunk;
+    }
+    
+    return done;
+}
+
+/* Data arrived: wake one reader, and hand on to the next writer if room is left.
+ * Each woken task passes the wakeup on, so nobody is woken for nothing. */
+static void pipe_wake_readers(struct pipe* p) {
+    wake_up(&p->read_wait);
+    if (pipe_ring_used(p) < p->capacity || !pipe_pages_full(p)) {
+        wake_up(&p->write_wait);
+    }
+}
+
+/* Space freed: wake one writer, and the next reader if data is left */
+static void pipe_wake_writers(struct pipe* p) {
+    wake_up(&p->write_wait);
+    if (pipe_data(p) > 0) {
+        wake_up(&p->read_wait);
+    }
+}
+
+/* Block until there is something to read. Returns 1 then, 0 at EOF and
+ * -EINTR if a signal came first. */
+static i32 pipe_wait_data(struct pipe* p) {
+    struct wait_queue_entry wait;
+    wait_entry_init(&wait, WQ_FLAG_EXCLUSIVE, NULL, NULL);
+    struct process* current = get_current_process();
+    
+    disable_interrupts();
+    while (pipe_data(p) == 0) {
+        if (p->writers == 0) {
+            enable_interrupts();
+            return 0;  /* EOF - no writers */
+        }
+        if (signal_pending(current)) {
+            enable_interrupts();
+            return -EINTR;
+        }
+        
+        wait_queue_sleep(&p->read_wait, &wait);  /* Block until data available */
+    }
+    enable_interrupts();
+    return 1;
+}
+
+/* Block until the ring has room for need bytes. Returns 0 then, -EPIPE once
+ * no reader is left, -EINTR on a signal. */
+static i32 pipe_wait_ring_space(struct pipe* p, u32 need) {
+    struct wait_queue_entry wait;
+    wait_entry_init(&wait, WQ_FLAG_EXCLUSIVE, NULL, NULL);
+    struct process* current = get_current_process();
+    i32 result = 0;
+    
+    disable_interrupts();
+    while (p->capacity - pipe_ring_used(p) < need) {
+        if (p->readers == 0) {
+            result = -EPIPE;
+            break;
+        }
+        if (signal_pending(current)) {
+            result = -EINTR;
+            break;
+        }
+        wait_queue_sleep(&p->write_wait, &wait);
+    }
+    if (p->readers == 0) {
+        result = -EPIPE;
+    }
+    enable_interrupts();
+    return result;
+}
+
+/* Block until a spliced-page slot is free; results as pipe_wait_ring_space */
+static i32 pipe_wait_page_slot(struct pipe* p) {
+    struct wait_queue_entry wait;
+    wait_entry_init(&wait, WQ_FLAG_EXCLUSIVE, NULL, NULL);
+    struct process* current = get_current_process();
+    i32 result = 0;
+    
+    disable_interrupts();
+    while (pipe_pages_full(p)) {
+        if (p->readers == 0) {
+            result = -EPIPE;
+            break;
+        }
+        if (signal_pending(current)) {
+            result = -EINTR;
+            break;
+        }
+        wait_queue_sleep(&p->write_wait, &wait);
+    }
+    if (p->readers == 0) {
+        result = -EPIPE;
+    }
+    enable_interrupts();
+    return result;
+}
+
+/* Writing with no reader left raises SIGPIPE; false in that case */
+static bool pipe_has_readers(struct pipe* p) {
+    if (p->readers == 0) {
+        signal_send(get_current_process()->pid, SIGPIPE);
+        return false;
+    }
+    return true;
+}
+
+/* Copy into the ring, blocking for space; writes up to PIPE_BUF go in whole.
+ * Returns the bytes written, or the wait's error if there were none. */
+static i32 pipe_ring_write(struct pipe* p, const char* buf, u32 size) {
+    u32 bytes_written = 0;
+    
+    while (bytes_written < size) {
+        u32 remaining = size - bytes_written;
+        
+        /* Small writes go in whole; large ones stream as space frees up */
+        u32 need = (size <= PIPE_BUF) ? remaining : 1;
+        
+        /* Block if pipe full; stop short if the last reader goes or a signal comes */
+        i32 err = pipe_wait_ring_space(p, need);
+        if (err) {
+            return bytes_written ? (i32)bytes_written : err;
+        }
+        
+        u32 chunk = p->capacity - pipe_ring_used(p);
+        if (chunk > remaining) {
+            chunk = remaining;
+        }
+        pipe_copy_in(p, buf + bytes_written, chunk);
+        bytes_written += chunk;
+        
+        /* Wake up waiting readers */
+        pipe_wake_readers(p);
+    }
+    
+    return bytes_written;
+}
+
 /* Create pipe */
 i32 pipe_create(i32 pipefd[2]) {
     /* Find free pipe slot */
@@ -271,15 +612,25 @@ i32 pipe_create(i32 pipefd[2]) {
         return -1;  /* No free pipes */
     }
     
+    p->buffer = (char*)kmalloc(PIPE_BUFFER_SIZE);
+    if (!p->buffer) {
+        return -1;
+    }
+    
     /* Initialize pipe */
     p->id = ipc_system.next_pipe_id++;
     p->read_fd = fd_allocate();
     p->write_fd = fd_allocate();
+    p->capacity = PIPE_BUFFER_SIZE;
     p->read_pos = 0;
     p->write_pos = 0;
-    p->data_size = 0;
-    p->reader_count = 0;
-    p->writer_count = 0;
+    p->page_head = 0;
+    p->page_tail = 0;
+    p->page_bytes = 0;
+    p->readers = 1;
+    p->writers = 1;
+    wait_queue_init(&p->read_wait);
+    wait_queue_init(&p->write_wait);
     p->in_use = true;
     
     /* Set up file descriptors */
@@ -289,49 +640,93 @@ i32 pipe_create(i32 pipefd[2]) {
     /* Register with current process */
     struct process* current = get_current_process();
     if (current) {
-        current->fd_table[p->read_fd] = (struct file_descriptor*)p;
-        current->fd_table[p->write_fd] = (struct file_descriptor*)p;
+        current->files->fd_table[p->read_fd] = (struct file_descriptor*)p;
+        current->files->fd_table[p->write_fd] = (struct file_descriptor*)p;
     }
     
     return 0;
 }
 
+/* Resize a pipe's ring (rounded up to a power of two, PAGE_SIZE..PIPE_MAX_SIZE).
+ * Returns the new capacity, or -EBUSY if the buffered data would not fit. */
+i32 pipe_set_size(u32 pipe_id, u32 size) {
+    if (pipe_id >= MAX_PIPES || !pipes[pipe_id].in_use) {
+        return -EBADF;
+    }
+    if (size > PIPE_MAX_SIZE) {
+        return -EPERM;
+    }
+    
+    struct pipe* p = &pipes[pipe_id];
+    
+    u32 capacity = PAGE_SIZE;
+    while (capacity < size) {
+        capacity <<= 1;
+    }
+    
+    u32 used = pipe_ring_used(p);
+    if (capacity == p->capacity) {
+        return capacity;
+    }
+    if (used > capacity) {
+        return -EBUSY;
+    }
+    
+    char* buffer = (char*)kmalloc(capacity);
+    if (!buffer) {
+        return -ENOMEM;
+    }
+    
+    /* Queued pages keep their place relative to the ring data */
+    for (u32 i = p->page_head; i != p->page_tail; i++) {
+        p->page_bufs[i % PIPE_MAX_PAGE_BUFS].ring_pos -= p->read_pos;
+    }
+    
+    /* Linearise the buffered data at the start of the new ring */
+    pipe_copy_out(p, buffer, used);
+    kfree(p->buffer);
+    p->buffer = buffer;
+    p->capacity = capacity;
+    p->read_pos = 0;
+    p->write_pos = used;
+    
+    return capacity;
+}
+
+/* Current ring capacity */
+i32 pipe_get_size(u32 pipe_id) {
+    if (pipe_id >= MAX_PIPES || !pipes[pipe_id].in_use) {
+        return -EBADF;
+    }
+    return (i32)pipes[pipe_id].capacity;
+}
+
 /* Read from pipe */
 i32 pipe_read(u32 pipe_id, void* buffer, u32 size) {
     struct pipe* p = &pipes[pipe_id];
     if (!p->in_use) {
         return -1;
     }
-    
-    /* Block if no data available */
-    while (p->data_size == 0) {
-        if (p->writer_count == 0) {
-            return 0;  /* EOF - no writers */
-        }
-        
-        /* Add to waiting readers */
-        struct process* current = get_current_process();
-        p->readers[p->reader_count++] = current;
-        current->state = PROCESS_BLOCKED;
-        schedule();  /* Block until data available */
+    if (size == 0) {
+        return 0;
     }
     
-    /* Read data */
+    /* Another reader can drain the pipe between our wakeup and the copy;
+     * only the wait reporting EOF may end the read with 0 */
     u32 bytes_read = 0;
-    char* buf = (char*)buffer;
+    while (bytes_read == 0) {
+        /* Block if no data available */
+        i32 ready = pipe_wait_data(p);
+        if (ready <= 0) {
+            return ready;
+        }
     
-    while (bytes_read < size && p->data_size > 0) {
-        buf[bytes_read++] = p->buffer[p->read_pos];
-        p->read_pos = (p->read_pos + 1) % PIPE_BUFFER_SIZE;
-        p->data_size--;
+        /* Read whatever is buffered, up to size */
+        bytes_read = pipe_consume(p, (char*)buffer, size);
     }
     
     /* Wake up waiting writers */
-    for (u32 i = 0; i < p->writer_count; i++) {
-        p->writers[i]->state = PROCESS_READY;
-        cfs_enqueue_task(p->writers[i]);
-    }
-    p->writer_count = 0;
+    pipe_wake_writers(p);
     
     return bytes_read;
 }
@@ -343,196 +738,711 @@ i32 pipe_write(u32 pipe_id, const void* buffer, u32 size) {
         return -1;
     }
     
-    if (p->reader_count == 0) {
-        /* No readers - send SIGPIPE */
-        signal_send(get_current_process()->pid, SIGPIPE);
-        return -1;
+    if (!pipe_has_readers(p)) {
+        return -EPIPE;
     }
     
-    /* Block if pipe full */
-    while (p->data_size >= PIPE_BUFFER_SIZE - size) {
-        struct process* current = get_current_process();
-        p->writers[p->writer_count++] = current;
-        current->state = PROCESS_BLOCKED;
-        schedule();  /* Block until space available */
+    /* A reader leaving mid-write cuts it short; with nothing written, EPIPE */
+    i32 written = pipe_ring_write(p, (const char*)buffer, size);
+    if (written == -EPIPE) {
+        signal_send(get_current_process()->pid, SIGPIPE);
     }
-    
-    /* Write data */
-    u32 bytes_written = 0;
-    const char* buf = (const char*)buffer;
-    
-    while (bytes_written < size && p->data_size < PIPE_BUFFER_SIZE) {
-        p->buffer[p->write_pos] = buf[bytes_written++];
-        p->write_pos = (p->write_pos + 1) % PIPE_BUFFER_SIZE;
-        p->data_size++;
+    return written;
+}
+
+/* Pipes store themselves in fd_table; map an entry back to its pipe */
+static struct pipe* pipe_of_entry(struct file_descriptor* entry) {
+    struct pipe* p = (struct pipe*)entry;
+    if (p < pipes || p >= pipes + MAX_PIPES || !p->in_use) {
+        return NULL;
+    }
+    return p;
+}
+
+static struct pipe* pipe_from_fd(i32 fd) {
+    struct process* current = get_current_process();
+    if (!current || fd < 0 || fd >= MAX_FD_PER_PROCESS) {
+        return NULL;
+    }
+    return pipe_of_entry(current->files->fd_table[fd]);
+}
+
+/* Both ends are closed: drop the buffered data. The slot is reused only
+ * once no epoll item is hooked on its queues any more. */
+static void pipe_release(struct pipe* p) {
+    if (!p->in_use || p->readers > 0 || p->writers > 0) {
+        return;
     }
     
-    /* Wake up waiting readers */
-    for (u32 i = 0; i < p->reader_count; i++) {
-        p->readers[i]->state = PROCESS_READY;
-        cfs_enqueue_task(p->readers[i]);
+    if (p->buffer) {
+        for (u32 i = p->page_head; i != p->page_tail; i++) {
+            pmm_free_page(p->page_bufs[i % PIPE_MAX_PAGE_BUFS].page);
+        }
+        kfree(p->buffer);
+        p->buffer = NULL;
+        p->read_pos = 0;
+        p->write_pos = 0;
+        p->page_head = 0;
+        p->page_tail = 0;
+        p->page_bytes = 0;
     }
-    p->reader_count = 0;
     
-    return bytes_written;
+    if (!wait_queue_active(&p->read_wait) && !wait_queue_active(&p->write_wait)) {
+        p->in_use = false;
+    }
 }
 
-/* MESSAGE QUEUES */
+/* A descriptor table took a copy of entry at fd (fork): count the end again.
+ * False if the entry is not a pipe end. */
+bool pipe_end_get(struct file_descriptor* entry, u32 fd) {
+    struct pipe* p = pipe_of_entry(entry);
+    if (!p) {
+        return false;
+    }
+    
+    u64 irq_flags = irq_save();
+    if (fd == p->read_fd) {
+        p->readers++;
+    } else {
+        p->writers++;
+    }
+    irq_restore(irq_flags);
+    return true;
+}
 
-/* Create message queue */
-i32 msgget(u32 key, i32 flags) {
-    /* Find existing queue with key */
-    for (u32 i = 0; i < MAX_MESSAGE_QUEUES; i++) {
-        if (message_queues[i].in_use && message_queues[i].key == key) {
-            return message_queues[i].id;
+/* Drop the end held at fd (close, or the table itself going away). The last
+ * writer wakes readers into EOF, the last reader wakes writers into EPIPE.
+ * False if the entry is not a pipe end. */
+bool pipe_end_put(struct file_descriptor* entry, u32 fd) {
+    struct pipe* p = pipe_of_entry(entry);
+    if (!p) {
+        return false;
+    }
+    
+    u64 irq_flags = irq_save();
+    if (fd == p->read_fd) {
+        if (p->readers > 0 && --p->readers == 0) {
+            wake_up_all(&p->write_wait);
+        }
+    } else {
+        if (p->writers > 0 && --p->writers == 0) {
+            wake_up_all(&p->read_wait);
         }
     }
+    pipe_release(p);
+    irq_restore(irq_flags);
+    return true;
+}
+
+/* F_GETPIPE_SZ / F_SETPIPE_SZ; the only fcntl commands pipes understand */
+i32 pipe_fcntl(i32 fd, i32 cmd, u32 arg) {
+    struct pipe* p = pipe_from_fd(fd);
+    if (!p) {
+        return -EBADF;
+    }
     
-    /* Create new queue if IPC_CREAT flag set */
-    if (!(flags & IPC_CREAT)) {
-        return -1;
+    switch (cmd) {
+        case F_GETPIPE_SZ:
+            return pipe_get_size((u32)(p - pipes));
+        case F_SETPIPE_SZ:
+            return pipe_set_size((u32)(p - pipes), arg);
+        default:
+            return -EINVAL;
     }
+}
+
+/* Gift user pages to the pipe. Whole, aligned pages are queued by reference
+ * (and become copy-on-write for the sender); partial pages go through the ring. */
+static i64 vmsplice_to_pipe(struct pipe* p, const char* src, u64 len) {
+    u64 done = 0;
     
-    /* Find free slot */
-    struct message_queue* mq = NULL;
-    for (u32 i = 0; i < MAX_MESSAGE_QUEUES; i++) {
-        if (!message_queues[i].in_use) {
-            mq = &message_queues[i];
-            break;
+    while (done < len) {
+        u64 addr = (u64)(src + done);
+        u64 chunk = PAGE_SIZE - (addr & (PAGE_SIZE - 1));
+        if (chunk > len - done) {
+            chunk = len - done;
+        }
+        
+        if (chunk == PAGE_SIZE) {
+            i32 err = pipe_wait_page_slot(p);
+            if (err) {
+                return done ? (i64)done : err;
+            }
+            
+            u64 page = vmm_share_user_page(addr);
+            if (page) {
+                pipe_queue_page(p, page, 0, PAGE_SIZE);
+                pipe_wake_readers(p);
+                done += PAGE_SIZE;
+                continue;
+            }
+        }
+        
+        /* Partial or unmapped page: copy (touching it faults it in) */
+        i32 written = pipe_ring_write(p, src + done, (u32)chunk);
+        if (written < 0) {
+            return done ? (i64)done : written;
+        }
+        done += written;
+        if ((u64)written < chunk) {
+            break;  /* Last reader went, or a signal came */
         }
     }
     
-    if (!mq) {
-        return -1;
+    return done;
+}
+
+/* Move pipe data into user memory. Whole spliced pages landing on a page
+ * boundary are mapped in copy-on-write; everything else is copied. */
+static i64 vmsplice_from_pipe(struct pipe* p, char* dst, u64 len) {
+    u64 done = 0;
+    if (len == 0) {
+        return 0;
     }
     
-    /* Initialize message queue */
-    mq->id = ipc_system.next_msgq_id++;
-    mq->key = key;
-    mq->head = 0;
-    mq->tail = 0;
-    mq->count = 0;
-    mq->max_messages = MSG_QUEUE_SIZE;
-    mq->max_message_size = MAX_MSG_SIZE;
-    mq->sender_count = 0;
-    mq->receiver_count = 0;
-    mq->in_use = true;
+    /* As in pipe_read, data seen at wakeup may be gone by now: wait again */
+    while (done == 0) {
+        i32 ready = pipe_wait_data(p);
+        if (ready <= 0) {
+            return ready;
+        }
     
-    return mq->id;
+        while (done < len && pipe_data(p) > 0) {
+            u64 addr = (u64)(dst + done);
+            struct pipe_page_buf* buf = pipe_page_head(p);
+            u32 chunk = pipe_ring_run(p);
+        
+            if (chunk == 0) {
+                if (buf->offset == 0 && buf->len == PAGE_SIZE &&
+                    (addr & (PAGE_SIZE - 1)) == 0 && len - done >= PAGE_SIZE &&
+                    vmm_map_cow_page(addr, buf->page) == 0) {
+                    /* The mapping now owns the pipe's reference */
+                    p->page_bytes -= PAGE_SIZE;
+                    p->page_head++;
+                    done += PAGE_SIZE;
+                    continue;
+                }
+                chunk = buf->len;
+            }
+        
+            if (chunk > len - done) {
+                chunk = (u32)(len - done);
+            }
+            done += pipe_consume(p, dst + done, chunk);
+        }
+    }
+    
+    pipe_wake_writers(p);
+    return done;
 }
 
-/* Send message */
-i32 msgsnd(i32 msgqid, const void* msgp, u32 msgsz, i32 msgflg) {
-    struct message_queue* mq = &message_queues[msgqid];
-    if (!mq->in_use) {
+/* vmsplice: user memory <-> pipe by page reference where alignment allows.
+ * The direction follows the end of the pipe fd refers to. */
+i64 vmsplice(i32 fd, const struct iovec* iov, u32 nr_segs, u32 flags) {
+    (void)flags;
+    
+    struct pipe* p = pipe_from_fd(fd);
+    if (!p) {
         return -1;
     }
     
-    if (msgsz > MAX_MSG_SIZE) {
-        return -1;
+    bool to_pipe = ((u32)fd == p->write_fd);
+    i64 total = 0;
+    
+    if (to_pipe && !pipe_has_readers(p)) {
+        return -EPIPE;
     }
     
-    /* Block if queue full */
-    while (mq->count >= mq->max_messages) {
-        if (msgflg & IPC_NOWAIT) {
-            return -1;
+    for (u32 i = 0; i < nr_segs; i++) {
+        i64 n = to_pipe ? vmsplice_to_pipe(p, (const char*)iov[i].iov_base, iov[i].iov_len)
+                        : vmsplice_from_pipe(p, (char*)iov[i].iov_base, iov[i].iov_len);
+        if (n < 0) {
+            return total ? total : n;
         }
+        total += n;
         
-        struct process* current = get_current_process();
-        mq->waiting_senders[mq->sender_count++] = current;
-        current->state = PROCESS_BLOCKED;
-        schedule();
+        /* A short read means the pipe drained */
+        if ((u64)n < iov[i].iov_len) {
+            break;
+        }
     }
     
-    /* Add message to queue */
-    struct message* msg = &mq->messages[mq->tail];
-    const struct message* input_msg = (const struct message*)msgp;
+    return total;
+}
+
+/* File -> pipe: read straight into fresh pages and queue them. *pos is the
+ * descriptor's offset, or the caller's off_in. */
+static i64 splice_file_to_pipe(struct file_descriptor* in, u64* pos, struct pipe* p, u64 len) {
+    u64 done = 0;
+    
+    while (done < len) {
+        i32 err = pipe_wait_page_slot(p);
+        if (err) {
+            return done ? (i64)done : err;
+        }
+        
+        u64 page = pmm_alloc_page();
+        if (!page) {
+            break;
+        }
+        
+        u64 chunk = len - done;
+        if (chunk > PAGE_SIZE) {
+            chunk = PAGE_SIZE;
+        }
+        
+        i64 n = file_read(in->file, *pos, (void*)page, chunk);
+        if (n <= 0) {
+            pmm_free_page(page);
+            break;
+        }
+        *pos += n;
+        
+        pipe_queue_page(p, page, 0, (u32)n);
+        pipe_wake_readers(p);
+        done += n;
+        
+        if ((u64)n < chunk) {
+            break;  /* End of file */
+        }
+    }
+    
+    return done;
+}
+
+/* Pipe -> file: write directly from ring spans and spliced pages */
+static i64 splice_pipe_to_file(struct pipe* p, struct file_descriptor* out, u64* pos, u64 len) {
+    u64 done = 0;
+    
+    i32 ready = pipe_wait_data(p);
+    if (ready <= 0) {
+        return ready;
+    }
+    
+    while (done < len && pipe_data(p) > 0) {
+        struct pipe_page_buf* buf = NULL;
+        const char* src;
+        u32 chunk = pipe_ring_run(p);
+        
+        if (chunk) {
+            u32 offset = p->read_pos & (p->capacity - 1);
+            if (chunk > p->capacity - offset) {
+                chunk = p->capacity - offset;
+            }
+            src = p->buffer + offset;
+        } else {
+            buf = pipe_page_head(p);
+            chunk = buf->len;
+            src = (const char*)buf->page + buf->offset;
+        }
+        
+        if (chunk > len - done) {
+            chunk = (u32)(len - done);
+        }
+        
+        i64 n = file_write(out->file, *pos, src, chunk);
+        if (n <= 0) {
+            break;
+        }
+        *pos += n;
+        
+        if (buf) {
+            pipe_page_advance(p, buf, (u32)n);
+        } else {
+            p->read_pos += n;
+        }
+        done += n;
+    }
+    
+    pipe_wake_writers(p);
+    return done;
+}
+
+/* splice: move data between a pipe and a file without a user-space copy.
+ * Linux ABI: exactly one side must be a pipe, whose offset must be NULL.
+ * A file offset, if given, is used and advanced instead of the descriptor's. */
+i64 splice(i32 fd_in, i64* off_in, i32 fd_out, i64* off_out, size_t len, u32 flags) {
+    (void)flags;
+    
+    struct process* current = get_current_process();
+    struct pipe* pipe_in = pipe_from_fd(fd_in);
+    struct pipe* pipe_out = pipe_from_fd(fd_out);
+    
+    if (!current || (pipe_in == NULL && pipe_out == NULL)) {
+        return -EINVAL;
+    }
+    if (pipe_in && pipe_out) {
+        return -EINVAL;  /* Pipe to pipe (tee) is not supported */
+    }
+    if ((pipe_in && off_in) || (pipe_out && off_out)) {
+        return -ESPIPE;
+    }
+    
+    i32 file_fd = pipe_out ? fd_in : fd_out;
+    i64* file_off = pipe_out ? off_in : off_out;
+    if (file_fd < 0 || file_fd >= MAX_FD_PER_PROCESS || !current->files->fd_table[file_fd]) {
+        return -EBADF;
+    }
+    if (file_off && *file_off < 0) {
+        return -EINVAL;
+    }
+    
+    struct file_descriptor* file = current->files->fd_table[file_fd];
+    u64 pos = file_off ? (u64)*file_off : file->offset;
+    i64 result;
+    
+    if (pipe_out) {
+        if ((u32)fd_out != pipe_out->write_fd) {
+            return -EBADF;
+        }
+        if (!pipe_has_readers(pipe_out)) {
+            return -EPIPE;
+        }
+        result = splice_file_to_pipe(file, &pos, pipe_out, len);
+    } else {
+        if ((u32)fd_in != pipe_in->read_fd) {
+            return -EBADF;
+        }
+        result = splice_pipe_to_file(pipe_in, file, &pos, len);
+    }
+    
+    if (file_off) {
+        *file_off = (i64)pos;
+    } else {
+        file->offset = pos;
+    }
+    return result;
+}
+
+/* MESSAGE QUEUES */
+
+/* Message slab: power-of-two size classes carved out of page-sized chunks.
+ * Freed messages go back to their class, so steady traffic never hits kmalloc. */
+static struct msg_node* msg_slab_free[MSG_SLAB_CLASSES];
+
+static struct msg_node* msg_alloc(u32 size) {
+    u32 total = sizeof(struct msg_node) + size;
+    u32 cls = 0;
+    while ((1U << (MSG_SLAB_MIN_SHIFT + cls)) < total) {
+        cls++;
+    }
+    
+    if (!msg_slab_free[cls]) {
+        u32 object_size = 1U << (MSG_SLAB_MIN_SHIFT + cls);
+        u32 chunk_size = object_size > PAGE_SIZE ? object_size : PAGE_SIZE;
+        char* chunk = (char*)kmalloc(chunk_size);
+        if (!chunk) {
+            return NULL;
+        }
+        
+        for (u32 offset = 0; offset + object_size <= chunk_size; offset += object_size) {
+            struct msg_node* node = (struct msg_node*)(chunk + offset);
+            node->next = msg_slab_free[cls];
+            msg_slab_free[cls] = node;
+        }
+    }
+    
+    struct msg_node* node = msg_slab_free[cls];
+    msg_slab_free[cls] = node->next;
+    node->size_class = cls;
+    return node;
+}
+
+static void msg_free(struct msg_node* node) {
+    node->next = msg_slab_free[node->size_class];
+    msg_slab_free[node->size_class] = node;
+}
+
+static struct message_queue* msgq_get(i32 msgqid) {
+    if (msgqid < 0 || msgqid >= MAX_MESSAGE_QUEUES || !message_queues[msgqid].in_use) {
+        return NULL;
+    }
+    return &message_queues[msgqid];
+}
+
+static inline u32 msg_type_hash(u32 type) {
+    return (type * 2654435761U) >> (32 - MSG_TYPE_HASH_BITS);
+}
+
+static struct msg_type_list* msg_type_find(struct message_queue* mq, u32 type) {
+    struct msg_type_list* list = mq->types[msg_type_hash(type)];
+    while (list && list->type != type) {
+        list = list->next;
+    }
+    return list;
+}
+
+/* Append to the queue and to its type's FIFO */
+static bool msg_enqueue(struct message_queue* mq, struct msg_node* node) {
+    struct msg_type_list* list = msg_type_find(mq, node->type);
+    if (!list) {
+        list = (struct msg_type_list*)kmalloc(sizeof(struct msg_type_list));
+        if (!list) {
+            return false;
+        }
+        
+        u32 bucket = msg_type_hash(node->type);
+        list->type = node->type;
+        list->head = NULL;
+        list->tail = NULL;
+        list->next = mq->types[bucket];
+        mq->types[bucket] = list;
+    }
+    
+    node->type_list = list;
+    node->type_next = NULL;
+    if (list->tail) {
+        list->tail->type_next = node;
+    } else {
+        list->head = node;
+    }
+    list->tail = node;
+    
+    node->next = NULL;
+    node->prev = mq->tail;
+    if (mq->tail) {
+        mq->tail->next = node;
+    } else {
+        mq->head = node;
+    }
+    mq->tail = node;
+    
+    mq->count++;
+    mq->bytes += node->size;
+    return true;
+}
+
+/* Unlink the head of a type FIFO, which is always the oldest message of that type */
+static void msg_dequeue(struct message_queue* mq, struct msg_node* node) {
+    struct msg_type_list* list = node->type_list;
+    list->head = node->type_next;
+    
+    if (!list->head) {
+        struct msg_type_list** link = &mq->types[msg_type_hash(list->type)];
+        while (*link != list) {
+            link = &(*link)->next;
+        }
+        *link = list->next;
+        kfree(list);
+    }
+    
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        mq->head = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        mq->tail = node->prev;
+    }
+    
+    mq->count--;
+    mq->bytes -= node->size;
+}
+
+/* Select per msgtyp: 0 = oldest, > 0 = oldest of that type,
+ * < 0 = oldest of the lowest type not above -msgtyp */
+static struct msg_node* msg_select(struct message_queue* mq, i32 msgtyp) {
+    if (msgtyp == 0) {
+        return mq->head;
+    }
+    
+    if (msgtyp > 0) {
+        struct msg_type_list* list = msg_type_find(mq, (u32)msgtyp);
+        return list ? list->head : NULL;
+    }
+    
+    struct msg_type_list* best = NULL;
+    for (u32 i = 0; i < MSG_TYPE_BUCKETS; i++) {
+        for (struct msg_type_list* list = mq->types[i]; list; list = list->next) {
+            if (list->type <= (u32)-msgtyp && (!best || list->type < best->type)) {
+                best = list;
+            }
+        }
+    }
+    return best ? best->head : NULL;
+}
+
+/* Receivers only take a wakeup for a message type they accept (key = type) */
+static bool msgq_receiver_wake(struct wait_queue_entry* entry, void* key) {
+    i32 msgtyp = (i32)(i64)entry->private;
+    u32 type = *(u32*)key;
+    
+    if ((msgtyp > 0 && type != (u32)msgtyp) || (msgtyp < 0 && type > (u32)-msgtyp)) {
+        return false;
+    }
+    return default_wake_function(entry, key);
+}
+
+/* Room freed by a receive, handed out to senders in queue order */
+struct msgq_space {
+    u32 slots;
+    u32 bytes;
+};
+
+/* Senders only take a wakeup if their message fits in what is left */
+static bool msgq_sender_wake(struct wait_queue_entry* entry, void* key) {
+    struct msgq_space* space = (struct msgq_space*)key;
+    u32 size = (u32)(u64)entry->private;
+    
+    if (space->slots == 0 || size > space->bytes) {
+        return false;
+    }
+    space->slots--;
+    space->bytes -= size;
+    return default_wake_function(entry, key);
+}
+
+/* Create message queue */
+i32 msgget(u32 key, i32 flags) {
+    /* Find existing queue with key */
+    for (u32 i = 0; i < MAX_MESSAGE_QUEUES; i++) {
+        if (message_queues[i].in_use && message_queues[i].key == key) {
+            return message_queues[i].id;
+        }
+    }
+    
+    /* Create new queue if IPC_CREAT flag set */
+    if (!(flags & IPC_CREAT)) {
+        return -1;
+    }
+    
+    /* Find free slot */
+    struct message_queue* mq = NULL;
+    for (u32 i = 0; i < MAX_MESSAGE_QUEUES; i++) {
+        if (!message_queues[i].in_use) {
+            mq = &message_queues[i];
+            break;
+        }
+    }
+    
+    if (!mq) {
+        return -1;
+    }
+    
+    /* Initialize message queue - storage comes from the slab as messages arrive */
+    mq->id = ipc_system.next_msgq_id++;
+    mq->key = key;
+    mq->head = NULL;
+    mq->tail = NULL;
+    for (u32 i = 0; i < MSG_TYPE_BUCKETS; i++) {
+        mq->types[i] = NULL;
+    }
+    mq->count = 0;
+    mq->bytes = 0;
+    mq->max_messages = MSG_QUEUE_SIZE;
+    mq->max_bytes = MSG_QUEUE_BYTES;
+    mq->max_message_size = MAX_MSG_SIZE;
+    wait_queue_init(&mq->send_wait);
+    wait_queue_init(&mq->recv_wait);
+    mq->in_use = true;
+    
+    return mq->id;
+}
+
+/* Send message */
+i32 msgsnd(i32 msgqid, const void* msgp, u32 msgsz, i32 msgflg) {
+    struct message_queue* mq = msgq_get(msgqid);
+    if (!mq) {
+        return -1;
+    }
+    
+    if (msgsz > mq->max_message_size) {
+        return -1;
+    }
+    
+    /* Fill the message in before taking the queue, so the user copy can fault */
+    disable_interrupts();
+    struct msg_node* msg = msg_alloc(msgsz);
+    enable_interrupts();
+    if (!msg) {
+        return -1;
+    }
     
+    const struct message* input_msg = (const struct message*)msgp;
     msg->type = input_msg->type;
     msg->size = msgsz;
     memcpy(msg->data, input_msg->data, msgsz);
     
-    mq->tail = (mq->tail + 1) % mq->max_messages;
-    mq->count++;
+    /* Block if queue full. The capacity check and the enqueue happen with
+     * interrupts off, so a preempting sender cannot take the same room. */
+    struct wait_queue_entry wait;
+    wait_entry_init(&wait, WQ_FLAG_EXCLUSIVE, msgq_sender_wake, (void*)(u64)msgsz);
+    
+    disable_interrupts();
+    while (mq->count >= mq->max_messages || mq->bytes + msgsz > mq->max_bytes) {
+        if (msgflg & IPC_NOWAIT) {
+            msg_free(msg);
+            enable_interrupts();
+            return -1;
+        }
+        if (signal_pending(get_current_process())) {
+            msg_free(msg);
+            enable_interrupts();
+            return -EINTR;
+        }
+        
+        wait_queue_sleep(&mq->send_wait, &wait);
+    }
     
-    /* Wake up waiting receivers */
-    for (u32 i = 0; i < mq->receiver_count; i++) {
-        mq->waiting_receivers[i]->state = PROCESS_READY;
-        cfs_enqueue_task(mq->waiting_receivers[i]);
+    if (!msg_enqueue(mq, msg)) {
+        msg_free(msg);
+        enable_interrupts();
+        return -1;
     }
-    mq->receiver_count = 0;
+    
+    /* Wake one receiver that wants this type */
+    wake_up_key(&mq->recv_wait, 1, &msg->type);
+    enable_interrupts();
     
     return 0;
 }
 
 /* Receive message */
 i32 msgrcv(i32 msgqid, void* msgp, u32 msgsz, i32 msgtyp, i32 msgflg) {
-    struct message_queue* mq = &message_queues[msgqid];
-    if (!mq->in_use) {
+    struct message_queue* mq = msgq_get(msgqid);
+    if (!mq) {
         return -1;
     }
     
-    /* Block if no messages */
-    while (mq->count == 0) {
+    /* Block until a message of the requested type is queued */
+    struct wait_queue_entry wait;
+    wait_entry_init(&wait, WQ_FLAG_EXCLUSIVE, msgq_receiver_wake, (void*)(i64)msgtyp);
+    
+    struct msg_node* msg;
+    disable_interrupts();
+    while (!(msg = msg_select(mq, msgtyp))) {
         if (msgflg & IPC_NOWAIT) {
+            enable_interrupts();
             return -1;
         }
+        if (signal_pending(get_current_process())) {
+            enable_interrupts();
+            return -EINTR;
+        }
         
-        struct process* current = get_current_process();
-        mq->waiting_receivers[mq->receiver_count++] = current;
-        current->state = PROCESS_BLOCKED;
-        schedule();
+        wait_queue_sleep(&mq->recv_wait, &wait);
     }
     
-    /* Find message of requested type */
-    u32 msg_index = mq->head;
-    struct message* msg = &mq->messages[msg_index];
+    /* Take the message off the queue before anyone else can select it */
+    msg_dequeue(mq, msg);
     
-    if (msgtyp > 0) {
-        /* Look for specific type */
-        bool found = false;
-        for (u32 i = 0; i < mq->count; i++) {
-            u32 index = (mq->head + i) % mq->max_messages;
-            if (mq->messages[index].type == msgtyp) {
-                msg_index = index;
-                msg = &mq->messages[index];
-                found = true;
-                break;
-            }
-        }
-        
-        if (!found) {
-            return -1;
-        }
-    }
+    /* Wake as many senders as now fit */
+    struct msgq_space space = { mq->max_messages - mq->count, mq->max_bytes - mq->bytes };
+    wake_up_key(&mq->send_wait, 0, &space);
+    enable_interrupts();
     
-    /* Copy message to user buffer */
+    /* Copy message to user buffer; the node is ours alone now */
     struct message* output_msg = (struct message*)msgp;
     output_msg->type = msg->type;
     
     u32 copy_size = (msg->size < msgsz) ? msg->size : msgsz;
     memcpy(output_msg->data, msg->data, copy_size);
     
-    /* Remove message from queue */
-    if (msg_index == mq->head) {
-        mq->head = (mq->head + 1) % mq->max_messages;
-    } else {
-        /* Shift messages if not head */
-        for (u32 i = msg_index; i != mq->tail; i = (i + 1) % mq->max_messages) {
-            u32 next = (i + 1) % mq->max_messages;
-            mq->messages[i] = mq->messages[next];
-        }
-        mq->tail = (mq->tail - 1 + mq->max_messages) % mq->max_messages;
-    }
-    
-    mq->count--;
-    
-    /* Wake up waiting senders */
-    for (u32 i = 0; i < mq->sender_count; i++) {
-        mq->waiting_senders[i]->state = PROCESS_READY;
-        cfs_enqueue_task(mq->waiting_senders[i]);
-    }
-    mq->sender_count = 0;
+    disable_interrupts();
+    msg_free(msg);
+    enable_interrupts();
     
     return copy_size;
 }
@@ -569,13 +1479,13 @@ i32 semget(u32 key, i32 nsems, i32 flags) {
     sem->key = key;
     sem->value = 1;  /* Binary semaphore by default */
     sem->max_value = 1;
-    sem->waiting_count = 0;
+    wait_queue_init(&sem->wait);
     sem->in_use = true;
     
     return sem->id;
 }
 
-/* RTOS-enhanced semaphore wait with timeout and priority inheritance */
+/* RTOS-enhanced semaphore wait with timeout, served in priority order */
 i32 sem_wait_timeout(i32 semid, u32 timeout_ms) {
     struct semaphore* sem = &semaphores[semid];
     if (!sem->in_use) {
@@ -587,75 +1497,42 @@ i32 sem_wait_timeout(i32 semid, u32 timeout_ms) {
     u64 deadline = start_ticks + rtos_ms_to_ticks(timeout_ms);
 
     /* Try to acquire semaphore */
+    disable_interrupts();
     if (sem->value > 0) {
         sem->value--;
+        enable_interrupts();
         return 0;  /* Success */
     }
 
-    /* Need to wait - implement priority inheritance */
-    if (sem->waiting_count > 0) {
-        /* Find highest priority waiting process */
-        u32 highest_priority = current->priority;
-        for (u32 i = 0; i < sem->waiting_count; i++) {
-            if (sem->waiting_processes[i]->priority < highest_priority) {
-                highest_priority = sem->waiting_processes[i]->priority;
-            }
-        }
-
-        /* Boost current holder's priority if needed */
-        if (current->priority > highest_priority) {
-            current->original_priority = current->priority;
-            current->priority = highest_priority;
-            current->priority_inherited = true;
-        }
-    }
-
-    /* Add to waiting queue in priority order */
-    u32 insert_pos = sem->waiting_count;
-    for (u32 i = 0; i < sem->waiting_count; i++) {
-        if (current->priority < sem->waiting_processes[i]->priority) {
-            insert_pos = i;
-            break;
-        }
-    }
-
-    /* Shift processes to make room */
-    for (u32 i = sem->waiting_count; i > insert_pos; i--) {
-        sem->waiting_processes[i] = sem->waiting_processes[i-1];
-    }
-    sem->waiting_processes[insert_pos] = current;
-    sem->waiting_count++;
+    /* Queue behind higher-priority waiters; sem_signal wakes only the first */
+    struct wait_queue_entry wait;
+    wait_entry_init(&wait, WQ_FLAG_EXCLUSIVE | WQ_FLAG_PRIORITY, NULL, NULL);
 
     /* Set up timeout if specified */
+    struct rtos_timeout* timer = NULL;
     if (timeout_ms > 0) {
-        rtos_add_timeout(current, timeout_ms);
+        timer = rtos_add_timeout(current, timeout_ms);
     }
 
-    /* Block and wait */
-    current->state = PROCESS_BLOCKED;
-
     /* Wait loop with timeout checking */
     while (sem->value <= 0) {
         if (timeout_ms > 0 && rtos_get_ticks() >= deadline) {
-            /* Timeout - remove from waiting queue */
-            for (u32 i = 0; i < sem->waiting_count; i++) {
-                if (sem->waiting_processes[i] == current) {
-                    for (u32 j = i; j < sem->waiting_count - 1; j++) {
-                        sem->waiting_processes[j] = sem->waiting_processes[j + 1];
-                    }
-                    sem->waiting_count--;
-                    break;
-                }
-            }
-            current->state = PROCESS_READY;
+            rtos_cancel_timeout(timer, current);
+            enable_interrupts();
             return -2;  /* Timeout error */
         }
+        if (signal_pending(current)) {
+            rtos_cancel_timeout(timer, current);
+            enable_interrupts();
+            return RTOS_INTERRUPTED;
+        }
 
-        schedule();
-        rtos_check_timeouts();
+        wait_queue_sleep(&sem->wait, &wait);
     }
 
+    rtos_cancel_timeout(timer, current);
     sem->value--;
+    enable_interrupts();
     return 0;
 }
 
@@ -673,218 +1550,2168 @@ i32 sem_signal(i32 semid) {
     
     sem->value++;
     
-    /* Wake up one waiting process */
-    if (sem->waiting_count > 0) {
-        struct process* proc = sem->waiting_processes[0];
-        proc->state = PROCESS_READY;
-        cfs_enqueue_task(proc);
-        
-        /* Shift waiting queue */
-        for (u32 i = 0; i < sem->waiting_count - 1; i++) {
-            sem->waiting_processes[i] = sem->waiting_processes[i + 1];
-        }
-        sem->waiting_count--;
-    }
+    /* Wake up the highest-priority waiter */
+    wake_up(&sem->wait);
     
     return 0;
 }
 
-/* SIGNALS */
+/* FUTEXES */
 
-/* Send signal to process */
-i32 signal_send(u32 pid, i32 signal) {
-    struct process* target = get_process_by_pid(pid);
-    if (!target) {
-        return -1;
+#define FUTEX_HASH_BITS 8
+#define FUTEX_HASH_SIZE (1 << FUTEX_HASH_BITS)
+
+/* A sleeping futex waiter; lives on the waiter's stack for the duration of the wait */
+struct futex_waiter {
+    u64 key;                            /* Physical address of the futex word */
+    struct process* proc;
+    bool woken;
+    struct futex_waiter* next;
+    struct futex_waiter** pprev;
+};
+
+static struct futex_waiter* futex_queues[FUTEX_HASH_SIZE];
+
+static inline struct futex_waiter** futex_bucket(u64 key) {
+    return &futex_queues[((key >> 2) * 0x9E3779B97F4A7C15ULL) >> (64 - FUTEX_HASH_BITS)];
+}
+
+/* Append, so waiters on one word are woken in arrival order */
+static void futex_enqueue(struct futex_waiter* waiter) {
+    struct futex_waiter** link = futex_bucket(waiter->key);
+    while (*link) {
+        link = &(*link)->next;
     }
     
-    /* Add signal to pending signals */
-    target->signal_state.pending_signals |= (1 << signal);
-    
-    /* If process is blocked, wake it up for signal handling */
-    if (target->state == PROCESS_BLOCKED) {
-        target->state = PROCESS_READY;
-        cfs_enqueue_task(target);
+    waiter->next = NULL;
+    waiter->pprev = link;
+    *link = waiter;
+}
+
+static void futex_unqueue(struct futex_waiter* waiter) {
+    *waiter->pprev = waiter->next;
+    if (waiter->next) {
+        waiter->next->pprev = waiter->pprev;
     }
-    
-    return 0;
+    waiter->next = NULL;
+    waiter->pprev = NULL;
 }
 
-/* Handle pending signals */
-void signal_handle_pending(struct process* proc) {
-    u32 pending = proc->signal_state.pending_signals & ~proc->signal_state.blocked_signals;
+/* Futex words must be aligned and mapped. Callers pass kernel or already
+ * checked user addresses: anything outside a VMA is taken as kernel memory. */
+static u64 futex_key(u32* uaddr) {
+    if ((u64)uaddr & (sizeof(u32) - 1)) {
+        return 0;
+    }
+    return vmm_virt_to_phys((u64)uaddr);
+}
+
+/* Sleep while *uaddr == val, at most timeout_ms (0 = forever).
+ * Returns 0 when woken, -EAGAIN if the value already changed, -ETIMEDOUT. */
+i32 futex_wait(u32* uaddr, u32 val, u32 timeout_ms) {
+    u64 key = futex_key(uaddr);
+    if (!key) {
+        return -EFAULT;
+    }
     
-    for (i32 sig = 1; sig < 32; sig++) {
-        if (pending & (1 << sig)) {
-            /* Clear pending signal */
-            proc->signal_state.pending_signals &= ~(1 << sig);
-            
-            /* Call signal handler */
-            struct signal_handler* handler = &proc->signal_state.handlers[sig];
-            if (handler->handler) {
-                handler->handler(sig);
+    struct process* current = get_current_process();
+    struct futex_waiter waiter;
+    waiter.key = key;
+    waiter.proc = current;
+    waiter.woken = false;
+    
+    /* Compare and queue with interrupts off, so a waker that changed the
+     * word after our caller looked either sees us queued or we see its value */
+    disable_interrupts();
+    if (*(volatile u32*)uaddr != val) {
+        enable_interrupts();
+        return -EAGAIN;
+    }
+    futex_enqueue(&waiter);
+    
+    u64 deadline = rtos_get_ticks() + rtos_ms_to_ticks(timeout_ms);
+    struct rtos_timeout* timer = NULL;
+    if (timeout_ms > 0) {
+        timer = rtos_add_timeout(current, timeout_ms);
+    }
+    
+    while (!waiter.woken) {
+        if (timeout_ms > 0 && rtos_get_ticks() >= deadline) {
+            futex_unqueue(&waiter);
+            rtos_cancel_timeout(timer, current);
+            enable_interrupts();
+            return -ETIMEDOUT;
+        }
+        if (signal_pending(current)) {
+            futex_unqueue(&waiter);
+            rtos_cancel_timeout(timer, current);
+            enable_interrupts();
+            return -EINTR;
+        }
+        
+        current->state = PROCESS_BLOCKED;
+        schedule();
+    }
+    
+    rtos_cancel_timeout(timer, current);
+    enable_interrupts();
+    return 0;
+}
+
+/* Wake up to nr_wake waiters on key; returns how many were woken */
+static u32 futex_wake_key(u64 key, u32 nr_wake) {
+    struct futex_waiter* waiter = *futex_bucket(key);
+    u32 woken = 0;
+    
+    while (waiter && woken < nr_wake) {
+        struct futex_waiter* next = waiter->next;
+        if (waiter->key == key) {
+            futex_unqueue(waiter);
+            waiter->woken = true;
+            cfs_wake_up_process(waiter->proc);
+            woken++;
+        }
+        waiter = next;
+    }
+    
+    return woken;
+}
+
+i32 futex_wake(u32* uaddr, u32 nr_wake) {
+    u64 key = futex_key(uaddr);
+    if (!key) {
+        return -EFAULT;
+    }
+    
+    u64 irq_flags = irq_save();
+    u32 woken = futex_wake_key(key, nr_wake);
+    irq_restore(irq_flags);
+    
+    return woken;
+}
+
+/* Wake nr_wake waiters on uaddr and move up to nr_requeue of the rest to
+ * uaddr2 without waking them (e.g. condvar broadcast onto the mutex word).
+ * With compare set, fail with -EAGAIN unless *uaddr == cmpval. */
+i32 futex_requeue(u32* uaddr, u32 nr_wake, u32* uaddr2, u32 nr_requeue, bool compare, u32 cmpval) {
+    u64 key = futex_key(uaddr);
+    u64 key2 = futex_key(uaddr2);
+    if (!key || !key2) {
+        return -EFAULT;
+    }
+    
+    u64 irq_flags = irq_save();
+    if (compare && *(volatile u32*)uaddr != cmpval) {
+        irq_restore(irq_flags);
+        return -EAGAIN;
+    }
+    
+    u32 woken = futex_wake_key(key, nr_wake);
+    u32 requeued = 0;
+    
+    if (key2 != key) {
+        struct futex_waiter* waiter = *futex_bucket(key);
+        while (waiter && requeued < nr_requeue) {
+            struct futex_waiter* next = waiter->next;
+            if (waiter->key == key) {
+                futex_unqueue(waiter);
+                waiter->key = key2;
+                futex_enqueue(waiter);
+                requeued++;
+            }
+            waiter = next;
+        }
+    }
+    
+    irq_restore(irq_flags);
+    return woken + requeued;
+}
+
+/* SHARED MEMORY */
+
+/* Segments of at least this size get 2 MB pages without SHM_HUGETLB;
+ * rounding up then wastes under 1/8 of the segment */
+#define SHM_HUGE_THRESHOLD (8 * HUGE_PAGE_SIZE)
+
+static struct shared_memory* shm_segment(i32 shmid) {
+    if (shmid < 0 || shmid >= MAX_SHARED_MEMORY || !shared_memory_segments[shmid].in_use) {
+        return NULL;
+    }
+    return &shared_memory_segments[shmid];
+}
+
+/* Kernel-resident segments are used in place, at the first cache line of the block */
+static inline struct spsc_ring* spsc_ring_of(struct shared_memory* seg) {
+    return (struct spsc_ring*)(((u64)seg->address + CACHE_LINE_SIZE - 1) & ~(u64)(CACHE_LINE_SIZE - 1));
+}
+
+/* Drop the segment's own references; pages still mapped stay alive until unmapped */
+static void shm_destroy(struct shared_memory* seg) {
+    for (u32 i = 0; i < seg->nr_frames; i++) {
+        if (seg->frames[i]) {
+            if (seg->huge) {
+                pmm_free_huge_page(seg->frames[i]);
             } else {
-                /* Default signal handling */
-                switch (sig) {
-                    case SIGKILL:
-                    case SIGTERM:
-                        process_exit(128 + sig);
-                        break;
-                    case SIGSTOP:
-                        proc->state = PROCESS_BLOCKED;
-                        break;
-                    default:
-                        /* Ignore signal */
-                        break;
-                }
+                pmm_free_page(seg->frames[i]);
+            }
+        }
+    }
+    kfree(seg->frames);
+    kfree(seg->address);
+    seg->frames = NULL;
+    seg->address = NULL;
+    seg->in_use = false;
+}
+
+static void shm_detach(struct shared_memory* seg) {
+    if (seg->nattch > 0 && --seg->nattch == 0 && seg->removed) {
+        shm_destroy(seg);
+    }
+}
+
+/* Attachments of kernel-resident segments, which no VMA records, so that
+ * exit can drop the ones a thread group still holds */
+#define SHM_MAX_RING_ATTACHES 128
+
+static struct {
+    u32 tgid;
+    struct shared_memory* seg;
+} shm_ring_attaches[SHM_MAX_RING_ATTACHES];
+
+static bool shm_ring_attach(struct shared_memory* seg) {
+    for (u32 i = 0; i < SHM_MAX_RING_ATTACHES; i++) {
+        if (!shm_ring_attaches[i].seg) {
+            shm_ring_attaches[i].tgid = get_current_process()->tgid;
+            shm_ring_attaches[i].seg = seg;
+            seg->nattch++;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Forget one attachment by the calling thread group; false if it held none */
+static bool shm_ring_unrecord(struct shared_memory* seg) {
+    u32 tgid = get_current_process()->tgid;
+    for (u32 i = 0; i < SHM_MAX_RING_ATTACHES; i++) {
+        if (shm_ring_attaches[i].seg == seg && shm_ring_attaches[i].tgid == tgid) {
+            shm_ring_attaches[i].seg = NULL;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Close hook for mapped segments: the VMA went away */
+static void shm_close(void* private) {
+    shm_detach((struct shared_memory*)private);
+}
+
+/* Fault hook for attached segments: populate the frame on first touch and
+ * hand the page tables their own reference */
+static u64 shm_fault(void* private, u64 offset, u64* page_size) {
+    struct shared_memory* seg = private;
+    u64 unit = seg->huge ? HUGE_PAGE_SIZE : PAGE_SIZE;
+    u32 index = offset / unit;
+    
+    if (index >= seg->nr_frames) {
+        return 0;
+    }
+    
+    if (!seg->frames[index]) {
+        seg->frames[index] = seg->huge ? pmm_alloc_huge_page() : pmm_alloc_page();
+        if (!seg->frames[index]) {
+            return 0;
+        }
+    }
+    
+    pmm_page_get(seg->frames[index]);
+    *page_size = unit;
+    return seg->frames[index];
+}
+
+/* Create (or look up by key) a segment of size bytes. Nothing is allocated
+ * until an attached process touches a page. Returns the segment id. */
+i32 shmget(u32 key, u64 size, i32 flags) {
+    if (key != IPC_PRIVATE) {
+        for (u32 i = 0; i < MAX_SHARED_MEMORY; i++) {
+            struct shared_memory* seg = &shared_memory_segments[i];
+            if (seg->in_use && !seg->removed && seg->key == key) {
+                return size <= seg->size ? (i32)i : -EINVAL;
+            }
+        }
+        if (!(flags & IPC_CREAT)) {
+            return -ENOENT;
+        }
+    }
+    
+    if (size == 0) {
+        return -EINVAL;
+    }
+    
+    i32 shmid = -1;
+    for (u32 i = 0; i < MAX_SHARED_MEMORY; i++) {
+        if (!shared_memory_segments[i].in_use) {
+            shmid = i;
+            break;
+        }
+    }
+    if (shmid < 0) {
+        return -ENOSPC;
+    }
+    
+    bool huge = (flags & SHM_HUGETLB) || size >= SHM_HUGE_THRESHOLD;
+    u64 unit = huge ? HUGE_PAGE_SIZE : PAGE_SIZE;
+    u32 nr_frames = (size + unit - 1) / unit;
+    
+    struct shared_memory* seg = &shared_memory_segments[shmid];
+    seg->frames = kmalloc(nr_frames * sizeof(u64));
+    if (!seg->frames) {
+        return -ENOMEM;
+    }
+    memset(seg->frames, 0, nr_frames * sizeof(u64));
+    
+    seg->id = ipc_system.next_shm_id++;
+    seg->key = key;
+    seg->address = NULL;
+    seg->nr_frames = nr_frames;
+    seg->huge = huge;
+    seg->size = (u64)nr_frames * unit;
+    seg->permissions = flags & 0777;
+    seg->removed = false;
+    seg->nattch = 0;
+    seg->creator_pid = get_current_process()->pid;
+    seg->in_use = true;
+    
+    return shmid;
+}
+
+/* Map a segment into the calling process. addr 0 lets the kernel choose. */
+void* shmat(i32 shmid, const void* addr, i32 flags) {
+    struct shared_memory* seg = shm_segment(shmid);
+    if (!seg || seg->removed) {
+        return (void*)-1;
+    }
+    
+    /* Channel rings live in kernel memory and are used in place */
+    if (seg->address) {
+        return shm_ring_attach(seg) ? (void*)spsc_ring_of(seg) : (void*)-1;
+    }
+    
+    u32 prot = (flags & SHM_RDONLY) ? PROT_READ : PROT_READ | PROT_WRITE;
+    void* mapped = vmm_map_shared((u64)addr, seg->size, prot, seg->huge, shm_fault, shm_close, seg);
+    if (!mapped) {
+        return (void*)-1;
+    }
+    
+    seg->nattch++;
+    return mapped;
+}
+
+/* Unmap the segment attached at addr */
+i32 shmdt(const void* addr) {
+    for (u32 i = 0; i < MAX_SHARED_MEMORY; i++) {
+        struct shared_memory* seg = &shared_memory_segments[i];
+        if (seg->in_use && seg->address && (const void*)spsc_ring_of(seg) == addr) {
+            if (!shm_ring_unrecord(seg)) {
+                return -EINVAL;
+            }
+            shm_detach(seg);
+            return 0;
+        }
+    }
+    
+    /* Mapped segments are detached by shm_close as the VMA goes */
+    return vmm_unmap_shared((u64)addr) ? 0 : -EINVAL;
+}
+
+/* Drop every kernel-resident segment a dying thread group still holds;
+ * mapped segments are dropped with its address space */
+void shm_exit(u32 tgid) {
+    for (u32 i = 0; i < SHM_MAX_RING_ATTACHES; i++) {
+        if (shm_ring_attaches[i].seg && shm_ring_attaches[i].tgid == tgid) {
+            struct shared_memory* seg = shm_ring_attaches[i].seg;
+            shm_ring_attaches[i].seg = NULL;
+            shm_detach(seg);
+        }
+    }
+}
+
+/* Control; only IPC_RMID is supported. Removal hides the key at once and
+ * frees the segment when its last user detaches. */
+i32 shmctl(i32 shmid, i32 cmd) {
+    struct shared_memory* seg = shm_segment(shmid);
+    if (!seg || cmd != IPC_RMID) {
+        return -EINVAL;
+    }
+    
+    seg->removed = true;
+    if (seg->nattch == 0) {
+        shm_destroy(seg);
+    }
+    return 0;
+}
+
+/* SHARED-MEMORY CHANNELS */
+
+/* The ring's shmid lives in shared memory, so check it names this ring */
+static struct shared_memory* spsc_segment(struct spsc_ring* ring) {
+    u32 shmid = ring->shmid;
+    if (shmid >= MAX_SHARED_MEMORY || !shared_memory_segments[shmid].in_use ||
+        spsc_ring_of(&shared_memory_segments[shmid]) != ring) {
+        return NULL;
+    }
+    return &shared_memory_segments[shmid];
+}
+
+/* Create (or look up by key) a channel of nr_slots messages of up to
+ * max_message bytes each. Returns the segment id. */
+i32 spsc_create(u32 key, u32 max_message, u32 nr_slots) {
+    for (u32 i = 0; i < MAX_SHARED_MEMORY; i++) {
+        if (shared_memory_segments[i].in_use && shared_memory_segments[i].key == key) {
+            return i;
+        }
+    }
+    
+    if (max_message == 0 || nr_slots == 0 || nr_slots > 65536) {
+        return -1;
+    }
+    
+    i32 shmid = -1;
+    for (u32 i = 0; i < MAX_SHARED_MEMORY; i++) {
+        if (!shared_memory_segments[i].in_use) {
+            shmid = i;
+            break;
+        }
+    }
+    if (shmid < 0) {
+        return -1;
+    }
+    
+    /* Power-of-two slot count; 8-byte aligned stride with a length word */
+    u32 slots = 1;
+    while (slots < nr_slots) {
+        slots <<= 1;
+    }
+    u32 stride = (sizeof(u32) + max_message + 7) & ~7U;
+    u32 size = sizeof(struct spsc_ring) + slots * stride + CACHE_LINE_SIZE;
+    
+    struct shared_memory* seg = &shared_memory_segments[shmid];
+    seg->address = kmalloc(size);
+    if (!seg->address) {
+        return -1;
+    }
+    
+    seg->id = ipc_system.next_shm_id++;
+    seg->key = key;
+    seg->frames = NULL;
+    seg->nr_frames = 0;
+    seg->huge = false;
+    seg->size = size;
+    seg->permissions = 0600;
+    seg->removed = false;
+    seg->nattch = 0;
+    seg->creator_pid = get_current_process()->pid;
+    seg->in_use = true;
+    
+    struct spsc_ring* ring = spsc_ring_of(seg);
+    memset(ring, 0, sizeof(struct spsc_ring));
+    ring->slot_size = stride;
+    ring->mask = slots - 1;
+    ring->shmid = shmid;
+    
+    return shmid;
+}
+
+/* Attach the calling process; it then sends and receives without entering the kernel */
+struct spsc_ring* spsc_attach(i32 shmid) {
+    if (shmid < 0 || shmid >= MAX_SHARED_MEMORY || !shared_memory_segments[shmid].in_use) {
+        return NULL;
+    }
+    
+    struct shared_memory* seg = &shared_memory_segments[shmid];
+    return shm_ring_attach(seg) ? spsc_ring_of(seg) : NULL;
+}
+
+/* Detach; the segment is freed when the last process detaches */
+void spsc_detach(struct spsc_ring* ring) {
+    struct shared_memory* seg = spsc_segment(ring);
+    if (!seg) {
+        return;
+    }
+    
+    if (!shm_ring_unrecord(seg)) {
+        return;
+    }
+    if (seg->nattch > 0 && --seg->nattch == 0) {
+        shm_destroy(seg);
+    }
+}
+
+/* EVENT POLLING */
+
+/* One watched source. Its wait entries sit on the source's own wait queues,
+ * so the source's normal wakeups put the item on the ready list. */
+struct epitem {
+    u32 target;                         /* EPOLL_TARGET(source, id); tree key */
+    u32 events;                         /* Requested events plus EPOLLET/EPOLLONESHOT */
+    u64 data;
+    void* object;                       /* Pipe, message queue or semaphore */
+    struct eventpoll* ep;
+    struct epitem* left;                /* Interest tree: a treap ordered by target */
+    struct epitem* right;
+    u32 heap_prio;
+    struct epitem* ready_next;
+    bool on_ready;
+    struct wait_queue_entry wait[2];    /* One per source queue (input, output) */
+};
+
+struct eventpoll {
+    bool in_use;
+    struct epitem* root;
+    struct epitem* ready_head;
+    struct epitem* ready_tail;
+    u32 count;
+    struct wait_queue_head wait;        /* Callers of epoll_wait */
+};
+
+static struct eventpoll event_polls[MAX_EVENT_POLLS];
+
+/* Treap priorities come from a multiplicative hash of the key, which keeps
+ * the tree shallow even when items are added in fd order */
+static inline u32 ep_heap_prio(u32 target) {
+    return target * 2654435761U;
+}
+
+static struct epitem* ep_find(struct eventpoll* ep, u32 target) {
+    struct epitem* epi = ep->root;
+    while (epi && epi->target != target) {
+        epi = target < epi->target ? epi->left : epi->right;
+    }
+    return epi;
+}
+
+static struct epitem* ep_rotate_right(struct epitem* node) {
+    struct epitem* left = node->left;
+    node->left = left->right;
+    left->right = node;
+    return left;
+}
+
+static struct epitem* ep_rotate_left(struct epitem* node) {
+    struct epitem* right = node->right;
+    node->right = right->left;
+    right->left = node;
+    return right;
+}
+
+static struct epitem* ep_tree_insert(struct epitem* node, struct epitem* epi) {
+    if (!node) {
+        return epi;
+    }
+    
+    if (epi->target < node->target) {
+        node->left = ep_tree_insert(node->left, epi);
+        if (node->left->heap_prio > node->heap_prio) {
+            node = ep_rotate_right(node);
+        }
+    } else {
+        node->right = ep_tree_insert(node->right, epi);
+        if (node->right->heap_prio > node->heap_prio) {
+            node = ep_rotate_left(node);
+        }
+    }
+    return node;
+}
+
+/* Rotate the item down until it is a leaf, then drop it */
+static struct epitem* ep_tree_remove(struct epitem* node, u32 target) {
+    if (!node) {
+        return NULL;
+    }
+    
+    if (target < node->target) {
+        node->left = ep_tree_remove(node->left, target);
+    } else if (target > node->target) {
+        node->right = ep_tree_remove(node->right, target);
+    } else if (!node->left) {
+        return node->right;
+    } else if (!node->right) {
+        return node->left;
+    } else if (node->left->heap_prio > node->right->heap_prio) {
+        node = ep_rotate_right(node);
+        node->right = ep_tree_remove(node->right, target);
+    } else {
+        node = ep_rotate_left(node);
+        node->left = ep_tree_remove(node->left, target);
+    }
+    return node;
+}
+
+static void ep_ready_append(struct eventpoll* ep, struct epitem* epi) {
+    epi->on_ready = true;
+    epi->ready_next = NULL;
+    if (ep->ready_tail) {
+        ep->ready_tail->ready_next = epi;
+    } else {
+        ep->ready_head = epi;
+    }
+    ep->ready_tail = epi;
+}
+
+static void ep_ready_unlink(struct eventpoll* ep, struct epitem* epi) {
+    struct epitem* prev = NULL;
+    for (struct epitem* cur = ep->ready_head; cur; prev = cur, cur = cur->ready_next) {
+        if (cur == epi) {
+            if (prev) {
+                prev->ready_next = epi->ready_next;
+            } else {
+                ep->ready_head = epi->ready_next;
+            }
+            if (ep->ready_tail == epi) {
+                ep->ready_tail = prev;
+            }
+            break;
+        }
+    }
+    epi->on_ready = false;
+}
+
+/* Current readiness of a source, as EPOLLIN/EPOLLOUT bits */
+static u32 ep_poll_source(struct epitem* epi) {
+    u32 revents = 0;
+    
+    switch (EPOLL_TARGET_SOURCE(epi->target)) {
+        case EPOLL_SRC_PIPE: {
+            struct pipe* p = epi->object;
+            /* EOF reads and EPIPE writes do not block either */
+            if (pipe_data(p) > 0 || p->writers == 0) revents |= EPOLLIN;
+            if (pipe_ring_used(p) < p->capacity || p->readers == 0) revents |= EPOLLOUT;
+            break;
+        }
+        case EPOLL_SRC_MSGQ: {
+            struct message_queue* mq = epi->object;
+            if (mq->count > 0) revents |= EPOLLIN;
+            if (mq->count < mq->max_messages && mq->bytes < mq->max_bytes) revents |= EPOLLOUT;
+            break;
+        }
+        case EPOLL_SRC_SEM: {
+            struct semaphore* sem = epi->object;
+            if (sem->value > 0) revents |= EPOLLIN;
+            break;
+        }
+        case EPOLL_SRC_KEYBOARD:
+            if (keyboard_has_input()) revents |= EPOLLIN;
+            break;
+    }
+    
+    return revents;
+}
+
+/* Wakeup callback hooked onto the source's queues: never takes the wakeup
+ * from a real sleeper, only marks the item ready and wakes the poller */
+static bool ep_wake(struct wait_queue_entry* entry, void* key) {
+    (void)key;
+    struct epitem* epi = (struct epitem*)entry->private;
+    struct eventpoll* ep = epi->ep;
+    
+    if (!epi->on_ready) {
+        ep_ready_append(ep, epi);
+    }
+    wake_up(&ep->wait);
+    return false;
+}
+
+/* Resolve a target to its object and the queues that signal input and output */
+static void* ep_resolve(u32 target, struct wait_queue_head** in_wq, struct wait_queue_head** out_wq) {
+    i32 id = EPOLL_TARGET_ID(target);
+    *in_wq = NULL;
+    *out_wq = NULL;
+    
+    switch (EPOLL_TARGET_SOURCE(target)) {
+        case EPOLL_SRC_PIPE: {
+            struct pipe* p = pipe_from_fd(id);
+            if (p) {
+                *in_wq = &p->read_wait;
+                *out_wq = &p->write_wait;
+            }
+            return p;
+        }
+        case EPOLL_SRC_MSGQ: {
+            struct message_queue* mq = msgq_get(id);
+            if (mq) {
+                *in_wq = &mq->recv_wait;
+                *out_wq = &mq->send_wait;
+            }
+            return mq;
+        }
+        case EPOLL_SRC_SEM:
+            if (id < 0 || id >= MAX_SEMAPHORES || !semaphores[id].in_use) {
+                return NULL;
+            }
+            *in_wq = &semaphores[id].wait;
+            return &semaphores[id];
+        case EPOLL_SRC_KEYBOARD:
+            *in_wq = keyboard_wait_queue();
+            return *in_wq;
+        default:
+            return NULL;
+    }
+}
+
+/* Hook the item onto the queues for the events it asks for. Called with
+ * interrupts disabled. */
+static void ep_arm(struct epitem* epi) {
+    struct wait_queue_head* in_wq;
+    struct wait_queue_head* out_wq;
+    ep_resolve(epi->target, &in_wq, &out_wq);
+    
+    remove_wait_queue(&epi->wait[0]);
+    remove_wait_queue(&epi->wait[1]);
+    if ((epi->events & EPOLLIN) && in_wq) {
+        add_wait_queue(in_wq, &epi->wait[0]);
+    }
+    if ((epi->events & EPOLLOUT) && out_wq) {
+        add_wait_queue(out_wq, &epi->wait[1]);
+    }
+    
+    /* Already ready: report it without waiting for the next transition */
+    if (!epi->on_ready && (ep_poll_source(epi) & epi->events)) {
+        ep_ready_append(epi->ep, epi);
+        wake_up(&epi->ep->wait);
+    }
+}
+
+static void ep_release(struct eventpoll* ep, struct epitem* epi) {
+    remove_wait_queue(&epi->wait[0]);
+    remove_wait_queue(&epi->wait[1]);
+    if (EPOLL_TARGET_SOURCE(epi->target) == EPOLL_SRC_PIPE) {
+        pipe_release(epi->object);  /* May have been the last thing holding it */
+    }
+    if (epi->on_ready) {
+        ep_ready_unlink(ep, epi);
+    }
+    ep->root = ep_tree_remove(ep->root, epi->target);
+    ep->count--;
+    kfree(epi);
+}
+
+static struct eventpoll* ep_get(i32 epid) {
+    if (epid < 0 || epid >= MAX_EVENT_POLLS || !event_polls[epid].in_use) {
+        return NULL;
+    }
+    return &event_polls[epid];
+}
+
+/* Create an empty interest set; returns its id */
+i32 epoll_create(void) {
+    for (u32 i = 0; i < MAX_EVENT_POLLS; i++) {
+        struct eventpoll* ep = &event_polls[i];
+        if (!ep->in_use) {
+            ep->root = NULL;
+            ep->ready_head = NULL;
+            ep->ready_tail = NULL;
+            ep->count = 0;
+            wait_queue_init(&ep->wait);
+            ep->in_use = true;
+            return i;
+        }
+    }
+    return -ENOSPC;
+}
+
+/* Add, modify or remove interest in a target (see EPOLL_TARGET) */
+i32 epoll_ctl(i32 epid, i32 op, u32 target, const struct epoll_event* event) {
+    struct eventpoll* ep = ep_get(epid);
+    if (!ep || (op != EPOLL_CTL_DEL && !event)) {
+        return -EINVAL;
+    }
+    
+    struct wait_queue_head* in_wq;
+    struct wait_queue_head* out_wq;
+    void* object = ep_resolve(target, &in_wq, &out_wq);
+    if (!object) {
+        return -EBADF;
+    }
+    
+    u64 irq_flags = irq_save();
+    struct epitem* epi = ep_find(ep, target);
+    
+    switch (op) {
+        case EPOLL_CTL_ADD:
+            if (epi) {
+                irq_restore(irq_flags);
+                return -EEXIST;
+            }
+            epi = kmalloc(sizeof(struct epitem));
+            if (!epi) {
+                irq_restore(irq_flags);
+                return -ENOMEM;
+            }
+            epi->target = target;
+            epi->events = event->events;
+            epi->data = event->data;
+            epi->object = object;
+            epi->ep = ep;
+            epi->left = NULL;
+            epi->right = NULL;
+            epi->heap_prio = ep_heap_prio(target);
+            epi->ready_next = NULL;
+            epi->on_ready = false;
+            wait_entry_init(&epi->wait[0], 0, ep_wake, epi);
+            wait_entry_init(&epi->wait[1], 0, ep_wake, epi);
+            ep->root = ep_tree_insert(ep->root, epi);
+            ep->count++;
+            ep_arm(epi);
+            break;
+    
+        case EPOLL_CTL_MOD:
+            if (!epi) {
+                irq_restore(irq_flags);
+                return -ENOENT;
+            }
+            epi->events = event->events;
+            epi->data = event->data;
+            ep_arm(epi);
+            break;
+    
+        case EPOLL_CTL_DEL:
+            if (!epi) {
+                irq_restore(irq_flags);
+                return -ENOENT;
+            }
+            ep_release(ep, epi);
+            break;
+    
+        default:
+            irq_restore(irq_flags);
+            return -EINVAL;
+    }
+    
+    irq_restore(irq_flags);
+    return 0;
+}
+
+/* Move ready items out to events. Level-triggered items that are still
+ * ready go back on the list, so the next call checks them again;
+ * edge-triggered ones wait for the source's next wakeup. */
+static i32 ep_collect(struct eventpoll* ep, struct epoll_event* events, i32 maxevents) {
+    struct epitem* list = ep->ready_head;
+    ep->ready_head = NULL;
+    ep->ready_tail = NULL;
+    i32 n = 0;
+    
+    while (list) {
+        struct epitem* epi = list;
+        list = epi->ready_next;
+        epi->on_ready = false;
+    
+        u32 revents = ep_poll_source(epi) & epi->events;
+        if (!revents) {
+            continue;  /* Woken, but the condition was consumed since */
+        }
+    
+        if (n == maxevents) {
+            ep_ready_append(ep, epi);
+            continue;
+        }
+    
+        events[n].events = revents;
+        events[n].data = epi->data;
+        n++;
+    
+        if (epi->events & EPOLLONESHOT) {
+            /* Disarmed until EPOLL_CTL_MOD */
+            epi->events &= EPOLLET | EPOLLONESHOT;
+            remove_wait_queue(&epi->wait[0]);
+            remove_wait_queue(&epi->wait[1]);
+        } else if (!(epi->events & EPOLLET)) {
+            ep_ready_append(ep, epi);
+        }
+    }
+    
+    return n;
+}
+
+/* Wait until at least one watched source is ready. timeout_ms < 0 waits
+ * forever, 0 only checks. Returns the number of events stored. */
+i32 epoll_wait(i32 epid, struct epoll_event* events, i32 maxevents, i32 timeout_ms) {
+    struct eventpoll* ep = ep_get(epid);
+    if (!ep || !events || maxevents <= 0) {
+        return -EINVAL;
+    }
+    
+    struct process* current = get_current_process();
+    struct wait_queue_entry wait;
+    wait_entry_init(&wait, WQ_FLAG_EXCLUSIVE, NULL, NULL);
+    
+    disable_interrupts();
+    u64 deadline = rtos_get_ticks() + rtos_ms_to_ticks(timeout_ms > 0 ? timeout_ms : 0);
+    struct rtos_timeout* timer = NULL;
+    if (timeout_ms > 0) {
+        timer = rtos_add_timeout(current, timeout_ms);
+    }
+    
+    i32 n;
+    while (!(n = ep_collect(ep, events, maxevents))) {
+        if (!ep->in_use || timeout_ms == 0 || (timeout_ms > 0 && rtos_get_ticks() >= deadline)) {
+            break;
+        }
+        if (signal_pending(current)) {
+            n = -EINTR;
+            break;
+        }
+    
+        wait_queue_sleep(&ep->wait, &wait);
+    }
+    
+    rtos_cancel_timeout(timer, current);
+    enable_interrupts();
+    return n;
+}
+
+/* Drop the interest set and unhook every item */
+i32 epoll_close(i32 epid) {
+    struct eventpoll* ep = ep_get(epid);
+    if (!ep) {
+        return -EINVAL;
+    }
+    
+    u64 irq_flags = irq_save();
+    while (ep->root) {
+        ep_release(ep, ep->root);
+    }
+    ep->in_use = false;
+    
+    /* Anyone still waiting sees the set gone and returns empty-handed */
+    wake_up_all(&ep->wait);
+    irq_restore(irq_flags);
+    return 0;
+}
+
+/* SIGNALS */
+
+#define SIG_UNBLOCKABLE (SIGMASK(SIGKILL) | SIGMASK(SIGSTOP))
+#define SIGNAL_RED_ZONE 128             /* Below the user rsp, owned by leaf functions */
+#define RFLAGS_USER_MASK 0xDD5          /* CF PF AF ZF SF TF DF OF */
+
+volatile u32 signal_work_pending = 0;
+
+/* Refresh the exit-path flag after proc's pending or blocked mask changed.
+ * Only the running thread's state is mirrored; schedule() reloads it. */
+static void signal_recalc(struct process* proc) {
+    if (proc == get_current_process()) {
+        signal_work_pending = signal_pending(proc);
+    }
+}
+
+/* Default action of signals without a handler: ignore, stop or terminate */
+static void signal_default(struct process* proc, i32 sig) {
+    switch (sig) {
+        case SIGCHLD:
+        case SIGCONT:
+            break;
+        case SIGSTOP:
+            proc->state = PROCESS_BLOCKED;
+            schedule();
+            break;
+        default:
+            process_exit(128 + sig);
+            break;
+    }
+}
+
+/* Send signal to a thread */
+i32 signal_send(u32 pid, i32 signal) {
+    if (signal <= 0 || signal >= NSIG) {
+        return -EINVAL;
+    }
+    
+    struct process* target = get_process_by_pid(pid);
+    if (!target) {
+        return -ESRCH;
+    }
+    
+    /* Kernel threads never reach delivery, so a queued signal would only
+     * keep signal_work_pending set on every interrupt return */
+    if (process_is_kernel_thread(target)) {
+        return 0;
+    }
+    
+    /* Ignored signals are discarded at once rather than left pending */
+    if (target->sighand->action[signal].sa_handler == SIG_IGN && !(SIGMASK(signal) & SIG_UNBLOCKABLE)) {
+        return 0;
+    }
+    
+    u64 irq_flags = irq_save();
+    target->sigpending |= SIGMASK(signal);
+    signal_recalc(target);
+    
+    /* Wake a sleeper so the signal is seen on its way back to user mode */
+    if (target->state == PROCESS_BLOCKED && (SIGMASK(signal) & ~target->sigblocked)) {
+        cfs_wake_up_process(target);
+    }
+    irq_restore(irq_flags);
+    
+    return 0;
+}
+
+/* Examine and change a disposition; shared by the whole thread group */
+i32 signal_action(i32 signum, const struct sigaction* act, struct sigaction* oldact) {
+    if (signum <= 0 || signum >= NSIG) {
+        return -EINVAL;
+    }
+    
+    struct process* current = get_current_process();
+    struct sigaction* action = &current->sighand->action[signum];
+    
+    if (oldact) {
+        *oldact = *action;
+    }
+    if (act) {
+        if (SIGMASK(signum) & SIG_UNBLOCKABLE) {
+            return -EINVAL;
+        }
+        *action = *act;
+        action->sa_mask &= ~SIG_UNBLOCKABLE;
+    }
+    return 0;
+}
+
+/* Examine and change the calling thread's blocked mask */
+i32 signal_procmask(i32 how, const u64* set, u64* oldset) {
+    struct process* current = get_current_process();
+    
+    if (oldset) {
+        *oldset = current->sigblocked;
+    }
+    if (!set) {
+        return 0;
+    }
+    
+    u64 mask = *set & ~SIG_UNBLOCKABLE;
+    switch (how) {
+        case SIG_BLOCK:
+            current->sigblocked |= mask;
+            break;
+        case SIG_UNBLOCK:
+            current->sigblocked &= ~mask;
+            break;
+        case SIG_SETMASK:
+            current->sigblocked = mask;
+            break;
+        default:
+            return -EINVAL;
+    }
+    
+    signal_recalc(current);
+    return 0;
+}
+
+/* Push a frame for the handler and redirect the return to user mode into it.
+ * The handler runs on the interrupted stack with sig in rdi; returning from
+ * it enters sa_restorer, which calls rt_sigreturn. */
+static void signal_setup_frame(struct process* proc, struct trap_frame* regs, i32 sig,
+                               struct sigaction* action) {
+    u64 sp = ((regs->rsp - SIGNAL_RED_ZONE - sizeof(struct sigframe)) & ~0xFULL) - 8;
+    
+    /* No restorer, or a stack the frame does not fit on: nothing to return to */
+    if (!(action->sa_flags & SA_RESTORER) || !vmm_access_ok(sp, sizeof(struct sigframe), true)) {
+        process_exit(128 + SIGSEGV);
+        return;
+    }
+    
+    struct sigframe* frame = (struct sigframe*)sp;
+    frame->restorer = (u64)action->sa_restorer;
+    frame->regs = *regs;
+    frame->blocked = proc->sigblocked;
+    
+    /* The ABI expects rsp + 8 to be 16-byte aligned at function entry */
+    regs->rsp = sp;
+    regs->rip = (u64)action->sa_handler;
+    regs->rdi = sig;
+    regs->rax = 0;
+    regs->rflags &= ~(u64)0x500;        /* Clear TF and DF for the handler */
+    
+    proc->sigblocked |= action->sa_mask;
+    if (!(action->sa_flags & SA_NODEFER)) {
+        proc->sigblocked |= SIGMASK(sig);
+    }
+    if (action->sa_flags & SA_RESETHAND) {
+        action->sa_handler = SIG_DFL;
+    }
+}
+
+/* Slow path of the exit stubs, taken only while signal_work_pending is set.
+ * Runs default actions and sets up at most one handler frame; anything left
+ * pending is delivered when the handler's rt_sigreturn exits. */
+void signal_deliver(struct trap_frame* regs) {
+    struct process* proc = get_current_process();
+    
+    /* Returning to kernel code: the flag stays set for the return to user mode */
+    if (!proc || (regs->cs & 3) != 3) {
+        return;
+    }
+    
+    u64 pending;
+    while ((pending = proc->sigpending & ~proc->sigblocked) != 0) {
+        i32 sig = __builtin_ctzll(pending);
+        proc->sigpending &= ~SIGMASK(sig);
+    
+        struct sigaction* action = &proc->sighand->action[sig];
+        if (action->sa_handler == SIG_IGN) {
+            continue;
+        }
+        if (action->sa_handler == SIG_DFL) {
+            signal_default(proc, sig);
+            continue;
+        }
+    
+        signal_setup_frame(proc, regs, sig, action);
+        break;
+    }
+    
+    signal_recalc(proc);
+}
+
+/* rt_sigreturn: restore the context saved by signal_setup_frame. The
+ * frame is user memory, so privilege-bearing state is not taken from it. */
+void signal_return(struct trap_frame* regs) {
+    struct process* proc = get_current_process();
+    
+    /* The handler's ret already popped the restorer slot */
+    u64 addr = regs->rsp - 8;
+    if (!vmm_access_ok(addr, sizeof(struct sigframe), false)) {
+        process_exit(128 + SIGSEGV);
+        return;
+    }
+    
+    struct sigframe* frame = (struct sigframe*)addr;
+    u64 cs = regs->cs;
+    u64 ss = regs->ss;
+    u64 rflags = (regs->rflags & ~(u64)RFLAGS_USER_MASK) | (frame->regs.rflags & RFLAGS_USER_MASK);
+    
+    *regs = frame->regs;
+    regs->cs = cs;
+    regs->ss = ss;
+    regs->rflags = rflags;
+    
+    proc->sigblocked = frame->blocked & ~SIG_UNBLOCKABLE;
+    signal_recalc(proc);
+}
+
+/* RTOS SYSTEM FUNCTIONS */
+
+/* Release every periodic job whose instant has passed. Instants advance on an
+ * absolute grid (next_execution += period), so tick jitter never becomes drift. */
+static void rtos_release_periodic_tasks(void) {
+    u64 now = clock_monotonic_ns();
+    if (now < next_periodic_release) return;
+
+    u64 earliest = ~0ULL;
+    for (u32 i = 0; i < periodic_task_count; i++) {
+        struct periodic_task* task = &periodic_tasks[i];
+        if (!task->active || task->edf) continue;
+
+        if (now >= task->next_execution) {
+            u64 period_ns = (u64)task->period_ms * 1000000;
+
+            if (task->pending) {
+                /* Previous job never started: drop this release */
+                task->overruns++;
+            } else {
+                task->release_time = task->next_execution;
+                task->pending = 1;
+                task->releases++;
+                cfs_wake_up_process(get_process_by_pid(task->pid));
+            }
+
+            /* Skip whole periods we slept through, keeping the phase */
+            task->next_execution += period_ns;
+            while (task->next_execution <= now) {
+                task->next_execution += period_ns;
+                task->overruns++;
+            }
+        }
+
+        if (task->next_execution < earliest) {
+            earliest = task->next_execution;
+        }
+    }
+    next_periodic_release = earliest;
+}
+
+/* System tick handler - called from timer interrupt */
+void rtos_tick_handler(void) {
+    ipc_system.system_ticks++;
+
+    /* Check for expired timeouts */
+    rtos_check_timeouts();
+
+    /* Wake periodic threads; the scheduler preempts by priority */
+    rtos_release_periodic_tasks();
+}
+
+/* Real-time scheduler - deadline tasks, then FIFO priorities, then CFS */
+struct process* rtos_schedule_next(void) {
+    return sched_pick_next_task();
+}
+
+/* Set process as real-time with priority */
+i32 rtos_set_realtime_priority(u32 pid, u32 priority) {
+    struct process* proc = get_process_by_pid(pid);
+    if (!proc) {
+        return -1;
+    }
+
+    /* Real-time priorities: 0-99 (0 = highest) */
+    if (priority > 99) {
+        return -1;
+    }
+
+    /* SCHED_FIFO: runs ahead of CFS, preempted only by higher priorities */
+    return sched_setscheduler(pid, SCHED_FIFO, priority);
+}
+
+/* Worst measured interrupt latency (any IRQ line) in microseconds */
+u32 rtos_get_interrupt_latency(void) {
+    return (u32)(irq_latency_max_ns() / 1000);
+}
+
+/* Interrupt latency budget; samples above it are counted per IRQ line */
+void rtos_set_max_interrupt_latency(u32 microseconds) {
+    ipc_system.interrupt_latency_budget_us = microseconds;
+    irq_set_latency_budget((u64)microseconds * 1000);
+}
+
+/* Get system timing statistics */
+void rtos_get_timing_stats(struct rtos_timing_stats* stats) {
+    stats->system_ticks = ipc_system.system_ticks;
+    stats->max_interrupt_latency_us = rtos_get_interrupt_latency();
+    
+    /* Measured by the scheduler on every wakeup */
+    struct sched_latency_stats latency;
+    sched_get_latency_stats(&latency);
+    stats->max_scheduling_latency_us = latency.max_ns / 1000;
+    
+    stats->active_timeouts = ipc_system.wheel.pending;
+    stats->rt_processes_ready = sched_rt_nr_running();
+    stats->preemption_enabled = ipc_system.preemption_enabled;
+    stats->missed_deadlines = sched_dl_total_misses();
+}
+
+/* Enable/disable preemption */
+void rtos_set_preemption(bool enabled) {
+    ipc_system.preemption_enabled = enabled;
+}
+
+/* Critical section management */
+static u32 critical_section_count = 0;
+
+void rtos_enter_critical(void) {
+    disable_interrupts();
+    critical_section_count++;
+}
+
+void rtos_exit_critical(void) {
+    if (critical_section_count > 0) {
+        critical_section_count--;
+        if (critical_section_count == 0) {
+            enable_interrupts();
+        }
+    }
+}
+
+/* High-precision delay for real-time applications */
+void rtos_delay_us(u32 microseconds) {
+    u64 start_ticks = rtos_get_ticks();
+    u64 delay_ticks = (microseconds * 1000) / 1000000;  /* Convert to ticks */
+
+    while ((rtos_get_ticks() - start_ticks) < delay_ticks) {
+        /* Busy wait for precise timing */
+        __asm__ volatile ("nop");
+    }
+}
+
+/* Priority-inheritance mutexes */
+
+#define PI_PRIO_NONE        256         /* CFS tasks: below every FIFO priority */
+#define PI_MAX_CHAIN_DEPTH  16          /* Bounds the walk, and any lock cycle */
+#define MUTEX_MAX_WAITERS   32
+
+static struct rtos_mutex rtos_mutexes[RTOS_MAX_MUTEXES];
+
+static struct rtos_mutex* rtos_mutex_get(i32 mutex_id) {
+    if (mutex_id < 0 || mutex_id >= RTOS_MAX_MUTEXES || !rtos_mutexes[mutex_id].in_use) {
+        return NULL;
+    }
+    return &rtos_mutexes[mutex_id];
+}
+
+static inline u32 mutex_owner(struct rtos_mutex* mutex) {
+    return mutex->owner_pid & ~RTOS_MUTEX_HAS_WAITERS;
+}
+
+/* Effective priority for inheritance, 0 highest; deadline tasks outrank FIFO */
+static u32 pi_task_prio(struct process* proc) {
+    if (proc->policy == SCHED_DEADLINE) return 0;
+    if (proc->policy == SCHED_FIFO) return proc->rt_prio;
+    return PI_PRIO_NONE;
+}
+
+/* Insert behind waiters of equal or higher priority */
+static void mutex_enqueue_waiter(struct rtos_mutex* mutex, struct process* proc) {
+    u32 prio = pi_task_prio(proc);
+    u32 pos = mutex->waiting_count;
+    while (pos > 0 && pi_task_prio(mutex->waiting_queue[pos - 1]) > prio) {
+        mutex->waiting_queue[pos] = mutex->waiting_queue[pos - 1];
+        pos--;
+    }
+    mutex->waiting_queue[pos] = proc;
+    mutex->waiting_count++;
+}
+
+static void mutex_dequeue_waiter(struct rtos_mutex* mutex, struct process* proc) {
+    for (u32 i = 0; i < mutex->waiting_count; i++) {
+        if (mutex->waiting_queue[i] == proc) {
+            for (u32 j = i; j < mutex->waiting_count - 1; j++) {
+                mutex->waiting_queue[j] = mutex->waiting_queue[j + 1];
+            }
+            mutex->waiting_count--;
+            return;
+        }
+    }
+}
+
+/* Boost (or unboost) an owner to the best top waiter over all mutexes it holds */
+static void pi_update_owner(struct process* owner) {
+    u32 top = PI_PRIO_NONE;
+
+    for (u32 i = 0; i < RTOS_MAX_MUTEXES; i++) {
+        struct rtos_mutex* mutex = &rtos_mutexes[i];
+        if (!mutex->in_use || mutex_owner(mutex) != owner->pid || mutex->waiting_count == 0) {
+            continue;
+        }
+
+        u32 prio = pi_task_prio(mutex->waiting_queue[0]);
+        mutex->inherited_priority = prio;
+        mutex->priority_inherited = prio < mutex->original_priority;
+        if (prio < top) {
+            top = prio;
+        }
+    }
+
+    sched_rt_mutex_setprio(owner, top);
+}
+
+/* The waiters of mutex changed: re-derive the owner's priority and, if it
+ * moved, requeue the owner where it waits itself and continue up the chain */
+static void pi_adjust_chain(struct rtos_mutex* mutex) {
+    for (u32 depth = 0; mutex && depth < PI_MAX_CHAIN_DEPTH; depth++) {
+        struct process* owner = get_process_by_pid(mutex_owner(mutex));
+        if (!owner) return;
+
+        u32 old_prio = pi_task_prio(owner);
+        pi_update_owner(owner);
+        if (pi_task_prio(owner) == old_prio) return;
+
+        mutex = (struct rtos_mutex*)owner->pi_blocked_on;
+        if (mutex) {
+            mutex_dequeue_waiter(mutex, owner);
+            mutex_enqueue_waiter(mutex, owner);
+        }
+    }
+}
+
+/* Create a mutex; recursive ones may be re-locked by their owner */
+i32 rtos_mutex_create(bool recursive) {
+    for (i32 i = 0; i < RTOS_MAX_MUTEXES; i++) {
+        struct rtos_mutex* mutex = &rtos_mutexes[i];
+        if (!mutex->in_use) {
+            memset(mutex, 0, sizeof(struct rtos_mutex));
+            mutex->recursive = recursive;
+            mutex->in_use = true;
+            return i;
+        }
+    }
+    return RTOS_NO_MEMORY;
+}
+
+/* Contended lock: queue by priority, boost the owner chain, sleep until handed the lock */
+static i32 rtos_mutex_lock_slow(struct rtos_mutex* mutex, struct process* current, u32 timeout_ms) {
+    u64 deadline = rtos_get_ticks() + rtos_ms_to_ticks(timeout_ms);
+
+    disable_interrupts();
+
+    /* Flag the lock word so the owner's unlock takes the handover path */
+    for (;;) {
+        u32 owner = mutex->owner_pid;
+        if (owner == 0) {
+            if (__sync_bool_compare_and_swap(&mutex->owner_pid, 0, current->pid)) {
+                mutex->lock_count = 1;
+                mutex->original_priority = pi_task_prio(current);
+                enable_interrupts();
+                return RTOS_OK;
+            }
+            continue;
+        }
+        if (mutex->waiting_count >= MUTEX_MAX_WAITERS) {
+            enable_interrupts();
+            return RTOS_NO_MEMORY;
+        }
+        if (__sync_bool_compare_and_swap(&mutex->owner_pid, owner, owner | RTOS_MUTEX_HAS_WAITERS)) {
+            break;
+        }
+    }
+
+    mutex_enqueue_waiter(mutex, current);
+    current->pi_blocked_on = mutex;
+    pi_adjust_chain(mutex);
+
+    struct rtos_timeout* timer = NULL;
+    if (timeout_ms > 0) {
+        timer = rtos_add_timeout(current, timeout_ms);
+    }
+
+    /* Unlock hands ownership over directly, so waking up means we own it */
+    while (mutex_owner(mutex) != current->pid) {
+        bool timed_out = timeout_ms > 0 && rtos_get_ticks() >= deadline;
+        if (timed_out || signal_pending(current)) {
+            mutex_dequeue_waiter(mutex, current);
+            current->pi_blocked_on = NULL;
+            if (mutex->waiting_count == 0) {
+                mutex->owner_pid = mutex_owner(mutex);
             }
+
+            /* We may have been what boosted the owner */
+            pi_adjust_chain(mutex);
+            rtos_cancel_timeout(timer, current);
+            enable_interrupts();
+            return timed_out ? RTOS_TIMEOUT : RTOS_INTERRUPTED;
         }
+
+        current->state = PROCESS_BLOCKED;
+        schedule();
     }
+
+    rtos_cancel_timeout(timer, current);
+    enable_interrupts();
+    return RTOS_OK;
 }
 
-/* RTOS SYSTEM FUNCTIONS */
+/* Lock a mutex, waiting at most timeout_ms (0 = forever) */
+i32 rtos_mutex_lock(i32 mutex_id, u32 timeout_ms) {
+    struct rtos_mutex* mutex = rtos_mutex_get(mutex_id);
+    if (!mutex) {
+        return RTOS_INVALID_PARAM;
+    }
 
-/* System tick handler - called from timer interrupt */
-void rtos_tick_handler(void) {
-    ipc_system.system_ticks++;
+    /* Boot code before the first schedule has no task to own the lock */
+    struct process* current = get_current_process();
+    if (!current) {
+        return RTOS_ERROR;
+    }
 
-    /* Check for expired timeouts */
-    rtos_check_timeouts();
+    /* Uncontended: one compare-and-swap, no scheduler or queue state touched */
+    if (__sync_bool_compare_and_swap(&mutex->owner_pid, 0, current->pid)) {
+        mutex->lock_count = 1;
+        mutex->original_priority = pi_task_prio(current);
+        return RTOS_OK;
+    }
+
+    if (mutex_owner(mutex) == current->pid) {
+        if (!mutex->recursive) {
+            return RTOS_ERROR;  /* Would deadlock on itself */
+        }
+        mutex->lock_count++;
+        return RTOS_OK;
+    }
+
+    return rtos_mutex_lock_slow(mutex, current, timeout_ms);
+}
+
+/* Unlock; with waiters, ownership passes straight to the highest-priority one */
+i32 rtos_mutex_unlock(i32 mutex_id) {
+    struct rtos_mutex* mutex = rtos_mutex_get(mutex_id);
+    if (!mutex) {
+        return RTOS_INVALID_PARAM;
+    }
 
-    /* Update process time slices for round-robin within priorities */
     struct process* current = get_current_process();
-    if (current && current->time_slice > 0) {
-        current->time_slice--;
+    if (!current || mutex_owner(mutex) != current->pid) {
+        return RTOS_ERROR;
+    }
+
+    if (--mutex->lock_count > 0) {
+        return RTOS_OK;
+    }
+
+    /* Uncontended: the lock word still holds just our PID */
+    if (__sync_bool_compare_and_swap(&mutex->owner_pid, current->pid, 0)) {
+        return RTOS_OK;
+    }
+
+    u64 irq_flags = irq_save();
+
+    /* The last waiter timed out or was interrupted after the CAS failed and
+     * cleared the waiters bit on its way out: release as uncontended */
+    if (mutex->waiting_count == 0) {
+        mutex->owner_pid = 0;
+        irq_restore(irq_flags);
+        return RTOS_OK;
+    }
+
+    struct process* next = mutex->waiting_queue[0];
+    mutex_dequeue_waiter(mutex, next);
+    next->pi_blocked_on = NULL;
+
+    mutex->owner_pid = next->pid | (mutex->waiting_count ? RTOS_MUTEX_HAS_WAITERS : 0);
+    mutex->lock_count = 1;
+    mutex->original_priority = pi_task_prio(next);
+    mutex->priority_inherited = false;
+
+    /* Drop the boost this mutex gave us; the new owner inherits the rest of the queue */
+    pi_update_owner(current);
+    pi_update_owner(next);
+    cfs_wake_up_process(next);
+
+    irq_restore(irq_flags);
+    scheduler_preempt_point();
+    return RTOS_OK;
+}
+
+/* Destroy an unlocked mutex */
+i32 rtos_mutex_destroy(i32 mutex_id) {
+    struct rtos_mutex* mutex = rtos_mutex_get(mutex_id);
+    if (!mutex) {
+        return RTOS_INVALID_PARAM;
+    }
+    if (mutex->owner_pid != 0) {
+        return RTOS_ERROR;
+    }
+
+    mutex->in_use = false;
+    return RTOS_OK;
+}
+
+/* Event flag groups */
+
+static struct rtos_event_flags rtos_events[RTOS_MAX_EVENT_GROUPS];
+
+static struct rtos_event_flags* rtos_event_group(i32 event_id) {
+    if (event_id < 0 || event_id >= RTOS_MAX_EVENT_GROUPS || !rtos_events[event_id].in_use) {
+        return NULL;
+    }
+    return &rtos_events[event_id];
+}
+
+static inline bool event_condition_met(u32 flags, u32 mask, bool wait_all) {
+    return wait_all ? (flags & mask) == mask : (flags & mask) != 0;
+}
 
-        /* If time slice expired, trigger preemption */
-        if (current->time_slice == 0 && ipc_system.preemption_enabled) {
-            current->time_slice = current->default_time_slice;
-            schedule();  /* Preemptive scheduling */
+/* Take a waiter slot off every per-bit list it is on */
+static void event_remove_waiter(struct rtos_event_flags* group, u32 slot) {
+    u32 slot_bit = 1u << slot;
+    u32 mask = group->wait_conditions[slot];
+
+    while (mask) {
+        group->bit_waiters[__builtin_ctz(mask)] &= ~slot_bit;
+        mask &= mask - 1;
+    }
+    group->used_slots &= ~slot_bit;
+    group->wait_all_slots &= ~slot_bit;
+    group->waiting_processes[slot] = NULL;
+    group->waiting_count--;
+}
+
+/* Create an event group, all flags clear */
+i32 rtos_event_create(void) {
+    for (i32 i = 0; i < RTOS_MAX_EVENT_GROUPS; i++) {
+        struct rtos_event_flags* group = &rtos_events[i];
+        if (!group->in_use) {
+            memset(group, 0, sizeof(struct rtos_event_flags));
+            group->in_use = true;
+            return i;
         }
     }
+    return RTOS_NO_MEMORY;
 }
 
-/* Real-time scheduler - priority-based with round-robin within priorities */
-struct process* rtos_schedule_next(void) {
-    /* First check real-time ready queue */
-    struct process* rt_proc = priority_queue_remove_highest(&ipc_system.rt_ready_queue);
-    if (rt_proc) {
-        return rt_proc;
+/* With auto-clear, the bits that satisfy a wait are consumed by it */
+i32 rtos_event_set_auto_clear(i32 event_id, bool enabled) {
+    struct rtos_event_flags* group = rtos_event_group(event_id);
+    if (!group) {
+        return RTOS_INVALID_PARAM;
     }
 
-    /* Fall back to regular CFS scheduler */
-    return cfs_pick_next_task();
+    group->auto_clear = enabled;
+    return RTOS_OK;
 }
 
-/* Set process as real-time with priority */
-i32 rtos_set_realtime_priority(u32 pid, u32 priority) {
-    struct process* proc = get_process_by_pid(pid);
-    if (!proc) {
-        return -1;
+/* Set flags and wake the waiters they satisfy. Only waiters listed under
+ * one of the bits being set are evaluated, not every waiter of the group. */
+i32 rtos_event_set(i32 event_id, u32 flags) {
+    struct rtos_event_flags* group = rtos_event_group(event_id);
+    if (!group) {
+        return RTOS_INVALID_PARAM;
     }
 
-    /* Real-time priorities: 0-99 (0 = highest) */
-    if (priority > 99) {
-        return -1;
+    u64 irq_flags = irq_save();
+    group->flags |= flags;
+
+    u32 candidates = 0;
+    for (u32 bits = flags; bits; bits &= bits - 1) {
+        candidates |= group->bit_waiters[__builtin_ctz(bits)];
     }
 
-    proc->priority = priority;
-    proc->is_realtime = true;
-    proc->time_slice = 10;  /* Shorter time slice for RT processes */
-    proc->default_time_slice = 10;
+    /* Every satisfied waiter sees the same flag state; auto-clear happens after */
+    u32 consumed = 0;
+    while (candidates) {
+        u32 slot = __builtin_ctz(candidates);
+        candidates &= candidates - 1;
+
+        u32 mask = group->wait_conditions[slot];
+        if (!event_condition_met(group->flags, mask, group->wait_all_slots & (1u << slot))) {
+            continue;
+        }
+
+        struct process* proc = group->waiting_processes[slot];
+        consumed |= group->flags & mask;
+        event_remove_waiter(group, slot);
+        cfs_wake_up_process(proc);
+    }
 
-    /* If process is ready, add to RT queue */
-    if (proc->state == PROCESS_READY) {
-        priority_queue_insert(&ipc_system.rt_ready_queue, proc, priority);
+    if (group->auto_clear) {
+        group->flags &= ~consumed;
     }
 
-    return 0;
+    irq_restore(irq_flags);
+    scheduler_preempt_point();
+    return RTOS_OK;
 }
 
-/* Get system timing statistics */
-void rtos_get_timing_stats(struct rtos_timing_stats* stats) {
-    stats->system_ticks = ipc_system.system_ticks;
-    stats->max_interrupt_latency_us = ipc_system.max_interrupt_latency_us;
-    stats->max_scheduling_latency_us = ipc_system.max_scheduling_latency_us;
-    stats->active_timeouts = ipc_system.timeout_count;
-    stats->rt_processes_ready = ipc_system.rt_ready_queue.count;
-    stats->preemption_enabled = ipc_system.preemption_enabled;
+/* Clear flags; never wakes anyone */
+i32 rtos_event_clear(i32 event_id, u32 flags) {
+    struct rtos_event_flags* group = rtos_event_group(event_id);
+    if (!group) {
+        return RTOS_INVALID_PARAM;
+    }
+
+    /* rtos_event_set updates the same word from interrupts */
+    __sync_fetch_and_and(&group->flags, ~flags);
+    return RTOS_OK;
 }
 
-/* Enable/disable preemption */
-void rtos_set_preemption(bool enabled) {
-    ipc_system.preemption_enabled = enabled;
+/* Current flag state */
+u32 rtos_event_get(i32 event_id) {
+    struct rtos_event_flags* group = rtos_event_group(event_id);
+    return group ? group->flags : 0;
 }
 
-/* Critical section management */
-static u32 critical_section_count = 0;
+/* Wait until any (or all, with wait_all) of flags are set; timeout_ms 0 = forever */
+i32 rtos_event_wait(i32 event_id, u32 flags, bool wait_all, u32 timeout_ms) {
+    struct rtos_event_flags* group = rtos_event_group(event_id);
+    if (!group || flags == 0) {
+        return RTOS_INVALID_PARAM;
+    }
+
+    struct process* current = get_current_process();
+    u64 deadline = rtos_get_ticks() + rtos_ms_to_ticks(timeout_ms);
 
-void rtos_enter_critical(void) {
     disable_interrupts();
-    critical_section_count++;
-}
 
-void rtos_exit_critical(void) {
-    if (critical_section_count > 0) {
-        critical_section_count--;
-        if (critical_section_count == 0) {
+    /* Already satisfied */
+    if (event_condition_met(group->flags, flags, wait_all)) {
+        if (group->auto_clear) {
+            group->flags &= ~flags;
+        }
+        enable_interrupts();
+        return RTOS_OK;
+    }
+
+    if (group->used_slots == 0xFFFFFFFF) {
+        enable_interrupts();
+        return RTOS_NO_MEMORY;
+    }
+
+    /* Take a slot and list it under each bit it waits on */
+    u32 slot = __builtin_ctz(~group->used_slots);
+    group->waiting_processes[slot] = current;
+    group->wait_conditions[slot] = flags;
+    group->used_slots |= 1u << slot;
+    if (wait_all) {
+        group->wait_all_slots |= 1u << slot;
+    }
+    for (u32 bits = flags; bits; bits &= bits - 1) {
+        group->bit_waiters[__builtin_ctz(bits)] |= 1u << slot;
+    }
+    group->waiting_count++;
+
+    struct rtos_timeout* timer = NULL;
+    if (timeout_ms > 0) {
+        timer = rtos_add_timeout(current, timeout_ms);
+    }
+
+    /* rtos_event_set frees the slot when it wakes us */
+    while (group->waiting_processes[slot] == current) {
+        bool timed_out = timeout_ms > 0 && rtos_get_ticks() >= deadline;
+        if (timed_out || signal_pending(current)) {
+            event_remove_waiter(group, slot);
+            rtos_cancel_timeout(timer, current);
             enable_interrupts();
+            return timed_out ? RTOS_TIMEOUT : RTOS_INTERRUPTED;
         }
+
+        current->state = PROCESS_BLOCKED;
+        schedule();
     }
+
+    rtos_cancel_timeout(timer, current);
+    enable_interrupts();
+    return RTOS_OK;
 }
 
-/* High-precision delay for real-time applications */
-void rtos_delay_us(u32 microseconds) {
-    u64 start_ticks = rtos_get_ticks();
-    u64 delay_ticks = (microseconds * 1000) / 1000000;  /* Convert to ticks */
+/* Destroy a group nobody is waiting on */
+i32 rtos_event_destroy(i32 event_id) {
+    struct rtos_event_flags* group = rtos_event_group(event_id);
+    if (!group) {
+        return RTOS_INVALID_PARAM;
+    }
+    if (group->waiting_count > 0) {
+        return RTOS_ERROR;
+    }
 
-    while ((rtos_get_ticks() - start_ticks) < delay_ticks) {
-        /* Busy wait for precise timing */
-        __asm__ volatile ("nop");
+    group->in_use = false;
+    return RTOS_OK;
+}
+
+/* Fixed-block memory pools: embedded free list, lock-free alloc/free.
+ * The head carries a tag bumped on every pop so a stale CAS cannot succeed
+ * after the block was taken and returned (ABA). Safe from interrupt context. */
+
+#define POOL_ALIGN       16
+#define POOL_GUARD_SIZE  8
+#define POOL_GUARD_HEAD  0xC0FFEE00DEADBEEFULL
+#define POOL_GUARD_TAIL  0xFEEDFACECAFEF00DULL
+
+static struct rtos_memory_pool rtos_pools[RTOS_MAX_POOLS];
+
+static struct rtos_memory_pool* rtos_pool_get(i32 pool_id) {
+    if (pool_id < 0 || pool_id >= RTOS_MAX_POOLS || !rtos_pools[pool_id].initialized) {
+        return NULL;
+    }
+    return &rtos_pools[pool_id];
+}
+
+static inline u8* pool_block(struct rtos_memory_pool* pool, u32 index) {
+    return (u8*)pool->pool_start + (u64)index * pool->stride;
+}
+
+/* Caller's area within a block */
+static inline void* pool_payload(struct rtos_memory_pool* pool, u8* block) {
+    return pool->guard_words ? block + POOL_GUARD_SIZE : block;
+}
+
+/* Link to the next free block (index + 1), kept in the first word of the payload */
+static inline volatile u32* pool_link(struct rtos_memory_pool* pool, u8* block) {
+    return (volatile u32*)pool_payload(pool, block);
+}
+
+static void pool_set_guards(struct rtos_memory_pool* pool, u8* block) {
+    *(u64*)block = POOL_GUARD_HEAD;
+    *(u64*)(block + POOL_GUARD_SIZE + pool->block_size) = POOL_GUARD_TAIL;
+}
+
+static bool pool_guards_intact(struct rtos_memory_pool* pool, u8* block) {
+    return *(u64*)block == POOL_GUARD_HEAD &&
+           *(u64*)(block + POOL_GUARD_SIZE + pool->block_size) == POOL_GUARD_TAIL;
+}
+
+static void pool_push(struct rtos_memory_pool* pool, u32 index) {
+    u8* block = pool_block(pool, index);
+    u64 head, new_head;
+
+    do {
+        head = pool->free_head;
+        *pool_link(pool, block) = (u32)head;
+        new_head = (head & 0xFFFFFFFF00000000ULL) | (index + 1);
+    } while (!__sync_bool_compare_and_swap(&pool->free_head, head, new_head));
+
+    __sync_fetch_and_add(&pool->free_blocks, 1);
+}
+
+static i32 rtos_pool_setup(u32 block_size, u32 num_blocks, bool guard_words) {
+    if (block_size == 0 || num_blocks == 0 || num_blocks >= 0xFFFFFFFF) {
+        return RTOS_INVALID_PARAM;
+    }
+
+    /* Room for the free-list link, guards at 8-byte alignment */
+    if (block_size < sizeof(u32)) {
+        block_size = sizeof(u32);
+    }
+    block_size = (block_size + 7) & ~7u;
+    u32 stride = block_size + (guard_words ? 2 * POOL_GUARD_SIZE : 0);
+    stride = (stride + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1);
+
+    for (i32 i = 0; i < RTOS_MAX_POOLS; i++) {
+        struct rtos_memory_pool* pool = &rtos_pools[i];
+        if (pool->initialized) {
+            continue;
+        }
+
+        /* The only kmalloc a pool ever does; the allocated bitmap follows the blocks */
+        u64 blocks_size = (u64)stride * num_blocks;
+        u64 bitmap_size = ((num_blocks + 63) / 64) * sizeof(u64);
+        void* memory = kmalloc(blocks_size + bitmap_size);
+        if (!memory) {
+            return RTOS_NO_MEMORY;
+        }
+
+        memset(pool, 0, sizeof(struct rtos_memory_pool));
+        pool->pool_start = memory;
+        pool->allocated = (volatile u64*)((u8*)memory + blocks_size);
+        memset((void*)pool->allocated, 0, bitmap_size);
+        pool->block_size = block_size;
+        pool->stride = stride;
+        pool->total_blocks = num_blocks;
+        pool->guard_words = guard_words;
+
+        /* Push in reverse so blocks come out in address order */
+        for (u32 index = num_blocks; index-- > 0;) {
+            if (guard_words) {
+                pool_set_guards(pool, pool_block(pool, index));
+            }
+            pool_push(pool, index);
+        }
+
+        pool->initialized = true;
+        return i;
+    }
+
+    return RTOS_NO_MEMORY;
+}
+
+/* Create a pool of num_blocks blocks of block_size bytes */
+i32 rtos_pool_create(u32 block_size, u32 num_blocks) {
+    return rtos_pool_setup(block_size, num_blocks, false);
+}
+
+/* Same, with guard words around each block checked on alloc and free */
+i32 rtos_pool_create_guarded(u32 block_size, u32 num_blocks) {
+    return rtos_pool_setup(block_size, num_blocks, true);
+}
+
+/* O(1), bounded: one CAS retry per concurrent pool operation, never kmalloc */
+void* rtos_pool_alloc(i32 pool_id) {
+    struct rtos_memory_pool* pool = rtos_pool_get(pool_id);
+    if (!pool) {
+        return NULL;
+    }
+
+    u64 head, new_head;
+    u8* block;
+
+    u32 index;
+
+    do {
+        head = pool->free_head;
+        u32 index_plus_one = (u32)head;
+        if (index_plus_one == 0) {
+            __sync_fetch_and_add(&pool->failed_allocs, 1);
+            return NULL;
+        }
+
+        index = index_plus_one - 1;
+        block = pool_block(pool, index);
+        u64 tag = (head >> 32) + 1;
+        new_head = (tag << 32) | *pool_link(pool, block);
+    } while (!__sync_bool_compare_and_swap(&pool->free_head, head, new_head));
+
+    __sync_fetch_and_or(&pool->allocated[index / 64], 1ULL << (index % 64));
+
+    /* High-water mark of blocks in use */
+    u32 in_use = pool->total_blocks - __sync_sub_and_fetch(&pool->free_blocks, 1);
+    u32 high = pool->high_water;
+    while (in_use > high && !__sync_bool_compare_and_swap(&pool->high_water, high, in_use)) {
+        high = pool->high_water;
+    }
+
+    /* A neighbour overran into this free block */
+    if (pool->guard_words && !pool_guards_intact(pool, block)) {
+        __sync_fetch_and_add(&pool->guard_violations, 1);
+        pool_set_guards(pool, block);
+    }
+
+    return pool_payload(pool, block);
+}
+
+/* Return a block; RTOS_ERROR for blocks already free and blocks with damaged guards */
+i32 rtos_pool_free(i32 pool_id, void* ptr) {
+    struct rtos_memory_pool* pool = rtos_pool_get(pool_id);
+    if (!pool || !ptr) {
+        return RTOS_INVALID_PARAM;
+    }
+
+    u8* block = pool->guard_words ? (u8*)ptr - POOL_GUARD_SIZE : (u8*)ptr;
+    u64 offset = (u64)(block - (u8*)pool->pool_start);
+    if (block < (u8*)pool->pool_start || offset % pool->stride != 0 ||
+        offset / pool->stride >= pool->total_blocks) {
+        return RTOS_INVALID_PARAM;
+    }
+
+    /* The caller wrote past its block; keep it out of circulation */
+    if (pool->guard_words && !pool_guards_intact(pool, block)) {
+        __sync_fetch_and_add(&pool->guard_violations, 1);
+        return RTOS_ERROR;
+    }
+
+    /* A second free would push the block twice and loop the free list */
+    u32 index = (u32)(offset / pool->stride);
+    u64 bit = 1ULL << (index % 64);
+    if (!(__sync_fetch_and_and(&pool->allocated[index / 64], ~bit) & bit)) {
+        return RTOS_ERROR;
+    }
+
+    pool_push(pool, index);
+    return RTOS_OK;
+}
+
+/* Destroy a pool whose blocks have all been returned */
+i32 rtos_pool_destroy(i32 pool_id) {
+    struct rtos_memory_pool* pool = rtos_pool_get(pool_id);
+    if (!pool) {
+        return RTOS_INVALID_PARAM;
     }
+    if (pool->free_blocks != pool->total_blocks) {
+        return RTOS_ERROR;
+    }
+
+    pool->initialized = false;
+    kfree(pool->pool_start);
+    pool->pool_start = NULL;
+    pool->allocated = NULL;
+    return RTOS_OK;
+}
+
+/* Usage counters of a pool */
+i32 rtos_pool_get_stats(i32 pool_id, struct rtos_pool_stats* stats) {
+    struct rtos_memory_pool* pool = rtos_pool_get(pool_id);
+    if (!pool) {
+        return RTOS_INVALID_PARAM;
+    }
+
+    stats->block_size = pool->block_size;
+    stats->total_blocks = pool->total_blocks;
+    stats->free_blocks = pool->free_blocks;
+    stats->high_water = pool->high_water;
+    stats->failed_allocs = pool->failed_allocs;
+    stats->guard_violations = pool->guard_violations;
+    return RTOS_OK;
 }
 
 /* Periodic task support */
-struct periodic_task {
-    void (*task_function)(void);
-    u32 period_ms;
-    u64 next_execution;
-    bool active;
-    u32 priority;
-};
 
-static struct periodic_task periodic_tasks[32];
-static u32 periodic_task_count = 0;
+/* Account one finished job */
+static void periodic_record_job(struct periodic_task* task, u64 release, u64 start, u64 end) {
+    u64 response = end - release;
+    u64 start_delay = start - release;
+
+    if (task->completed == 0 || response < task->min_response_ns) {
+        task->min_response_ns = response;
+    }
+    if (response > task->max_response_ns) {
+        task->max_response_ns = response;
+    }
+    if (start_delay > task->max_start_delay_ns) {
+        task->max_start_delay_ns = start_delay;
+    }
+    task->total_response_ns += response;
+    task->completed++;
+}
+
+/* Body of a tick-released periodic task: sleep, run one job per release */
+static void rtos_periodic_fifo_thread(void* arg) {
+    struct periodic_task* task = (struct periodic_task*)arg;
+    struct process* self = get_current_process();
+
+    while (task->active) {
+        /* Interrupts off so a release cannot land between the check and the block */
+        disable_interrupts();
+        while (task->pending == 0 && task->active) {
+            self->state = PROCESS_BLOCKED;
+            schedule();
+        }
+        task->pending = 0;
+        u64 release = task->release_time;
+        enable_interrupts();
+
+        u64 start = clock_monotonic_ns();
+        task->task_function();
+        periodic_record_job(task, release, start, clock_monotonic_ns());
+    }
+
+    process_exit(0);
+}
 
-/* Register periodic task */
+/* Register a periodic task as a SCHED_FIFO thread (priority 0 = highest),
+ * released by the timer tick every period_ms */
 i32 rtos_register_periodic_task(void (*task_func)(void), u32 period_ms, u32 priority) {
-    if (periodic_task_count >= 32) {
-        return -1;
+    if (!task_func || period_ms == 0 || priority > RTOS_MAX_RT_PRIORITY) {
+        return RTOS_INVALID_PARAM;
+    }
+    if (periodic_task_count >= RTOS_MAX_PERIODIC_TASKS) {
+        return RTOS_NO_MEMORY;
     }
 
-    struct periodic_task* task = &periodic_tasks[periodic_task_count++];
+    struct periodic_task* task = &periodic_tasks[periodic_task_count];
+    memset(task, 0, sizeof(struct periodic_task));
     task->task_function = task_func;
     task->period_ms = period_ms;
-    task->next_execution = rtos_get_ticks() + rtos_ms_to_ticks(period_ms);
     task->active = true;
     task->priority = priority;
 
-    return periodic_task_count - 1;
+    /* Interrupts stay off until the thread has its class, so a failed
+     * setup can discard it before it ever runs */
+    u64 irq_flags = irq_save();
+    i32 pid = kthread_create("rt-periodic", rtos_periodic_fifo_thread, task);
+    if (pid <= 0) {
+        irq_restore(irq_flags);
+        task->active = false;
+        return RTOS_NO_MEMORY;
+    }
+    if (sched_setscheduler(pid, SCHED_FIFO, priority) < 0) {
+        kthread_discard(pid);
+        irq_restore(irq_flags);
+        task->active = false;
+        return RTOS_ERROR;
+    }
+    task->pid = pid;
+    irq_restore(irq_flags);
+
+    /* First release one period from now; later ones follow on the same grid */
+    task->next_execution = clock_monotonic_ns() + (u64)period_ms * 1000000;
+    if (task->next_execution < next_periodic_release) {
+        next_periodic_release = task->next_execution;
+    }
+
+    return periodic_task_count++;
 }
 
-/* Execute periodic tasks - called from scheduler */
-void rtos_execute_periodic_tasks(void) {
-    u64 current_ticks = rtos_get_ticks();
+/* Body of a deadline-scheduled periodic task: one job per period */
+static void rtos_periodic_thread(void* arg) {
+    struct periodic_task* task = (struct periodic_task*)arg;
+    struct sched_dl_info info;
+
+    while (task->active) {
+        /* The instance's release is its absolute deadline minus the relative one */
+        u64 start = clock_monotonic_ns();
+        u64 release = start;
+        if (sched_get_deadline_info(0, &info) == 0 && info.abs_deadline_ns - info.deadline_ns <= start) {
+            release = info.abs_deadline_ns - info.deadline_ns;
+        }
 
-    for (u32 i = 0; i < periodic_task_count; i++) {
-        struct periodic_task* task = &periodic_tasks[i];
+        task->task_function();
+        task->releases++;
+        periodic_record_job(task, release, start, clock_monotonic_ns());
+        sched_dl_yield();
+    }
 
-        if (task->active && current_ticks >= task->next_execution) {
-            /* Execute task */
-            task->task_function();
+    process_exit(0);
+}
 
-            /* Schedule next execution */
-            task->next_execution = current_ticks + rtos_ms_to_ticks(task->period_ms);
-        }
+/* Create a periodic task in the EDF/CBS class with a wcet_us budget per period.
+ * Rejected if the admitted utilisation would exceed the deadline class limit. */
+i32 rtos_create_periodic_task(void (*task_func)(void), u32 period_ms, u32 wcet_us) {
+    if (!task_func || period_ms == 0 || wcet_us == 0) {
+        return RTOS_INVALID_PARAM;
+    }
+    if (periodic_task_count >= RTOS_MAX_PERIODIC_TASKS) {
+        return RTOS_NO_MEMORY;
+    }
+
+    u64 period_ns = (u64)period_ms * 1000000;
+    u64 runtime_ns = (u64)wcet_us * 1000;
+    if (!sched_dl_can_admit(runtime_ns, period_ns)) {
+        return RTOS_ERROR;
+    }
+
+    struct periodic_task* task = &periodic_tasks[periodic_task_count];
+    memset(task, 0, sizeof(struct periodic_task));
+    task->task_function = task_func;
+    task->period_ms = period_ms;
+    task->active = true;
+    task->edf = true;
+
+    /* Interrupts stay off until the thread has its class, so a failed
+     * setup can discard it before it ever runs */
+    u64 irq_flags = irq_save();
+    i32 pid = kthread_create("rt-periodic", rtos_periodic_thread, task);
+    if (pid <= 0) {
+        irq_restore(irq_flags);
+        task->active = false;
+        return RTOS_NO_MEMORY;
+    }
+
+    /* Implicit deadline: relative deadline equals the period */
+    if (sched_setattr_deadline(pid, runtime_ns, period_ns, period_ns) < 0) {
+        kthread_discard(pid);
+        irq_restore(irq_flags);
+        task->active = false;
+        return RTOS_ERROR;
     }
+
+    task->pid = pid;
+    irq_restore(irq_flags);
+    return periodic_task_count++;
+}
+
+/* Report RTOS_DEADLINE_MISSED if the task missed a deadline since the last check */
+i32 rtos_deadline_check(u32 pid) {
+    i64 misses = sched_dl_check_misses(pid);
+    if (misses < 0) {
+        return RTOS_INVALID_PARAM;
+    }
+    return misses > 0 ? RTOS_DEADLINE_MISSED : RTOS_OK;
+}
+
+/* Fill EDF task information, times in ticks */
+void rtos_get_task_statistics(u32 pid, struct rtos_task_info* stats) {
+    struct sched_dl_info info;
+
+    memset(stats, 0, sizeof(struct rtos_task_info));
+    if (sched_get_deadline_info(pid, &info) < 0) {
+        return;
+    }
+
+    stats->period_ms = info.period_ns / 1000000;
+    stats->next_deadline = info.abs_deadline_ns / (1000000000ULL / RTOS_TICK_RATE_HZ);
+    stats->worst_case_execution_time = info.runtime_ns / (1000000000ULL / RTOS_TICK_RATE_HZ);
+    stats->deadline_misses = info.deadline_misses;
+    stats->is_periodic = true;
+    stats->deadline_monitoring = true;
+}
+
+/* Response-time statistics of a periodic task (times in microseconds) */
+i32 rtos_get_periodic_stats(i32 task_id, struct rtos_periodic_stats* stats) {
+    if (task_id < 0 || (u32)task_id >= periodic_task_count) {
+        return RTOS_INVALID_PARAM;
+    }
+
+    struct periodic_task* task = &periodic_tasks[task_id];
+    stats->pid = task->pid;
+    stats->period_ms = task->period_ms;
+    stats->releases = task->releases;
+    stats->completed = task->completed;
+    stats->overruns = task->overruns;
+    stats->min_response_us = task->min_response_ns / 1000;
+    stats->max_response_us = task->max_response_ns / 1000;
+    stats->avg_response_us = task->completed ? task->total_response_ns / task->completed / 1000 : 0;
+    stats->max_start_delay_us = task->max_start_delay_ns / 1000;
+    return RTOS_OK;
+}
+
+/* Periodic jobs run in their own threads, released by the tick; a polling
+ * caller only needs to let any released job preempt it */
+void rtos_execute_periodic_tasks(void) {
+    scheduler_preempt_point();
 }
@@ -5,6 +5,45 @@
 
 static u64 boot_time = 0;
 
+/* Find the kernel command line in the multiboot2 information */
+static const char* multiboot2_cmdline(struct multiboot2_info* mbi) {
+    if (!mbi) {
+        return NULL;
+    }
+    
+    u8* tag = (u8*)mbi + sizeof(struct multiboot2_info);
+    u8* end = (u8*)mbi + mbi->total_size;
+    
+    while (tag < end) {
+        struct multiboot2_tag* t = (struct multiboot2_tag*)tag;
+        if (t->type == MULTIBOOT2_TAG_TYPE_END) {
+            break;
+        }
+        if (t->type == MULTIBOOT2_TAG_TYPE_CMDLINE) {
+            return ((struct multiboot2_tag_string*)t)->string;
+        }
+        /* Tags are 8-byte aligned */
+        tag += (t->size + 7) & ~7;
+    }
+    
+    return NULL;
+}
+
+/* Apply boot options that must be known before tasks are created */
+static void parse_boot_options(const char* cmdline) {
+    if (!cmdline) {
+        return;
+    }
+    
+    for (const char* p = cmdline; *p; p++) {
+        if ((p == cmdline || p[-1] == ' ') && strncmp(p, "isolcpus=", 9) == 0) {
+            if (sched_set_isolated_cpus(p + 9) < 0) {
+                vga_puts("Ignoring malformed isolcpus= option\n");
+            }
+        }
+    }
+}
+
 void kernel_main(struct multiboot2_info* mbi) {
     /* Initialize VGA text mode first for output */
     vga_init();
@@ -27,11 +66,20 @@ void kernel_main(struct multiboot2_info* mbi) {
     idt_init();
     vga_puts("OK\n");
     
+    /* Calibrate TSC and start the system tick while interrupts are still off */
+    clocksource_init();
+    
     /* Install IRQ handlers */
     vga_puts("Installing IRQ handlers... ");
     irq_install();
     vga_puts("OK\n");
     
+    /* Kernel command line options */
+    parse_boot_options(multiboot2_cmdline(mbi));
+    
+    /* Enable x87/SSE/AVX with lazy per-task state */
+    fpu_init();
+    
     /* Initialize memory management */
     vga_puts("Initializing memory management... ");
     mm_init();
@@ -51,7 +99,7 @@ void kernel_main(struct multiboot2_info* mbi) {
     vga_puts("Type 'help' for available commands.\n\n");
     
     /* Record boot time */
-    boot_time = 0; // Will be updated when timer is implemented
+    boot_time = clock_monotonic_ns();
     
     /* Start the shell */
     shell_run();
@@ -63,8 +111,7 @@ void kernel_main(struct multiboot2_info* mbi) {
 
 /* Get system uptime in seconds */
 u64 get_uptime(void) {
-    // TODO: Implement proper timer-based uptime
-    return 0;
+    return clock_monotonic_ns() / 1000000000ULL;
 }
 
 /* System halt function */
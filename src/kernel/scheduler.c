@@ -2,11 +2,19 @@
 
 /* Advanced Multitasking & Completely Fair Scheduler (CFS) for Kronos OS */
 
-#define MAX_PROCESSES 256
+#define PID_MAX 32768  /* PIDs wrap here; PCBs themselves are unbounded */
+#define PID_HASH_SIZE 256  /* Power of two */
 #define PROCESS_STACK_SIZE 8192
-#define TIME_SLICE_MS 10
 #define CFS_PERIOD_NS 6000000  /* 6ms period */
 #define CFS_MIN_GRANULARITY_NS 750000  /* 0.75ms minimum */
+#define CFS_WAKEUP_GRANULARITY_NS 1000000  /* 1ms lead before a wakee preempts */
+#define CFS_SLEEPER_BONUS_NS (CFS_PERIOD_NS / 2)  /* Credit given to sleepers */
+#define CFS_BANDWIDTH_PERIOD_NS 100000000  /* Default 100ms quota period */
+#define NICE_0_WEIGHT 1024
+#define DL_BW_SHIFT 20
+#define DL_BW_LIMIT ((95ULL << DL_BW_SHIFT) / 100)  /* Leave 5% of the CPU to CFS */
+#define RT_PRIO_LEVELS 256  /* SCHED_FIFO priorities, 0 highest */
+#define RT_BITMAP_WORDS (RT_PRIO_LEVELS / 64)
 
 /* Process states */
 typedef enum {
@@ -36,9 +44,84 @@ struct cpu_context {
     u64 cr3;  /* Page directory */
 } __attribute__((packed));
 
-/* Process Control Block (PCB) */
+/* CFS Red-Black Tree for runqueue */
+struct rb_node {
+    struct sched_entity* se;
+    u64 key;  /* vruntime */
+    struct rb_node* left;
+    struct rb_node* right;
+    struct rb_node* parent;
+    bool red;
+};
+
+/* CFS runqueue - one for the root and one per task group */
+struct cfs_rq {
+    struct rb_node* root;          /* Red-black tree of queued entities */
+    struct sched_entity* curr;     /* Entity running from this queue, not in the tree */
+    struct task_group* tg;         /* Group that owns this queue */
+    u64 total_weight;              /* Weight of all on_rq entities including curr */
+    u64 min_vruntime;
+    u32 nr_running;                /* Entities (tasks or groups) on this queue */
+};
+
+/* Schedulable entity - a task, or a group as seen by its parent queue */
+struct sched_entity {
+    u64 vruntime;              /* Virtual runtime */
+    u64 weight;                /* Scheduling weight */
+    u64 exec_start;            /* When entity started executing */
+    u64 sum_exec_runtime;      /* Total execution time */
+    struct cfs_rq* cfs_rq;     /* Queue this entity is placed on */
+    struct cfs_rq* my_q;       /* Queue owned by a group entity, NULL for tasks */
+    struct sched_entity* parent;  /* Group entity one level up, NULL at root */
+    struct rb_node run_node;   /* Link in cfs_rq->root while queued */
+    u32 depth;
+    bool on_rq;
+};
+
+/* Deadline (EDF + constant bandwidth server) parameters and state */
+struct sched_dl_entity {
+    u64 dl_runtime;            /* Budget per instance */
+    u64 dl_deadline;           /* Relative deadline */
+    u64 dl_period;             /* Minimum inter-arrival time */
+    u64 dl_bw;                 /* dl_runtime / dl_period, DL_BW_SHIFT fixed point */
+    
+    i64 runtime;               /* Budget left in the current instance */
+    u64 deadline;              /* Absolute deadline of the current instance */
+    u64 deadline_misses;
+    u64 misses_reported;       /* Misses already returned by sched_dl_check_misses */
+    bool throttled;            /* Budget gone, waiting for replenishment */
+    bool yielded;              /* Job finished early; the replenishment is not a miss */
+    bool on_dl_rq;
+    struct process* dl_next;   /* Runqueue or throttled list link */
+};
+
+/* Address space shared by all threads of a process */
+struct mm_struct {
+    struct page_directory* page_directory;
+    struct vma* vma_list;
+    u64 virtual_memory_base;
+    u64 virtual_memory_size;
+    u64 heap_base;
+    u64 heap_size;
+    u32 users;                  /* Threads using this address space */
+};
+
+/* Open file table shared by threads created with CLONE_FILES */
+struct files_struct {
+    struct file_descriptor* fd_table[MAX_FD_PER_PROCESS];
+    u32 users;
+};
+
+/* Signal dispositions shared by threads created with CLONE_SIGHAND */
+struct sighand_struct {
+    struct sigaction action[NSIG];
+    u32 users;
+};
+
+/* Thread control block - one schedulable thread; threads of one process share mm/files */
 struct process {
-    u32 pid;                    /* Process ID */
+    u32 pid;                    /* Thread ID */
+    u32 tgid;                   /* Thread group (process) ID */
     u32 ppid;                   /* Parent Process ID */
     char name[64];              /* Process name */
     process_state_t state;      /* Current state */
@@ -46,28 +129,49 @@ struct process {
     
     /* CPU context for context switching */
     struct cpu_context context;
+    struct fpu_context fpu;     /* Saved lazily on first FPU use after a switch */
     
     /* Memory management */
-    u64 virtual_memory_base;
-    u64 virtual_memory_size;
+    struct mm_struct* mm;       /* Shared with CLONE_VM threads */
     u64 stack_base;
-    u64 heap_base;
-    u64 heap_size;
+    void* kernel_stack;         /* Stack allocated by clone, released when reaped */
     
-    /* CFS scheduling data */
-    u64 vruntime;              /* Virtual runtime */
-    u64 exec_start;            /* When process started executing */
-    u64 sum_exec_runtime;      /* Total execution time */
+    /* CFS scheduling data (all times in nanoseconds) */
+    struct sched_entity se;
     u64 nice_value;            /* Nice value (-20 to 19) */
-    u64 weight;                /* Scheduling weight */
+    struct task_group* group;  /* CPU bandwidth group */
+    u64 cpus_allowed;          /* Affinity mask, always a subset of online CPUs */
+    
+    /* Scheduling class: SCHED_DEADLINE, then SCHED_FIFO, then CFS */
+    u32 policy;
+    struct sched_dl_entity dl;
+    
+    /* SCHED_FIFO runqueue linkage */
+    struct process* rt_next;
+    struct process* rt_prev;
+    u32 rt_prio;
+    bool on_rt_rq;
+    
+    /* Priority inheritance (rtos_mutex) */
+    void* pi_blocked_on;        /* Mutex this task is waiting for */
+    u32 normal_policy;          /* Policy and FIFO priority to restore when the boost ends */
+    u32 normal_prio;
+    bool pi_boosted;
     
     /* Time accounting */
     u64 creation_time;
     u64 last_scheduled;
     u64 total_cpu_time;
+    u64 wake_time;              /* When the task last became runnable, 0 once running */
+    struct sched_latency_stats latency;
     
     /* File descriptors */
-    struct file_descriptor* fd_table[MAX_FD_PER_PROCESS];
+    struct files_struct* files; /* Shared with CLONE_FILES threads */
+    
+    /* Signals */
+    u64 sigpending;             /* Sent to this thread, not yet delivered */
+    u64 sigblocked;
+    struct sighand_struct* sighand; /* Shared with CLONE_SIGHAND threads */
     
     /* Process tree */
     struct process* parent;
@@ -77,49 +181,226 @@ struct process {
     /* Synchronization */
     u32 exit_code;
     bool in_use;
-} processes[MAX_PROCESSES];
-
-/* CFS Red-Black Tree for runqueue */
-struct rb_node {
-    struct process* process;
-    u64 key;  /* vruntime */
-    struct rb_node* left;
-    struct rb_node* right;
-    struct rb_node* parent;
-    bool red;
+    
+    /* Process table linkage */
+    struct process* pid_next;   /* PID hash chain, or free stack when released */
+    struct process* task_next;  /* All live tasks */
+    struct process* task_prev;
 };
 
+/* All live tasks, idle first */
+struct process* task_list = NULL;
+
+/* PID -> PCB hash and recycled PCBs */
+static struct process* pid_hash[PID_HASH_SIZE];
+static struct process* pcb_free_stack = NULL;
+
+/* Task group with hierarchical weight and quota/period bandwidth limit */
+struct task_group {
+    u32 id;
+    char name[32];
+    u64 shares;                /* Weight of the group entity in its parent */
+    struct task_group* parent;
+    struct sched_entity se;    /* Entity queued on the parent's runqueue */
+    struct cfs_rq cfs_rq;      /* Member tasks and child groups */
+    
+    /* Bandwidth control (quota 0 = unlimited) */
+    u64 quota_ns;
+    u64 period_ns;
+    u64 runtime_remaining;
+    u64 period_start;
+    bool throttled;
+    u64 throttled_at;
+    
+    /* Usage counters */
+    u64 usage_ns;
+    u64 nr_periods;
+    u64 nr_throttled;
+    u64 throttled_ns;
+    u32 nr_tasks;
+    bool in_use;
+} task_groups[MAX_TASK_GROUPS];
+
 /* Scheduler state */
 static struct {
     struct process* current_process;
     struct process* idle_process;
-    struct rb_node* cfs_runqueue;  /* Red-black tree root */
-    u64 total_weight;
-    u64 min_vruntime;
-    u32 nr_running;
+    struct task_group* root_group;  /* Owns the top-level runqueue */
+    u32 nr_running;                 /* Runnable tasks across all groups */
     u32 next_pid;
+    u32 next_group_id;
     bool scheduler_enabled;
+    volatile bool need_resched;    /* Set by wakeup/tick, consumed at preemption points */
+    struct process* dead_task;      /* Exited with nobody to wait for it, reaped once off the CPU */
+    struct wait_queue_head child_exit;  /* Parents sleeping in process_wait */
 } scheduler;
 
+/* Deadline runqueue, ordered by absolute deadline */
+static struct {
+    struct process* head;
+    struct process* throttled;      /* Waiting for budget replenishment */
+    u32 nr_running;
+    u64 total_bw;                   /* Admitted bandwidth, DL_BW_SHIFT fixed point */
+    u64 total_misses;
+} dl_rq;
+
+/* FIFO runqueue: per-priority lists plus a bitmap of non-empty levels */
+static struct {
+    u64 bitmap[RT_BITMAP_WORDS];
+    struct process* head[RT_PRIO_LEVELS];
+    struct process* tail[RT_PRIO_LEVELS];
+    u32 nr_running;
+} rt_rq;
+
 /* Timer for preemption */
 static u64 scheduler_timer = 0;
 
+/* CPU topology: only the boot CPU is brought up; isolcpus= may be parsed before scheduler_init */
+static u64 cpu_online_mask = 1;
+static u64 cpu_isolated_mask = 0;
+
+/* Wake-to-run delay across all tasks */
+static struct sched_latency_stats global_latency;
+
+/* Kernel address space and file table used by idle and kernel threads */
+static struct mm_struct kernel_mm;
+static struct files_struct kernel_files;
+static struct sighand_struct kernel_sighand;
+static u64 kernel_cr3;                  /* Boot page tables, kernel_mm's root */
+
+/* Idle task lives outside the dynamic PCB pool */
+static struct process idle_task;
+
+static inline u32 pid_hashfn(u32 pid) {
+    return pid & (PID_HASH_SIZE - 1);
+}
+
+/* Make a task visible to PID lookups and task list walks */
+static void publish_task(struct process* proc) {
+    u32 bucket = pid_hashfn(proc->pid);
+    proc->pid_next = pid_hash[bucket];
+    pid_hash[bucket] = proc;
+    
+    proc->task_prev = NULL;
+    proc->task_next = task_list;
+    if (task_list) {
+        task_list->task_prev = proc;
+    }
+    task_list = proc;
+    
+    proc->in_use = true;
+}
+
+static void unpublish_task(struct process* proc) {
+    struct process** link = &pid_hash[pid_hashfn(proc->pid)];
+    while (*link && *link != proc) {
+        link = &(*link)->pid_next;
+    }
+    if (*link) {
+        *link = proc->pid_next;
+    }
+    
+    if (proc->task_prev) {
+        proc->task_prev->task_next = proc->task_next;
+    } else {
+        task_list = proc->task_next;
+    }
+    if (proc->task_next) {
+        proc->task_next->task_prev = proc->task_prev;
+    }
+    
+    proc->in_use = false;
+}
+
+/* Next unused PID, wrapping at PID_MAX; 0 when the PID space is exhausted */
+static u32 alloc_pid(void) {
+    for (u32 tries = 0; tries < PID_MAX; tries++) {
+        u32 pid = scheduler.next_pid++;
+        if (scheduler.next_pid >= PID_MAX) {
+            scheduler.next_pid = 1;
+        }
+        if (!get_process_by_pid(pid)) {
+            return pid;
+        }
+    }
+    return 0;
+}
+
+/* Get a zeroed PCB: reuse a released one, otherwise grow the pool */
+static struct process* alloc_process_slot(void) {
+    struct process* proc = pcb_free_stack;
+    if (proc) {
+        pcb_free_stack = proc->pid_next;
+    } else {
+        proc = (struct process*)kmalloc(sizeof(struct process));
+        if (!proc) {
+            return NULL;
+        }
+    }
+    
+    memset(proc, 0, sizeof(struct process));
+    return proc;
+}
+
+/* Return an unpublished PCB to the free stack */
+static void free_process_slot(struct process* proc) {
+    proc->pid_next = pcb_free_stack;
+    pcb_free_stack = proc;
+}
+
+static inline struct process* task_of(struct sched_entity* se) {
+    return (struct process*)((char*)se - __builtin_offsetof(struct process, se));
+}
+
+static void init_cfs_rq(struct cfs_rq* cfs_rq, struct task_group* tg) {
+    cfs_rq->root = NULL;
+    cfs_rq->curr = NULL;
+    cfs_rq->tg = tg;
+    cfs_rq->total_weight = 0;
+    cfs_rq->min_vruntime = 0;
+    cfs_rq->nr_running = 0;
+}
+
+/* Point an entity at the runqueue of the given group */
+static void set_entity_group(struct sched_entity* se, struct task_group* tg) {
+    se->cfs_rq = &tg->cfs_rq;
+    se->parent = (tg == scheduler.root_group) ? NULL : &tg->se;
+    se->depth = se->parent ? se->parent->depth + 1 : 0;
+}
+
 /* Initialize scheduler */
 void scheduler_init(void) {
     /* Clear process table */
-    for (u32 i = 0; i < MAX_PROCESSES; i++) {
-        processes[i].in_use = false;
-        processes[i].pid = 0;
+    for (u32 i = 0; i < PID_HASH_SIZE; i++) {
+        pid_hash[i] = NULL;
     }
+    task_list = NULL;
+    pcb_free_stack = NULL;
+    scheduler.dead_task = NULL;
+    wait_queue_init(&scheduler.child_exit);
+    memset(&dl_rq, 0, sizeof(dl_rq));
+    
+    /* Clear task groups; slot 0 is the root group */
+    for (u32 i = 0; i < MAX_TASK_GROUPS; i++) {
+        task_groups[i].in_use = false;
+    }
+    
+    struct task_group* root = &task_groups[0];
+    memset(root, 0, sizeof(struct task_group));
+    strcpy(root->name, "root");
+    root->shares = NICE_0_WEIGHT;
+    root->period_ns = CFS_BANDWIDTH_PERIOD_NS;
+    root->in_use = true;
+    init_cfs_rq(&root->cfs_rq, root);
     
     scheduler.current_process = NULL;
     scheduler.idle_process = NULL;
-    scheduler.cfs_runqueue = NULL;
-    scheduler.total_weight = 0;
-    scheduler.min_vruntime = 0;
+    scheduler.root_group = root;
     scheduler.nr_running = 0;
     scheduler.next_pid = 1;
+    scheduler.next_group_id = 1;
     scheduler.scheduler_enabled = false;
+    scheduler.need_resched = false;
     
     /* Create idle process */
     create_idle_process();
@@ -132,17 +413,35 @@ void scheduler_init(void) {
 
 /* Create idle process */
 static void create_idle_process(void) {
-    struct process* idle = &processes[0];
+    struct process* idle = &idle_task;
     
+    memset(idle, 0, sizeof(struct process));
     idle->pid = 0;
     idle->ppid = 0;
     strcpy(idle->name, "idle");
     idle->state = PROCESS_READY;
     idle->priority = PRIORITY_IDLE;
-    idle->vruntime = 0;
+    idle->tgid = 0;
+    memset(&idle->se, 0, sizeof(struct sched_entity));
     idle->nice_value = 19;  /* Lowest priority */
-    idle->weight = 15;      /* Minimum weight */
-    idle->in_use = true;
+    idle->se.weight = 15;   /* Minimum weight */
+    idle->group = scheduler.root_group;
+    idle->cpus_allowed = sched_housekeeping_mask();
+    
+    /* Idle runs on the boot page tables */
+    __asm__ volatile ("mov %%cr3, %0" : "=r"(kernel_cr3));
+    idle->context.cr3 = kernel_cr3;
+    memset(&kernel_mm, 0, sizeof(struct mm_struct));
+    memset(&kernel_files, 0, sizeof(struct files_struct));
+    memset(&kernel_sighand, 0, sizeof(struct sighand_struct));
+    kernel_mm.users = 1;
+    kernel_files.users = 1;
+    kernel_sighand.users = 1;
+    idle->mm = &kernel_mm;
+    idle->files = &kernel_files;
+    idle->sighand = &kernel_sighand;
+    
+    publish_task(idle);
     
     scheduler.idle_process = idle;
 }
@@ -167,215 +466,2118 @@ static u64 calculate_weight(i32 nice) {
     return nice_to_weight[nice + 20];
 }
 
-/* Create new process */
-u32 process_create(const char* name, void* entry_point, process_priority_t priority) {
-    /* Find free process slot */
-    struct process* proc = NULL;
-    for (u32 i = 1; i < MAX_PROCESSES; i++) {
-        if (!processes[i].in_use) {
-            proc = &processes[i];
-            break;
+/* Page table root for an address space; kernel threads stay on the boot tables */
+static u64 mm_cr3(struct mm_struct* mm) {
+    if (mm && mm->page_directory) {
+        return vmm_page_directory_phys(mm->page_directory);
+    }
+    return kernel_cr3;
+}
+
+static struct mm_struct* mm_alloc(void) {
+    struct mm_struct* mm = (struct mm_struct*)kmalloc(sizeof(struct mm_struct));
+    if (!mm) {
+        return NULL;
+    }
+    
+    memset(mm, 0, sizeof(struct mm_struct));
+    mm->page_directory = vmm_create_page_directory();
+    if (!mm->page_directory) {
+        kfree(mm);
+        return NULL;
+    }
+    mm->virtual_memory_base = 0x400000;  /* 4MB base */
+    mm->virtual_memory_size = 0x100000;  /* 1MB size */
+    mm->heap_base = mm->virtual_memory_base + 0x10000;  /* 64KB offset */
+    mm->heap_size = 0;
+    mm->users = 1;
+    
+    return mm;
+}
+
+static void mm_put(struct mm_struct* mm) {
+    if (mm && mm != &kernel_mm && --mm->users == 0) {
+        vmm_destroy_page_directory(mm->page_directory);
+        vma_free_list(mm->vma_list);
+        kfree(mm);
+    }
+}
+
+static struct files_struct* files_alloc(struct files_struct* copy_from) {
+    struct files_struct* files = (struct files_struct*)kmalloc(sizeof(struct files_struct));
+    if (!files) {
+        return NULL;
+    }
+    
+    for (u32 i = 0; i < MAX_FD_PER_PROCESS; i++) {
+        files->fd_table[i] = copy_from ? copy_from->fd_table[i] : NULL;
+        if (files->fd_table[i]) {
+            pipe_end_get(files->fd_table[i], i);
         }
     }
+    files->users = 1;
     
-    if (!proc) {
-        return 0;  /* No free slots */
+    return files;
+}
+
+static void files_put(struct files_struct* files) {
+    if (files && files != &kernel_files && --files->users == 0) {
+        /* Pipe ends are counted; the last writer gone is the reader's EOF */
+        for (u32 i = 0; i < MAX_FD_PER_PROCESS; i++) {
+            if (files->fd_table[i]) {
+                pipe_end_put(files->fd_table[i], i);
+            }
+        }
+        kfree(files);
+    }
+}
+
+static struct sighand_struct* sighand_alloc(struct sighand_struct* copy_from) {
+    struct sighand_struct* sighand = (struct sighand_struct*)kmalloc(sizeof(struct sighand_struct));
+    if (!sighand) {
+        return NULL;
     }
     
-    /* Initialize process */
-    proc->pid = scheduler.next_pid++;
-    proc->ppid = scheduler.current_process ? scheduler.current_process->pid : 0;
-    strcpy(proc->name, name);
+    if (copy_from) {
+        memcpy(sighand->action, copy_from->action, sizeof(sighand->action));
+    } else {
+        memset(sighand->action, 0, sizeof(sighand->action));
+    }
+    sighand->users = 1;
+    
+    return sighand;
+}
+
+static void sighand_put(struct sighand_struct* sighand) {
+    if (sighand && sighand != &kernel_sighand && --sighand->users == 0) {
+        kfree(sighand);
+    }
+}
+
+/* Drop a dead thread's references to the shared files and handlers. The
+ * address space goes in process_reap, once the thread is off its tables. */
+static void process_release(struct process* proc) {
+    files_put(proc->files);
+    proc->files = NULL;
+    sighand_put(proc->sighand);
+    proc->sighand = NULL;
+    fpu_release(&proc->fpu);
+}
+
+/* Common scheduler and bookkeeping setup for a new thread */
+static void init_task(struct process* proc, const char* name, process_priority_t priority) {
+    /* Children inherit the creator's group */
+    struct task_group* tg = scheduler.root_group;
+    if (scheduler.current_process && scheduler.current_process->group) {
+        tg = scheduler.current_process->group;
+    }
+    
+    strlcpy(proc->name, name, sizeof(proc->name));
     proc->state = PROCESS_READY;
     proc->priority = priority;
-    proc->nice_value = (priority == PRIORITY_HIGH) ? -5 : 
+    proc->nice_value = (priority == PRIORITY_HIGH) ? -5 :
                       (priority == PRIORITY_LOW) ? 5 : 0;
-    proc->weight = calculate_weight(proc->nice_value);
-    
-    /* Allocate virtual memory */
-    proc->virtual_memory_base = 0x400000;  /* 4MB base */
-    proc->virtual_memory_size = 0x100000;  /* 1MB size */
-    proc->stack_base = proc->virtual_memory_base + proc->virtual_memory_size - PROCESS_STACK_SIZE;
-    proc->heap_base = proc->virtual_memory_base + 0x10000;  /* 64KB offset */
-    proc->heap_size = 0;
-    
-    /* Initialize CPU context */
-    memset(&proc->context, 0, sizeof(struct cpu_context));
-    proc->context.rip = (u64)entry_point;
-    proc->context.rsp = proc->stack_base + PROCESS_STACK_SIZE - 8;
-    proc->context.rflags = 0x202;  /* Enable interrupts */
+    proc->kernel_stack = NULL;
+    memset(&proc->fpu, 0, sizeof(struct fpu_context));
+    proc->sigpending = 0;
+    proc->sigblocked = 0;
+    proc->policy = SCHED_NORMAL;
+    memset(&proc->dl, 0, sizeof(struct sched_dl_entity));
     
     /* CFS initialization */
-    proc->vruntime = scheduler.min_vruntime;
-    proc->exec_start = 0;
-    proc->sum_exec_runtime = 0;
+    memset(&proc->se, 0, sizeof(struct sched_entity));
+    proc->se.weight = calculate_weight(proc->nice_value);
+    proc->group = tg;
+    set_entity_group(&proc->se, tg);
+    proc->se.vruntime = tg->cfs_rq.min_vruntime;
+    tg->nr_tasks++;
     
     /* Time accounting */
-    proc->creation_time = get_system_time();
+    proc->creation_time = clock_monotonic_ns();
     proc->last_scheduled = 0;
     proc->total_cpu_time = 0;
+    proc->wake_time = proc->creation_time;  /* First run counts as a wakeup */
+    memset(&proc->latency, 0, sizeof(struct sched_latency_stats));
     
     /* Process tree */
     proc->parent = scheduler.current_process;
     proc->child_count = 0;
     
-    /* File descriptors */
-    for (u32 i = 0; i < MAX_FD_PER_PROCESS; i++) {
-        proc->fd_table[i] = NULL;
-    }
-    
-    proc->in_use = true;
-    
-    /* Add to runqueue */
-    cfs_enqueue_task(proc);
-    
-    return proc->pid;
+    /* New processes stay off isolated CPUs unless moved there explicitly */
+    proc->cpus_allowed = sched_housekeeping_mask();
 }
 
-/* CFS Red-Black Tree operations */
-static void cfs_enqueue_task(struct process* proc) {
-    if (proc->state != PROCESS_READY) {
-        proc->state = PROCESS_READY;
+/* Create new process */
+u32 process_create(const char* name, void* entry_point, process_priority_t priority) {
+    struct process* proc = alloc_process_slot();
+    if (!proc) {
+        return 0;  /* No free slots */
     }
     
-    /* Insert into red-black tree based on vruntime */
-    rb_insert(&scheduler.cfs_runqueue, proc, proc->vruntime);
+    /* Allocate virtual memory and file table */
+    struct mm_struct* mm = mm_alloc();
+    struct files_struct* files = files_alloc(NULL);
+    struct sighand_struct* sighand = sighand_alloc(NULL);
+    u32 pid = alloc_pid();
+    if (!mm || !files || !sighand || !pid) {
+        mm_put(mm);
+        kfree(files);
+        kfree(sighand);
+        free_process_slot(proc);
+        return 0;
+    }
     
-    scheduler.total_weight += proc->weight;
-    scheduler.nr_running++;
-}
-
-static void cfs_dequeue_task(struct process* proc) {
-    rb_remove(&scheduler.cfs_runqueue, proc->vruntime);
+    /* Initialize process */
+    proc->pid = pid;
+    proc->tgid = proc->pid;
+    proc->ppid = scheduler.current_process ? scheduler.current_process->tgid : 0;
+    proc->mm = mm;
+    proc->files = files;
+    proc->sighand = sighand;
+    init_task(proc, name, priority);
     
-    scheduler.total_weight -= proc->weight;
-    scheduler.nr_running--;
-}
-
-/* Calculate time slice for process */
-static u64 calculate_time_slice(struct process* proc) {
-    if (scheduler.nr_running == 0) {
-        return CFS_PERIOD_NS;
-    }
+    proc->stack_base = mm->virtual_memory_base + mm->virtual_memory_size - PROCESS_STACK_SIZE;
+    
+    /* Initialize CPU context */
+    memset(&proc->context, 0, sizeof(struct cpu_context));
+    proc->context.rip = (u64)entry_point;
+    proc->context.rsp = proc->stack_base + PROCESS_STACK_SIZE - 8;
+    proc->context.rflags = 0x202;  /* Enable interrupts */
+    proc->context.cr3 = mm_cr3(mm);
     
-    u64 slice = (CFS_PERIOD_NS * proc->weight) / scheduler.total_weight;
+    u64 irq_flags = irq_save();
+    publish_task(proc);
     
-    /* Ensure minimum granularity */
-    if (slice < CFS_MIN_GRANULARITY_NS) {
-        slice = CFS_MIN_GRANULARITY_NS;
-    }
+    /* Add to runqueue */
+    cfs_enqueue_task(proc);
+    irq_restore(irq_flags);
     
-    return slice;
+    return proc->pid;
 }
 
-/* Update process virtual runtime */
-static void update_vruntime(struct process* proc, u64 delta_exec) {
-    /* vruntime = runtime / weight */
-    proc->vruntime += (delta_exec * 1024) / proc->weight;
-    proc->sum_exec_runtime += delta_exec;
+/* Create a thread of parent running entry(arg) on stack_top (NULL = allocate one) */
+i32 process_clone(struct process* parent, u64 flags, void* entry_point, void* stack_top, void* arg) {
+    if (!parent || !entry_point) {
+        return -1;
+    }
     
-    /* Update minimum vruntime */
-    if (proc->vruntime < scheduler.min_vruntime) {
-        scheduler.min_vruntime = proc->vruntime;
+    /* Threads must share the address space and the signal handlers with it */
+    if ((flags & CLONE_THREAD) && !(flags & CLONE_VM)) {
+        return -1;
     }
-}
-
-/* Pick next task to run (leftmost in RB tree) */
-static struct process* cfs_pick_next_task(void) {
-    if (!scheduler.cfs_runqueue) {
-        return scheduler.idle_process;
+    if (flags & CLONE_THREAD) {
+        flags |= CLONE_SIGHAND;
     }
     
-    /* Find leftmost node (minimum vruntime) */
-    struct rb_node* leftmost = rb_leftmost(scheduler.cfs_runqueue);
-    if (leftmost) {
-        return leftmost->process;
+    u32 pid = alloc_pid();
+    if (!pid) {
+        return -1;
     }
     
-    return scheduler.idle_process;
-}
-
-/* Main scheduler function */
-void schedule(void) {
-    if (!scheduler.scheduler_enabled) {
-        return;
+    struct process* proc = alloc_process_slot();
+    if (!proc) {
+        return -1;
     }
     
-    struct process* prev = scheduler.current_process;
-    struct process* next = cfs_pick_next_task();
-    
-    if (!next) {
-        next = scheduler.idle_process;
+    /* Address space: share for threads, otherwise a fresh one */
+    struct mm_struct* mm;
+    if (flags & CLONE_VM) {
+        mm = parent->mm;
+        mm->users++;
+    } else {
+        mm = mm_alloc();
+        if (!mm) {
+            free_process_slot(proc);
+            return -1;
+        }
     }
     
-    if (prev == next) {
-        return;  /* No context switch needed */
+    /* File descriptors: share the table or take a private copy */
+    struct files_struct* files;
+    if (flags & CLONE_FILES) {
+        files = parent->files;
+        files->users++;
+    } else {
+        files = files_alloc(parent->files);
+        if (!files) {
+            mm_put(mm);
+            free_process_slot(proc);
+            return -1;
+        }
     }
     
-    /* Update previous process statistics */
-    if (prev && prev->state == PROCESS_RUNNING) {
-        u64 now = get_system_time();
-        u64 delta_exec = now - prev->exec_start;
-        
-        update_vruntime(prev, delta_exec);
-        prev->total_cpu_time += delta_exec;
-        prev->state = PROCESS_READY;
-        
-        /* Re-enqueue if still runnable */
-        if (prev->state == PROCESS_READY) {
-            cfs_enqueue_task(prev);
+    /* Signal dispositions: share them or take a private copy */
+    struct sighand_struct* sighand;
+    if (flags & CLONE_SIGHAND) {
+        sighand = parent->sighand;
+        sighand->users++;
+    } else {
+        sighand = sighand_alloc(parent->sighand);
+        if (!sighand) {
+            mm_put(mm);
+            files_put(files);
+            free_process_slot(proc);
+            return -1;
         }
     }
     
-    /* Dequeue next process */
-    if (next != scheduler.idle_process) {
-        cfs_dequeue_task(next);
+    void* kernel_stack = NULL;
+    if (!stack_top) {
+        kernel_stack = kmalloc(PROCESS_STACK_SIZE);
+        if (!kernel_stack) {
+            mm_put(mm);
+            files_put(files);
+            sighand_put(sighand);
+            free_process_slot(proc);
+            return -1;
+        }
+        stack_top = (char*)kernel_stack + PROCESS_STACK_SIZE;
     }
     
-    /* Update next process */
-    next->state = PROCESS_RUNNING;
-    next->exec_start = get_system_time();
-    next->last_scheduled = next->exec_start;
+    proc->pid = pid;
+    proc->tgid = (flags & CLONE_THREAD) ? parent->tgid : proc->pid;
+    proc->ppid = (flags & CLONE_THREAD) ? parent->ppid : parent->tgid;
+    proc->mm = mm;
+    proc->files = files;
+    proc->sighand = sighand;
+    init_task(proc, parent->name, parent->priority);
+    proc->cpus_allowed = parent->cpus_allowed;
+    proc->sigblocked = parent->sigblocked;
+    proc->kernel_stack = kernel_stack;
+    proc->stack_base = (u64)stack_top - PROCESS_STACK_SIZE;
     
-    scheduler.current_process = next;
+    /* Start at entry with arg in RDI; a shared mm means a shared CR3 */
+    memset(&proc->context, 0, sizeof(struct cpu_context));
+    proc->context.rip = (u64)entry_point;
+    proc->context.rdi = (u64)arg;
+    proc->context.rsp = ((u64)stack_top & ~0xFULL) - 8;
+    proc->context.rflags = 0x202;  /* Enable interrupts */
+    proc->context.cr3 = mm_cr3(mm);
     
-    /* Perform context switch */
-    if (prev && prev != next) {
-        context_switch(prev, next);
+    u64 irq_flags = irq_save();
+    publish_task(proc);
+    
+    /* Add to runqueue */
+    cfs_enqueue_task(proc);
+    irq_restore(irq_flags);
+    
+    return proc->pid;
+}
+
+/* Create a kernel thread sharing the kernel address space */
+i32 kthread_create(const char* name, void (*fn)(void*), void* arg) {
+    i32 tid = process_clone(scheduler.idle_process, CLONE_VM | CLONE_FILES, (void*)fn, NULL, arg);
+    if (tid > 0) {
+        struct process* proc = get_process_by_pid(tid);
+        strlcpy(proc->name, name, sizeof(proc->name));
+        proc->ppid = 0;
     }
+    return tid;
 }
 
-/* Timer interrupt handler for preemption */
-void scheduler_timer_interrupt(void) {
-    scheduler_timer++;
+/* CFS Red-Black Tree operations */
+
+/* Nodes live in their entity; equal keys go right, so ties keep FIFO order */
+static void rb_rotate_left(struct rb_node** root, struct rb_node* node) {
+    struct rb_node* right = node->right;
     
-    if (scheduler_timer % TIME_SLICE_MS == 0) {
-        /* Time slice expired, trigger reschedule */
-        schedule();
+    node->right = right->left;
+    if (right->left) {
+        right->left->parent = node;
+    }
+    right->parent = node->parent;
+    if (!node->parent) {
+        *root = right;
+    } else if (node == node->parent->left) {
+        node->parent->left = right;
+    } else {
+        node->parent->right = right;
     }
+    right->left = node;
+    node->parent = right;
 }
 
-/* Process termination */
-void process_exit(u32 exit_code) {
-    struct process* proc = scheduler.current_process;
-    if (!proc || proc == scheduler.idle_process) {
-        return;
-    }
+static void rb_rotate_right(struct rb_node** root, struct rb_node* node) {
+    struct rb_node* left = node->left;
     
-    proc->state = PROCESS_ZOMBIE;
-    proc->exit_code = exit_code;
-    
-    /* Remove from runqueue */
-    cfs_dequeue_task(proc);
-    
-    /* Notify parent */
-    if (proc->parent) {
-        /* Send SIGCHLD signal to parent */
-        signal_send(proc->parent->pid, SIGCHLD);
+    node->left = left->right;
+    if (left->right) {
+        left->right->parent = node;
+    }
+    left->parent = node->parent;
+    if (!node->parent) {
+        *root = left;
+    } else if (node == node->parent->right) {
+        node->parent->right = left;
+    } else {
+        node->parent->left = left;
+    }
+    left->right = node;
+    node->parent = left;
+}
+
+static inline bool rb_is_red(struct rb_node* node) {
+    return node && node->red;
+}
+
+static void rb_insert(struct rb_node** root, struct sched_entity* se) {
+    struct rb_node* node = &se->run_node;
+    struct rb_node* parent = NULL;
+    struct rb_node** link = root;
+    
+    while (*link) {
+        parent = *link;
+        link = (se->vruntime < parent->key) ? &parent->left : &parent->right;
+    }
+    
+    node->se = se;
+    node->key = se->vruntime;
+    node->left = NULL;
+    node->right = NULL;
+    node->parent = parent;
+    node->red = true;
+    *link = node;
+    
+    /* A red parent is never the root, so the grandparent exists */
+    while ((parent = node->parent) && parent->red) {
+        struct rb_node* gparent = parent->parent;
+    
+        if (parent == gparent->left) {
+            struct rb_node* uncle = gparent->right;
+            if (rb_is_red(uncle)) {
+                parent->red = false;
+                uncle->red = false;
+                gparent->red = true;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->right) {
+                rb_rotate_left(root, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = false;
+            gparent->red = true;
+            rb_rotate_right(root, gparent);
+        } else {
+            struct rb_node* uncle = gparent->left;
+            if (rb_is_red(uncle)) {
+                parent->red = false;
+                uncle->red = false;
+                gparent->red = true;
+                node = gparent;
+                continue;
+            }
+            if (node == parent->left) {
+                rb_rotate_right(root, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->red = false;
+            gparent->red = true;
+            rb_rotate_left(root, gparent);
+        }
+    }
+    (*root)->red = false;
+}
+
+/* Point whatever linked to old (its parent, or the root) at new */
+static void rb_replace_child(struct rb_node** root, struct rb_node* old, struct rb_node* new) {
+    if (!old->parent) {
+        *root = new;
+    } else if (old == old->parent->left) {
+        old->parent->left = new;
+    } else {
+        old->parent->right = new;
+    }
+}
+
+/* Restore the black height after a black node left from above node,
+ * which may be NULL; parent is where it hangs */
+static void rb_erase_fixup(struct rb_node** root, struct rb_node* node, struct rb_node* parent) {
+    while (node != *root && !rb_is_red(node)) {
+        if (node == parent->left) {
+            struct rb_node* sibling = parent->right;
+            if (sibling->red) {
+                sibling->red = false;
+                parent->red = true;
+                rb_rotate_left(root, parent);
+                sibling = parent->right;
+            }
+            if (!rb_is_red(sibling->left) && !rb_is_red(sibling->right)) {
+                sibling->red = true;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (!rb_is_red(sibling->right)) {
+                sibling->left->red = false;
+                sibling->red = true;
+                rb_rotate_right(root, sibling);
+                sibling = parent->right;
+            }
+            sibling->red = parent->red;
+            parent->red = false;
+            sibling->right->red = false;
+            rb_rotate_left(root, parent);
+        } else {
+            struct rb_node* sibling = parent->left;
+            if (sibling->red) {
+                sibling->red = false;
+                parent->red = true;
+                rb_rotate_right(root, parent);
+                sibling = parent->left;
+            }
+            if (!rb_is_red(sibling->left) && !rb_is_red(sibling->right)) {
+                sibling->red = true;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (!rb_is_red(sibling->left)) {
+                sibling->right->red = false;
+                sibling->red = true;
+                rb_rotate_left(root, sibling);
+                sibling = parent->left;
+            }
+            sibling->red = parent->red;
+            parent->red = false;
+            sibling->left->red = false;
+            rb_rotate_right(root, parent);
+        }
+        node = *root;
+    }
+    
+    if (node) {
+        node->red = false;
+    }
+}
+
+/* Unlink this very node; entities sharing its vruntime stay put */
+static void rb_remove(struct rb_node** root, struct rb_node* node) {
+    struct rb_node* child;
+    struct rb_node* parent;
+    bool red;
+    
+    if (node->left && node->right) {
+        /* The in-order successor takes node's place and colour */
+        struct rb_node* succ = node->right;
+        while (succ->left) {
+            succ = succ->left;
+        }
+    
+        child = succ->right;
+        parent = succ->parent;
+        red = succ->red;
+    
+        if (parent == node) {
+            parent = succ;
+        } else {
+            if (child) {
+                child->parent = parent;
+            }
+            parent->left = child;
+            succ->right = node->right;
+            node->right->parent = succ;
+        }
+    
+        succ->left = node->left;
+        node->left->parent = succ;
+        succ->red = node->red;
+        rb_replace_child(root, node, succ);
+        succ->parent = node->parent;
+    } else {
+        child = node->left ? node->left : node->right;
+        parent = node->parent;
+        red = node->red;
+    
+        if (child) {
+            child->parent = parent;
+        }
+        rb_replace_child(root, node, child);
+    }
+    
+    node->left = NULL;
+    node->right = NULL;
+    node->parent = NULL;
+    
+    if (!red) {
+        rb_erase_fixup(root, child, parent);
+    }
+}
+
+static struct rb_node* rb_leftmost(struct rb_node* root) {
+    if (!root) {
+        return NULL;
+    }
+    while (root->left) {
+        root = root->left;
+    }
+    return root;
+}
+
+/* Insert into red-black tree based on vruntime; curr stays out of the tree */
+static void __enqueue_entity(struct cfs_rq* cfs_rq, struct sched_entity* se) {
+    rb_insert(&cfs_rq->root, se);
+}
+
+static void __dequeue_entity(struct cfs_rq* cfs_rq, struct sched_entity* se) {
+    rb_remove(&cfs_rq->root, &se->run_node);
+}
+
+static void enqueue_entity(struct cfs_rq* cfs_rq, struct sched_entity* se) {
+    if (cfs_rq->curr != se) {
+        __enqueue_entity(cfs_rq, se);
+    }
+    
+    cfs_rq->total_weight += se->weight;
+    cfs_rq->nr_running++;
+    se->on_rq = true;
+}
+
+static void dequeue_entity(struct cfs_rq* cfs_rq, struct sched_entity* se) {
+    if (cfs_rq->curr != se) {
+        __dequeue_entity(cfs_rq, se);
+    }
+    
+    cfs_rq->total_weight -= se->weight;
+    cfs_rq->nr_running--;
+    se->on_rq = false;
+}
+
+/* Queue an entity and every idle ancestor up to a throttled group or the root */
+static void enqueue_entity_hierarchy(struct sched_entity* se) {
+    for (; se && !se->on_rq; se = se->parent) {
+        struct cfs_rq* cfs_rq = se->cfs_rq;
+        enqueue_entity(cfs_rq, se);
+    
+        /* A throttled group keeps its members but stays off its parent */
+        if (cfs_rq->tg->throttled) {
+            break;
+        }
+    }
+}
+
+/* Remove an entity and every ancestor left with nothing runnable */
+static void dequeue_entity_hierarchy(struct sched_entity* se) {
+    for (; se && se->on_rq; se = se->parent) {
+        struct cfs_rq* cfs_rq = se->cfs_rq;
+        dequeue_entity(cfs_rq, se);
+    
+        /* Group still has runnable members */
+        if (cfs_rq->nr_running > 0) {
+            break;
+        }
+    }
+}
+
+static void cfs_enqueue_task(struct process* proc) {
+    if (proc->state != PROCESS_READY) {
+        proc->state = PROCESS_READY;
+    }
+    
+    enqueue_entity_hierarchy(&proc->se);
+    scheduler.nr_running++;
+}
+
+static void cfs_dequeue_task(struct process* proc) {
+    dequeue_entity_hierarchy(&proc->se);
+    scheduler.nr_running--;
+}
+
+/* Entity chosen to run: take it out of the tree at every level */
+static void set_next_task(struct process* proc) {
+    for (struct sched_entity* se = &proc->se; se; se = se->parent) {
+        if (se->on_rq) {
+            __dequeue_entity(se->cfs_rq, se);
+        }
+        se->cfs_rq->curr = se;
+    }
+}
+
+/* Entity stops running: put still-queued levels back in the tree */
+static void put_prev_task(struct process* proc) {
+    for (struct sched_entity* se = &proc->se; se; se = se->parent) {
+        se->cfs_rq->curr = NULL;
+        if (se->on_rq) {
+            __enqueue_entity(se->cfs_rq, se);
+        }
+    }
+}
+
+/* Calculate time slice for process */
+static u64 calculate_time_slice(struct process* proc) {
+    if (scheduler.nr_running == 0) {
+        return CFS_PERIOD_NS;
+    }
+    
+    /* Share of the period at each level of the group hierarchy */
+    u64 slice = CFS_PERIOD_NS;
+    for (struct sched_entity* se = &proc->se; se; se = se->parent) {
+        if (se->cfs_rq->total_weight > 0) {
+            slice = (slice * se->weight) / se->cfs_rq->total_weight;
+        }
+    }
+    
+    /* Ensure minimum granularity */
+    if (slice < CFS_MIN_GRANULARITY_NS) {
+        slice = CFS_MIN_GRANULARITY_NS;
+    }
+    
+    return slice;
+}
+
+/* Advance min_vruntime towards the smallest runnable vruntime (never backwards) */
+static void update_min_vruntime(struct cfs_rq* cfs_rq) {
+    struct sched_entity* curr = cfs_rq->curr;
+    bool has_curr = curr && curr->on_rq;
+    u64 vruntime = has_curr ? curr->vruntime : cfs_rq->min_vruntime;
+    
+    if (cfs_rq->root) {
+        struct rb_node* leftmost = rb_leftmost(cfs_rq->root);
+        if (leftmost && (!has_curr || leftmost->key < vruntime)) {
+            vruntime = leftmost->key;
+        }
+    }
+    
+    if (vruntime > cfs_rq->min_vruntime) {
+        cfs_rq->min_vruntime = vruntime;
+    }
+}
+
+/* Update entity virtual runtime */
+static void update_vruntime(struct sched_entity* se, u64 delta_exec) {
+    /* vruntime = runtime / weight, delta_exec in nanoseconds */
+    se->vruntime += (delta_exec * NICE_0_WEIGHT) / se->weight;
+    se->sum_exec_runtime += delta_exec;
+    
+    update_min_vruntime(se->cfs_rq);
+}
+
+/* Throttle a group that used up its quota for this period */
+static void throttle_group(struct task_group* tg) {
+    tg->throttled = true;
+    tg->throttled_at = clock_monotonic_ns();
+    tg->nr_throttled++;
+    
+    dequeue_entity_hierarchy(&tg->se);
+    scheduler.need_resched = true;
+}
+
+static void unthrottle_group(struct task_group* tg, u64 now) {
+    tg->throttled = false;
+    tg->throttled_ns += now - tg->throttled_at;
+    
+    if (tg->cfs_rq.nr_running > 0) {
+        enqueue_entity_hierarchy(&tg->se);
+        scheduler.need_resched = true;
+    }
+}
+
+/* Charge runtime to a group and throttle once its quota is gone */
+static void account_group_runtime(struct task_group* tg, u64 delta_exec) {
+    tg->usage_ns += delta_exec;
+    
+    if (tg->quota_ns == 0 || tg->throttled) {
+        return;
+    }
+    
+    if (delta_exec >= tg->runtime_remaining) {
+        tg->runtime_remaining = 0;
+        throttle_group(tg);
+    } else {
+        tg->runtime_remaining -= delta_exec;
+    }
+}
+
+/* Charge the running process, and every group above it, for the time since exec_start */
+static void update_curr(struct process* curr) {
+    u64 now = clock_monotonic_ns();
+    u64 delta_exec = now - curr->se.exec_start;
+    
+    curr->se.exec_start = now;
+    curr->total_cpu_time += delta_exec;
+    
+    for (struct sched_entity* se = &curr->se; se; se = se->parent) {
+        update_vruntime(se, delta_exec);
+    
+        account_group_runtime(se->cfs_rq->tg, delta_exec);
+    }
+}
+
+/* Refill group quotas at period boundaries - called from the timer tick */
+static void update_group_bandwidth(void) {
+    u64 now = clock_monotonic_ns();
+    
+    for (u32 i = 1; i < MAX_TASK_GROUPS; i++) {
+        struct task_group* tg = &task_groups[i];
+        if (!tg->in_use || tg->quota_ns == 0) {
+            continue;
+        }
+    
+        if (now - tg->period_start < tg->period_ns) {
+            continue;
+        }
+    
+        /* Skip whole periods that passed without a tick */
+        u64 elapsed = (now - tg->period_start) / tg->period_ns;
+        tg->period_start += elapsed * tg->period_ns;
+        tg->nr_periods += elapsed;
+        tg->runtime_remaining = tg->quota_ns;
+    
+        if (tg->throttled) {
+            unthrottle_group(tg, now);
+        }
+    }
+}
+
+/* Clamp a waking sleeper so it gets a bounded head start, not a banked one */
+static void place_sleeper(struct sched_entity* se) {
+    u64 min_vruntime = se->cfs_rq->min_vruntime;
+    u64 floor = 0;
+    
+    if (min_vruntime > CFS_SLEEPER_BONUS_NS) {
+        floor = min_vruntime - CFS_SLEEPER_BONUS_NS;
+    }
+    
+    if (se->vruntime < floor) {
+        se->vruntime = floor;
+    }
+}
+
+/* Walk two entities up to the level where they share a runqueue */
+static void find_matching_se(struct sched_entity** se, struct sched_entity** pse) {
+    while ((*se)->depth > (*pse)->depth) {
+        *se = (*se)->parent;
+    }
+    while ((*pse)->depth > (*se)->depth) {
+        *pse = (*pse)->parent;
+    }
+    while ((*se)->cfs_rq != (*pse)->cfs_rq) {
+        *se = (*se)->parent;
+        *pse = (*pse)->parent;
+    }
+}
+
+/* Request a reschedule if the woken process should run before current */
+static void check_preempt_wakeup(struct process* proc) {
+    struct process* curr = scheduler.current_process;
+    
+    if (!curr || curr == scheduler.idle_process) {
+        scheduler.need_resched = true;
+        return;
+    }
+    
+    /* CFS never preempts the deadline or FIFO classes */
+    if (curr->policy != SCHED_NORMAL) {
+        return;
+    }
+    
+    /* Bring current's vruntime up to date before comparing */
+    update_curr(curr);
+    
+    /* Compare at the level where both sit on the same runqueue */
+    struct sched_entity* se = &curr->se;
+    struct sched_entity* pse = &proc->se;
+    find_matching_se(&se, &pse);
+    
+    /* Granularity is in virtual time, so scale it by the wakee's weight */
+    u64 gran = (CFS_WAKEUP_GRANULARITY_NS * NICE_0_WEIGHT) / pse->weight;
+    
+    if (se->vruntime > pse->vruntime && se->vruntime - pse->vruntime > gran) {
+        scheduler.need_resched = true;
+    }
+}
+
+/* DEADLINE CLASS (EDF + CBS) - always runs before CFS */
+
+static inline u64 dl_to_ratio(u64 period, u64 runtime) {
+    return (runtime << DL_BW_SHIFT) / period;
+}
+
+/* Insert keeping the runqueue ordered by absolute deadline */
+static void enqueue_dl_task(struct process* proc) {
+    struct process** link = &dl_rq.head;
+    while (*link && (*link)->dl.deadline <= proc->dl.deadline) {
+        link = &(*link)->dl.dl_next;
+    }
+    proc->dl.dl_next = *link;
+    *link = proc;
+    
+    proc->dl.on_dl_rq = true;
+    if (proc->state != PROCESS_RUNNING) {
+        proc->state = PROCESS_READY;
+    }
+    dl_rq.nr_running++;
+    scheduler.nr_running++;
+}
+
+static void dl_list_remove(struct process** head, struct process* proc) {
+    for (struct process** link = head; *link; link = &(*link)->dl.dl_next) {
+        if (*link == proc) {
+            *link = proc->dl.dl_next;
+            proc->dl.dl_next = NULL;
+            return;
+        }
+    }
+}
+
+static void dequeue_dl_task(struct process* proc) {
+    dl_list_remove(&dl_rq.head, proc);
+    proc->dl.on_dl_rq = false;
+    dl_rq.nr_running--;
+    scheduler.nr_running--;
+}
+
+/* Start a fresh instance: full budget, deadline relative to now */
+static void setup_new_dl_entity(struct sched_dl_entity* dl, u64 now) {
+    dl->deadline = now + dl->dl_deadline;
+    dl->runtime = dl->dl_runtime;
+}
+
+/* CBS replenishment: postpone the deadline by a period per budget refill */
+static void replenish_dl_entity(struct sched_dl_entity* dl, u64 now) {
+    while (dl->runtime <= 0) {
+        dl->deadline += dl->dl_period;
+        dl->runtime += dl->dl_runtime;
+    }
+    
+    /* Too far behind to catch up; restart from now rather than burst */
+    if (dl->deadline < now) {
+        setup_new_dl_entity(dl, now);
+    }
+}
+
+/* CBS wakeup rule: keep the old deadline only if the leftover budget
+ * cannot exceed the reserved bandwidth before it */
+static void update_dl_entity_on_wakeup(struct sched_dl_entity* dl, u64 now) {
+    if (dl->deadline <= now || dl->runtime <= 0) {
+        setup_new_dl_entity(dl, now);
+        return;
+    }
+    
+    unsigned __int128 left = (unsigned __int128)dl->runtime * dl->dl_deadline;
+    unsigned __int128 right = (unsigned __int128)(dl->deadline - now) * dl->dl_runtime;
+    if (left > right) {
+        setup_new_dl_entity(dl, now);
+    }
+}
+
+/* Take a task off the CPU until its next period. A zombie is never queued
+ * here: the throttled list would outlive its PCB. */
+static void throttle_dl_task(struct process* proc) {
+    if (proc->state == PROCESS_ZOMBIE) {
+        return;
+    }
+    if (proc->dl.on_dl_rq) {
+        dequeue_dl_task(proc);
+    }
+    proc->dl.throttled = true;
+    proc->dl.dl_next = dl_rq.throttled;
+    dl_rq.throttled = proc;
+    scheduler.need_resched = true;
+}
+
+static void record_dl_miss(struct process* proc) {
+    proc->dl.deadline_misses++;
+    dl_rq.total_misses++;
+}
+
+/* Charge the running deadline task and throttle it once its budget is spent */
+static void update_curr_dl(struct process* curr) {
+    u64 now = clock_monotonic_ns();
+    u64 delta_exec = now - curr->se.exec_start;
+    
+    curr->se.exec_start = now;
+    curr->se.sum_exec_runtime += delta_exec;
+    curr->total_cpu_time += delta_exec;
+    curr->dl.runtime -= (i64)delta_exec;
+    
+    /* A task that is blocking gets a fresh instance on wakeup instead */
+    if (curr->dl.runtime <= 0 && curr->state == PROCESS_RUNNING) {
+        throttle_dl_task(curr);
+    }
+}
+
+/* Deadline enforcement and replenishment - called from the timer tick */
+static void update_dl_bandwidth(void) {
+    u64 now = clock_monotonic_ns();
+    
+    /* Runnable instances whose deadline passed missed it */
+    struct process* proc = dl_rq.head;
+    while (proc) {
+        struct process* next = proc->dl.dl_next;
+        if (now >= proc->dl.deadline) {
+            record_dl_miss(proc);
+            dequeue_dl_task(proc);
+            proc->dl.runtime = 0;
+            replenish_dl_entity(&proc->dl, now);
+            enqueue_dl_task(proc);
+            scheduler.need_resched = true;
+        }
+        proc = next;
+    }
+    
+    /* Throttled instances are released at their deadline */
+    struct process** link = &dl_rq.throttled;
+    while (*link) {
+        proc = *link;
+        if (now < proc->dl.deadline) {
+            link = &proc->dl.dl_next;
+            continue;
+        }
+    
+        *link = proc->dl.dl_next;
+        proc->dl.dl_next = NULL;
+        proc->dl.throttled = false;
+    
+        /* Budget ran out with work still pending */
+        if (!proc->dl.yielded && proc->state != PROCESS_BLOCKED) {
+            record_dl_miss(proc);
+        }
+        proc->dl.yielded = false;
+        replenish_dl_entity(&proc->dl, now);
+    
+        if (proc->state != PROCESS_BLOCKED && proc->state != PROCESS_ZOMBIE) {
+            proc->wake_time = now;
+            enqueue_dl_task(proc);
+            scheduler.need_resched = true;
+        }
+    }
+}
+
+/* Wake a deadline task and preempt anything with a later deadline */
+static void dl_wake_up_process(struct process* proc) {
+    u64 now = clock_monotonic_ns();
+    
+    /* A throttled task is released by the tick, not by the wakeup */
+    proc->state = PROCESS_READY;
+    if (proc->dl.throttled) {
+        return;
+    }
+    
+    update_dl_entity_on_wakeup(&proc->dl, now);
+    enqueue_dl_task(proc);
+    proc->wake_time = now;
+    
+    struct process* curr = scheduler.current_process;
+    if (!curr || curr->policy != SCHED_DEADLINE || proc->dl.deadline < curr->dl.deadline) {
+        scheduler.need_resched = true;
+    }
+}
+
+/* FIFO REAL-TIME CLASS - below deadline, above CFS */
+
+/* Append at the tail of the task's priority level */
+static void enqueue_rt_task(struct process* proc) {
+    u32 prio = proc->rt_prio;
+    
+    proc->rt_next = NULL;
+    proc->rt_prev = rt_rq.tail[prio];
+    if (rt_rq.tail[prio]) {
+        rt_rq.tail[prio]->rt_next = proc;
+    } else {
+        rt_rq.head[prio] = proc;
+        rt_rq.bitmap[prio / 64] |= 1ULL << (prio % 64);
+    }
+    rt_rq.tail[prio] = proc;
+    
+    proc->on_rt_rq = true;
+    if (proc->state != PROCESS_RUNNING) {
+        proc->state = PROCESS_READY;
+    }
+    rt_rq.nr_running++;
+    scheduler.nr_running++;
+}
+
+static void dequeue_rt_task(struct process* proc) {
+    u32 prio = proc->rt_prio;
+    
+    if (proc->rt_prev) {
+        proc->rt_prev->rt_next = proc->rt_next;
+    } else {
+        rt_rq.head[prio] = proc->rt_next;
+    }
+    if (proc->rt_next) {
+        proc->rt_next->rt_prev = proc->rt_prev;
+    } else {
+        rt_rq.tail[prio] = proc->rt_prev;
+    }
+    if (!rt_rq.head[prio]) {
+        rt_rq.bitmap[prio / 64] &= ~(1ULL << (prio % 64));
+    }
+    
+    proc->rt_next = NULL;
+    proc->rt_prev = NULL;
+    proc->on_rt_rq = false;
+    rt_rq.nr_running--;
+    scheduler.nr_running--;
+}
+
+/* Head of the highest non-empty level; the running task stays queued */
+static struct process* pick_next_rt_task(void) {
+    for (u32 w = 0; w < RT_BITMAP_WORDS; w++) {
+        if (rt_rq.bitmap[w]) {
+            return rt_rq.head[w * 64 + __builtin_ctzll(rt_rq.bitmap[w])];
+        }
+    }
+    return NULL;
+}
+
+/* Charge the running FIFO task; it has no budget or slice to enforce */
+static void update_curr_rt(struct process* curr) {
+    u64 now = clock_monotonic_ns();
+    u64 delta_exec = now - curr->se.exec_start;
+    
+    curr->se.exec_start = now;
+    curr->se.sum_exec_runtime += delta_exec;
+    curr->total_cpu_time += delta_exec;
+}
+
+/* Wake a FIFO task; it preempts CFS and lower-priority FIFO tasks */
+static void rt_wake_up_process(struct process* proc) {
+    enqueue_rt_task(proc);
+    proc->wake_time = clock_monotonic_ns();
+    
+    struct process* curr = scheduler.current_process;
+    if (!curr || curr == scheduler.idle_process || curr->policy == SCHED_NORMAL ||
+        (curr->policy == SCHED_FIFO && proc->rt_prio < curr->rt_prio)) {
+        scheduler.need_resched = true;
+    }
+}
+
+/* Take a runnable task off its class's runqueue before a policy change */
+static void switch_out_class(struct process* proc, bool running) {
+    if (proc->policy == SCHED_DEADLINE) {
+        if (running) {
+            update_curr_dl(proc);
+        }
+        if (proc->dl.on_dl_rq) {
+            dequeue_dl_task(proc);
+        } else if (proc->dl.throttled) {
+            dl_list_remove(&dl_rq.throttled, proc);
+            proc->dl.throttled = false;
+        }
+    } else if (proc->policy == SCHED_FIFO) {
+        if (running) {
+            update_curr_rt(proc);
+        }
+        if (proc->on_rt_rq) {
+            dequeue_rt_task(proc);
+        }
+    } else {
+        if (running) {
+            update_curr(proc);
+            put_prev_task(proc);
+        }
+        if (proc->se.on_rq) {
+            cfs_dequeue_task(proc);
+        }
+    }
+}
+
+/* Queue a runnable task in its (new) class */
+static void switch_in_class(struct process* proc, bool running) {
+    if (proc->policy == SCHED_DEADLINE) {
+        enqueue_dl_task(proc);
+    } else if (proc->policy == SCHED_FIFO) {
+        enqueue_rt_task(proc);
+    } else {
+        proc->se.vruntime = proc->se.cfs_rq->min_vruntime;
+        cfs_enqueue_task(proc);
+        if (running) {
+            set_next_task(proc);
+        }
+    }
+    
+    if (running) {
+        proc->state = PROCESS_RUNNING;
+        proc->se.exec_start = clock_monotonic_ns();
+    }
+}
+
+/* Wake a blocked process: place it, enqueue it and check for preemption */
+static void __wake_up_process(struct process* proc) {
+    if (!proc || proc->state != PROCESS_BLOCKED) {
+        return;
+    }
+    
+    if (proc->policy == SCHED_DEADLINE) {
+        dl_wake_up_process(proc);
+        return;
+    }
+    if (proc->policy == SCHED_FIFO) {
+        rt_wake_up_process(proc);
+        return;
+    }
+    
+    place_sleeper(&proc->se);
+    cfs_enqueue_task(proc);
+    proc->wake_time = clock_monotonic_ns();
+    check_preempt_wakeup(proc);
+}
+
+/* Runqueues are also changed from the timer interrupt, so every update
+ * outside it runs with interrupts off */
+void cfs_wake_up_process(struct process* proc) {
+    u64 irq_flags = irq_save();
+    __wake_up_process(proc);
+    irq_restore(irq_flags);
+}
+
+/* Pick next task to run (leftmost in RB tree, descending through groups) */
+static struct process* cfs_pick_next_task(void) {
+    struct cfs_rq* cfs_rq = &scheduler.root_group->cfs_rq;
+    
+    while (cfs_rq && cfs_rq->root) {
+        /* Find leftmost node (minimum vruntime) */
+        struct rb_node* leftmost = rb_leftmost(cfs_rq->root);
+        if (!leftmost) {
+            break;
+        }
+    
+        struct sched_entity* se = leftmost->se;
+        if (!se->my_q) {
+            return task_of(se);
+        }
+        cfs_rq = se->my_q;
+    }
+    
+    return scheduler.idle_process;
+}
+
+/* SCHEDULING LATENCY */
+
+static void latency_record(struct sched_latency_stats* stats, u64 delay_ns) {
+    stats->buckets[latency_log2_bucket(delay_ns, SCHED_LAT_BUCKETS)]++;
+    stats->count++;
+    stats->total_ns += delay_ns;
+    if (delay_ns > stats->max_ns) {
+        stats->max_ns = delay_ns;
+    }
+}
+
+/* Earliest deadline first, then the highest FIFO priority, then CFS */
+struct process* sched_pick_next_task(void) {
+    struct process* next = dl_rq.head;
+    if (!next) {
+        next = pick_next_rt_task();
+    }
+    if (!next) {
+        next = cfs_pick_next_task();
+    }
+    return next ? next : scheduler.idle_process;
+}
+
+/* Main scheduler function */
+void schedule(void) {
+    if (!scheduler.scheduler_enabled) {
+        return;
+    }
+    
+    /* The switched-to task restores its own flags when it returns here */
+    u64 irq_flags = irq_save();
+    struct process* prev = scheduler.current_process;
+    scheduler.need_resched = false;
+    
+    /* The last detached task to exit has switched away for good */
+    if (scheduler.dead_task && scheduler.dead_task != prev) {
+        process_reap(scheduler.dead_task);
+        scheduler.dead_task = NULL;
+    }
+    
+    /* Charge previous process; blocked processes leave the runqueue */
+    if (prev && prev->policy == SCHED_DEADLINE) {
+        update_curr_dl(prev);
+    
+        if (prev->state == PROCESS_RUNNING) {
+            prev->state = PROCESS_READY;
+        } else if (prev->dl.on_dl_rq) {
+            dequeue_dl_task(prev);
+        }
+    } else if (prev && prev->policy == SCHED_FIFO) {
+        update_curr_rt(prev);
+    
+        /* A preempted FIFO task keeps its place at the head of its level */
+        if (prev->state == PROCESS_RUNNING) {
+            prev->state = PROCESS_READY;
+        } else if (prev->on_rt_rq) {
+            dequeue_rt_task(prev);
+        }
+    } else if (prev && prev != scheduler.idle_process) {
+        update_curr(prev);
+    
+        if (prev->state == PROCESS_RUNNING) {
+            prev->state = PROCESS_READY;
+        } else if (prev->se.on_rq) {
+            cfs_dequeue_task(prev);
+        }
+    
+        put_prev_task(prev);
+    }
+    
+    struct process* next = sched_pick_next_task();
+    
+    /* Take next out of the tree at every level */
+    if (next != scheduler.idle_process && next->policy == SCHED_NORMAL) {
+        set_next_task(next);
+    }
+    
+    /* Update next process */
+    next->state = PROCESS_RUNNING;
+    next->se.exec_start = clock_monotonic_ns();
+    next->last_scheduled = next->se.exec_start;
+    
+    /* Record how long next waited between wakeup and getting the CPU */
+    if (next->wake_time) {
+        u64 delay = next->se.exec_start - next->wake_time;
+        latency_record(&next->latency, delay);
+        latency_record(&global_latency, delay);
+        next->wake_time = 0;
+    }
+    
+    scheduler.current_process = next;
+    signal_work_pending = signal_pending(next);
+    
+    /* Perform context switch; threads of one process skip the CR3 reload */
+    if (prev && prev != next) {
+        /* FPU state stays in the registers until next actually uses it */
+        fpu_switch_to(&next->fpu);
+        context_switch(&prev->context, &next->context);
+    }
+    
+    irq_restore(irq_flags);
+}
+
+/* Timer interrupt handler for preemption */
+void scheduler_timer_interrupt(void) {
+    scheduler_timer++;
+    
+    struct process* curr = scheduler.current_process;
+    
+    /* Deadline tasks run until they block, yield or exhaust their budget */
+    if (curr && curr->policy == SCHED_DEADLINE) {
+        update_curr_dl(curr);
+        update_dl_bandwidth();
+        update_group_bandwidth();
+        return;
+    }
+    update_dl_bandwidth();
+    
+    /* FIFO tasks are not time-sliced; only a higher class or priority preempts them */
+    if (curr && curr->policy == SCHED_FIFO) {
+        update_curr_rt(curr);
+        update_group_bandwidth();
+        return;
+    }
+    
+    if (!curr || curr == scheduler.idle_process) {
+        update_group_bandwidth();
+        if (scheduler.nr_running > 0) {
+            scheduler.need_resched = true;
+        }
+        return;
+    }
+    
+    /* Charge the tick so quotas are enforced mid-slice */
+    update_curr(curr);
+    update_group_bandwidth();
+    
+    /* Time slice expired, trigger reschedule */
+    u64 ran = clock_monotonic_ns() - curr->last_scheduled;
+    if (ran >= calculate_time_slice(curr)) {
+        scheduler.need_resched = true;
+    }
+}
+
+/* Preemption point in process context. A caller still inside an irq-off
+ * section is not preemptible; the request waits for the next point. */
+void scheduler_preempt_point(void) {
+    if (scheduler.need_resched && irqs_enabled()) {
+        schedule();
+    }
+}
+
+/* Preemption on interrupt and syscall return. Only user mode, or kernel
+ * code that ran with interrupts on, is switched away from, so no irq-off
+ * section or runqueue update is cut in half. */
+void scheduler_preempt_return(const struct trap_frame* regs) {
+    if (scheduler.need_resched && ((regs->cs & 3) == 3 || (regs->rflags & RFLAGS_IF))) {
+        schedule();
+    }
+}
+
+/* Global wake-to-run histogram */
+void sched_get_latency_stats(struct sched_latency_stats* stats) {
+    memcpy(stats, &global_latency, sizeof(struct sched_latency_stats));
+}
+
+/* Histogram of one task */
+i32 sched_get_task_latency(u32 pid, struct sched_latency_stats* stats) {
+    struct process* proc = get_process_by_pid(pid);
+    if (!proc) {
+        return -1;
+    }
+    
+    memcpy(stats, &proc->latency, sizeof(struct sched_latency_stats));
+    return 0;
+}
+
+/* Clear global and per-task histograms */
+void sched_reset_latency_stats(void) {
+    memset(&global_latency, 0, sizeof(struct sched_latency_stats));
+    for (struct process* proc = task_list; proc; proc = proc->task_next) {
+        memset(&proc->latency, 0, sizeof(struct sched_latency_stats));
+    }
+}
+
+/* Latency (ns) below which per_10000/10000 of samples fall, e.g. 9990 = p99.9.
+ * Resolution is one log2 bucket; the result is the bucket's upper edge. */
+u64 sched_latency_percentile(const struct sched_latency_stats* stats, u32 per_10000) {
+    if (stats->count == 0) {
+        return 0;
+    }
+    
+    u64 target = (stats->count * per_10000 + 9999) / 10000;
+    u64 seen = 0;
+    
+    for (u32 i = 0; i < SCHED_LAT_BUCKETS; i++) {
+        seen += stats->buckets[i];
+        if (seen >= target) {
+            u64 upper = (2ULL << i) - 1;
+            return upper < stats->max_ns ? upper : stats->max_ns;
+        }
+    }
+    
+    return stats->max_ns;
+}
+
+/* Check whether a new reservation fits under DL_BW_LIMIT */
+bool sched_dl_can_admit(u64 runtime_ns, u64 period_ns) {
+    if (runtime_ns == 0 || period_ns == 0 || runtime_ns > period_ns) {
+        return false;
+    }
+    return dl_rq.total_bw + dl_to_ratio(period_ns, runtime_ns) <= DL_BW_LIMIT;
+}
+
+/* Move a task into the deadline class with a runtime/deadline/period
+ * reservation (period 0 = deadline), or back to CFS with runtime 0 */
+i32 sched_setattr_deadline(u32 pid, u64 runtime_ns, u64 deadline_ns, u64 period_ns) {
+    struct process* proc = pid ? get_process_by_pid(pid) : scheduler.current_process;
+    if (!proc || proc == scheduler.idle_process || proc->state == PROCESS_ZOMBIE) {
+        return -1;
+    }
+    
+    if (runtime_ns == 0) {
+        if (proc->policy != SCHED_DEADLINE) {
+            return 0;
+        }
+        return sched_setscheduler(proc->pid, SCHED_NORMAL, 0);
+    }
+    
+    if (period_ns == 0) {
+        period_ns = deadline_ns;
+    }
+    if (deadline_ns < runtime_ns || period_ns < deadline_ns) {
+        return -1;
+    }
+    
+    /* Admission control on total utilisation */
+    u64 irq_flags = irq_save();
+    u64 new_bw = dl_to_ratio(period_ns, runtime_ns);
+    u64 old_bw = (proc->policy == SCHED_DEADLINE) ? proc->dl.dl_bw : 0;
+    if (dl_rq.total_bw - old_bw + new_bw > DL_BW_LIMIT) {
+        irq_restore(irq_flags);
+        return -1;
+    }
+    
+    bool running = (proc == scheduler.current_process);
+    bool runnable = running || proc->state == PROCESS_READY;
+    
+    /* Leave whichever runqueue the task is on */
+    if (runnable) {
+        switch_out_class(proc, running);
+    }
+    
+    dl_rq.total_bw = dl_rq.total_bw - old_bw + new_bw;
+    proc->pi_boosted = false;
+    proc->policy = SCHED_DEADLINE;
+    proc->dl.dl_runtime = runtime_ns;
+    proc->dl.dl_deadline = deadline_ns;
+    proc->dl.dl_period = period_ns;
+    proc->dl.dl_bw = new_bw;
+    proc->dl.yielded = false;
+    setup_new_dl_entity(&proc->dl, clock_monotonic_ns());
+    
+    if (runnable) {
+        switch_in_class(proc, running);
+    }
+    
+    scheduler.need_resched = true;
+    irq_restore(irq_flags);
+    return 0;
+}
+
+/* Move a task to CFS or FIFO; leaving the deadline class releases its reservation */
+static void __setscheduler(struct process* proc, u32 policy, u32 rt_priority) {
+    u64 irq_flags = irq_save();
+    bool running = (proc == scheduler.current_process);
+    bool runnable = running || proc->state == PROCESS_READY;
+    
+    if (runnable) {
+        switch_out_class(proc, running);
+    }
+    
+    if (proc->policy == SCHED_DEADLINE) {
+        dl_rq.total_bw -= proc->dl.dl_bw;
+        memset(&proc->dl, 0, sizeof(struct sched_dl_entity));
+    }
+    proc->policy = policy;
+    proc->rt_prio = (policy == SCHED_FIFO) ? rt_priority : 0;
+    
+    /* A re-prioritised FIFO task goes to the tail of its new level */
+    if (runnable) {
+        switch_in_class(proc, running);
+    }
+    
+    scheduler.need_resched = true;
+    irq_restore(irq_flags);
+}
+
+/* Switch a task to CFS or SCHED_FIFO (rt_priority 0 is highest) */
+i32 sched_setscheduler(u32 pid, u32 policy, u32 rt_priority) {
+    if (policy != SCHED_NORMAL && policy != SCHED_FIFO) {
+        return -1;
+    }
+    if (policy == SCHED_FIFO && rt_priority >= RT_PRIO_LEVELS) {
+        return -1;
+    }
+    
+    struct process* proc = pid ? get_process_by_pid(pid) : scheduler.current_process;
+    if (!proc || proc == scheduler.idle_process || proc->state == PROCESS_ZOMBIE) {
+        return -1;
+    }
+    
+    /* Boosted: change what the boost falls back to, keep the stronger of the two */
+    if (proc->pi_boosted) {
+        u32 boost = proc->rt_prio;
+        proc->normal_policy = policy;
+        proc->normal_prio = rt_priority;
+        sched_rt_mutex_setprio(proc, boost);
+        return 0;
+    }
+    
+    __setscheduler(proc, policy, rt_priority);
+    return 0;
+}
+
+/* Priority inheritance: run proc as FIFO at prio while a waiter of that
+ * priority blocks on a lock it holds; RT_PRIO_LEVELS or weaker drops the
+ * boost. Deadline tasks already run above every FIFO priority. */
+void sched_rt_mutex_setprio(struct process* proc, u32 prio) {
+    if (!proc || proc == scheduler.idle_process || proc->policy == SCHED_DEADLINE) {
+        return;
+    }
+    
+    if (!proc->pi_boosted) {
+        proc->normal_policy = proc->policy;
+        proc->normal_prio = proc->rt_prio;
+    }
+    
+    u32 base = (proc->normal_policy == SCHED_FIFO) ? proc->normal_prio : RT_PRIO_LEVELS;
+    u32 policy = proc->normal_policy;
+    u32 rt_prio = proc->normal_prio;
+    proc->pi_boosted = prio < base;
+    if (proc->pi_boosted) {
+        policy = SCHED_FIFO;
+        rt_prio = prio;
+    }
+    
+    if (proc->policy != policy || (policy == SCHED_FIFO && proc->rt_prio != rt_prio)) {
+        __setscheduler(proc, policy, rt_prio);
+    }
+}
+
+/* FIFO tasks currently runnable, including the running one */
+u32 sched_rt_nr_running(void) {
+    return rt_rq.nr_running;
+}
+
+/* Current job is done: give up the rest of the budget until the next period */
+void sched_dl_yield(void) {
+    struct process* curr = scheduler.current_process;
+    if (!curr || curr->policy != SCHED_DEADLINE) {
+        schedule();
+        return;
+    }
+    
+    u64 irq_flags = irq_save();
+    update_curr_dl(curr);
+    if (!curr->dl.throttled) {
+        curr->dl.runtime = 0;
+        throttle_dl_task(curr);
+    }
+    curr->dl.yielded = true;
+    
+    schedule();
+    irq_restore(irq_flags);
+}
+
+i32 sched_get_deadline_info(u32 pid, struct sched_dl_info* info) {
+    struct process* proc = pid ? get_process_by_pid(pid) : scheduler.current_process;
+    if (!proc || proc->policy != SCHED_DEADLINE) {
+        return -1;
+    }
+    
+    info->runtime_ns = proc->dl.dl_runtime;
+    info->deadline_ns = proc->dl.dl_deadline;
+    info->period_ns = proc->dl.dl_period;
+    info->abs_deadline_ns = proc->dl.deadline;
+    info->remaining_ns = proc->dl.runtime > 0 ? (u64)proc->dl.runtime : 0;
+    info->deadline_misses = proc->dl.deadline_misses;
+    info->throttled = proc->dl.throttled;
+    return 0;
+}
+
+/* Misses since the previous call for this task, -1 if not a deadline task */
+i64 sched_dl_check_misses(u32 pid) {
+    struct process* proc = get_process_by_pid(pid);
+    if (!proc || proc->policy != SCHED_DEADLINE) {
+        return -1;
+    }
+    
+    i64 fresh = proc->dl.deadline_misses - proc->dl.misses_reported;
+    proc->dl.misses_reported = proc->dl.deadline_misses;
+    return fresh;
+}
+
+u64 sched_dl_total_misses(void) {
+    return dl_rq.total_misses;
+}
+
+/* Admitted deadline bandwidth in per mille of one CPU */
+u32 sched_dl_utilization(void) {
+    return (u32)((dl_rq.total_bw * 1000) >> DL_BW_SHIFT);
+}
+
+/* CPU AFFINITY */
+
+/* CPUs available for general scheduling; never empty */
+u64 sched_housekeeping_mask(void) {
+    u64 mask = cpu_online_mask & ~cpu_isolated_mask;
+    return mask ? mask : cpu_online_mask;
+}
+
+/* Restrict a task to the CPUs in mask; pid 0 means the caller */
+i32 sched_setaffinity(u32 pid, u64 mask) {
+    struct process* proc = pid ? get_process_by_pid(pid) : scheduler.current_process;
+    if (!proc || proc == scheduler.idle_process) {
+        return -1;
+    }
+    
+    mask &= cpu_online_mask;
+    if (mask == 0) {
+        return -1;
+    }
+    
+    proc->cpus_allowed = mask;
+    return 0;
+}
+
+i32 sched_getaffinity(u32 pid, u64* mask) {
+    struct process* proc = pid ? get_process_by_pid(pid) : scheduler.current_process;
+    if (!proc) {
+        return -1;
+    }
+    
+    *mask = proc->cpus_allowed;
+    return 0;
+}
+
+/* Boot option isolcpus=<list>, e.g. "1,3-5": keep those CPUs for tasks pinned there */
+i32 sched_set_isolated_cpus(const char* cpulist) {
+    u64 mask = 0;
+    const char* p = cpulist;
+    
+    while (*p && *p != ' ') {
+        if (*p < '0' || *p > '9') {
+            return -1;
+        }
+    
+        u32 first = 0;
+        while (*p >= '0' && *p <= '9') {
+            first = first * 10 + (*p++ - '0');
+        }
+    
+        u32 last = first;
+        if (*p == '-') {
+            p++;
+            last = 0;
+            while (*p >= '0' && *p <= '9') {
+                last = last * 10 + (*p++ - '0');
+            }
+        }
+    
+        if (first > last || last >= SCHED_MAX_CPUS) {
+            return -1;
+        }
+        for (u32 cpu = first; cpu <= last; cpu++) {
+            mask |= 1ULL << cpu;
+        }
+    
+        if (*p == ',') {
+            p++;
+        }
+    }
+    
+    cpu_isolated_mask = mask;
+    
+    /* At least one CPU must stay available for general work */
+    if ((cpu_online_mask & ~mask) == 0) {
+        vga_puts("isolcpus: would isolate every online CPU, ignored for housekeeping\n");
+    }
+    
+    return 0;
+}
+
+/* TASK GROUPS */
+
+/* Create a task group under parent_id (0 = root) */
+i32 task_group_create(const char* name, u32 parent_id, u64 shares) {
+    struct task_group* parent = task_group_find(parent_id);
+    if (!parent) {
+        return -1;
+    }
+    
+    /* Find free group slot */
+    struct task_group* tg = NULL;
+    for (u32 i = 1; i < MAX_TASK_GROUPS; i++) {
+        if (!task_groups[i].in_use) {
+            tg = &task_groups[i];
+            break;
+        }
+    }
+    
+    if (!tg) {
+        return -1;  /* No free groups */
+    }
+    
+    memset(tg, 0, sizeof(struct task_group));
+    tg->id = scheduler.next_group_id++;
+    strlcpy(tg->name, name, sizeof(tg->name));
+    tg->shares = shares ? shares : NICE_0_WEIGHT;
+    tg->parent = parent;
+    tg->period_ns = CFS_BANDWIDTH_PERIOD_NS;
+    
+    init_cfs_rq(&tg->cfs_rq, tg);
+    tg->se.weight = tg->shares;
+    tg->se.my_q = &tg->cfs_rq;
+    set_entity_group(&tg->se, parent);
+    tg->se.vruntime = parent->cfs_rq.min_vruntime;
+    
+    tg->in_use = true;
+    
+    return tg->id;
+}
+
+/* Destroy an empty task group */
+i32 task_group_destroy(u32 group_id) {
+    struct task_group* tg = task_group_find(group_id);
+    if (!tg || tg == scheduler.root_group || tg->nr_tasks > 0) {
+        return -1;
+    }
+    
+    /* Refuse while child groups still point at it */
+    for (u32 i = 1; i < MAX_TASK_GROUPS; i++) {
+        if (task_groups[i].in_use && task_groups[i].parent == tg) {
+            return -1;
+        }
+    }
+    
+    tg->in_use = false;
+    return 0;
+}
+
+/* Look up a task group by ID */
+struct task_group* task_group_find(u32 group_id) {
+    for (u32 i = 0; i < MAX_TASK_GROUPS; i++) {
+        if (task_groups[i].in_use && task_groups[i].id == group_id) {
+            return &task_groups[i];
+        }
+    }
+    return NULL;
+}
+
+/* Change a group's weight relative to its siblings */
+i32 task_group_set_shares(u32 group_id, u64 shares) {
+    struct task_group* tg = task_group_find(group_id);
+    if (!tg || tg == scheduler.root_group || shares == 0) {
+        return -1;
+    }
+    
+    /* Reweight in place so the parent's total_weight stays consistent */
+    u64 irq_flags = irq_save();
+    bool queued = tg->se.on_rq;
+    if (queued) {
+        tg->se.cfs_rq->total_weight -= tg->se.weight;
+    }
+    tg->shares = shares;
+    tg->se.weight = shares;
+    if (queued) {
+        tg->se.cfs_rq->total_weight += tg->se.weight;
+    }
+    irq_restore(irq_flags);
+    
+    return 0;
+}
+
+/* Limit a group to quota_us of CPU time every period_us (quota 0 = unlimited) */
+i32 task_group_set_bandwidth(u32 group_id, u64 quota_us, u64 period_us) {
+    struct task_group* tg = task_group_find(group_id);
+    if (!tg || tg == scheduler.root_group) {
+        return -1;
+    }
+    
+    if (period_us == 0) {
+        period_us = CFS_BANDWIDTH_PERIOD_NS / 1000;
+    }
+    
+    u64 irq_flags = irq_save();
+    tg->quota_ns = quota_us * 1000;
+    tg->period_ns = period_us * 1000;
+    tg->runtime_remaining = tg->quota_ns;
+    tg->period_start = clock_monotonic_ns();
+    
+    /* Lifting the limit releases a throttled group immediately */
+    if (tg->quota_ns == 0 && tg->throttled) {
+        unthrottle_group(tg, tg->period_start);
+    }
+    irq_restore(irq_flags);
+    
+    return 0;
+}
+
+/* Move a process into a task group */
+i32 task_group_attach(u32 pid, u32 group_id) {
+    struct process* proc = get_process_by_pid(pid);
+    struct task_group* tg = task_group_find(group_id);
+    if (!proc || !tg || proc == scheduler.idle_process) {
+        return -1;
+    }
+    
+    if (proc->group == tg) {
+        return 0;
+    }
+    
+    /* Deadline and FIFO tasks are outside CFS bandwidth control */
+    if (proc->policy != SCHED_NORMAL) {
+        return -1;
+    }
+    
+    u64 irq_flags = irq_save();
+    bool running = (proc == scheduler.current_process);
+    if (running) {
+        update_curr(proc);
+        put_prev_task(proc);
+    }
+    
+    bool queued = proc->se.on_rq;
+    if (queued) {
+        cfs_dequeue_task(proc);
+    }
+    
+    /* Keep the task's lag relative to the queue it moves between */
+    u64 lag = proc->se.vruntime - proc->se.cfs_rq->min_vruntime;
+    
+    proc->group->nr_tasks--;
+    proc->group = tg;
+    tg->nr_tasks++;
+    set_entity_group(&proc->se, tg);
+    proc->se.vruntime = tg->cfs_rq.min_vruntime + lag;
+    
+    if (queued) {
+        cfs_enqueue_task(proc);
+        proc->state = running ? PROCESS_RUNNING : PROCESS_READY;
+    }
+    
+    if (running) {
+        set_next_task(proc);
+        scheduler.need_resched = true;
+    }
+    irq_restore(irq_flags);
+    
+    return 0;
+}
+
+/* WAIT QUEUES */
+
+void wait_queue_init(struct wait_queue_head* wq) {
+    wq->first = NULL;
+    wq->last = NULL;
+}
+
+/* func NULL means wake the sleeping process */
+void wait_entry_init(struct wait_queue_entry* entry, u32 flags, wait_queue_func_t func, void* private) {
+    entry->proc = scheduler.current_process;
+    entry->flags = flags;
+    entry->func = func ? func : default_wake_function;
+    entry->private = private;
+    entry->head = NULL;
+    entry->next = NULL;
+    entry->prev = NULL;
+}
+
+static void wait_queue_link(struct wait_queue_head* wq, struct wait_queue_entry* entry,
+                            struct wait_queue_entry* before) {
+    entry->head = wq;
+    entry->next = before;
+    entry->prev = before ? before->prev : wq->last;
+    
+    if (entry->prev) {
+        entry->prev->next = entry;
+    } else {
+        wq->first = entry;
+    }
+    if (before) {
+        before->prev = entry;
+    } else {
+        wq->last = entry;
+    }
+}
+
+/* Ranks like the RTOS priority-inheritance code: deadline first, then
+ * FIFO by rt_prio, then CFS tasks by their own priority. Lower runs first. */
+static u32 wait_queue_prio(struct process* proc) {
+    if (proc->policy == SCHED_DEADLINE) return 0;
+    if (proc->policy == SCHED_FIFO) return proc->rt_prio;
+    return RT_PRIO_LEVELS + proc->priority;
+}
+
+/* Non-exclusive entries go in front, so every one of them sees a wakeup
+ * before the exclusive ones are counted. Exclusive entries queue FIFO, or
+ * by effective priority with WQ_FLAG_PRIORITY. */
+static void __add_wait_queue(struct wait_queue_head* wq, struct wait_queue_entry* entry) {
+    if (entry->head) {
+        return;
+    }
+    
+    if (!(entry->flags & WQ_FLAG_EXCLUSIVE)) {
+        wait_queue_link(wq, entry, wq->first);
+        return;
+    }
+    
+    struct wait_queue_entry* before = NULL;
+    if (entry->flags & WQ_FLAG_PRIORITY) {
+        u32 prio = wait_queue_prio(entry->proc);
+        for (before = wq->first; before; before = before->next) {
+            if ((before->flags & WQ_FLAG_EXCLUSIVE) && wait_queue_prio(before->proc) > prio) {
+                break;
+            }
+        }
+    }
+    wait_queue_link(wq, entry, before);
+}
+
+void add_wait_queue(struct wait_queue_head* wq, struct wait_queue_entry* entry) {
+    u64 irq_flags = irq_save();
+    __add_wait_queue(wq, entry);
+    irq_restore(irq_flags);
+}
+
+void remove_wait_queue(struct wait_queue_entry* entry) {
+    u64 irq_flags = irq_save();
+    struct wait_queue_head* wq = entry->head;
+    if (!wq) {
+        irq_restore(irq_flags);
+        return;
+    }
+    
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        wq->first = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        wq->last = entry->prev;
+    }
+    
+    entry->head = NULL;
+    entry->next = NULL;
+    entry->prev = NULL;
+    irq_restore(irq_flags);
+}
+
+/* Dequeue and wake the sleeper */
+bool default_wake_function(struct wait_queue_entry* entry, void* key) {
+    (void)key;
+    remove_wait_queue(entry);
+    cfs_wake_up_process(entry->proc);
+    return true;
+}
+
+/* Wake every non-exclusive waiter and up to nr_exclusive exclusive ones
+ * (0 = all). A callback that declines the wakeup is not counted.
+ * Returns the number of wakeups taken. */
+u32 wake_up_key(struct wait_queue_head* wq, u32 nr_exclusive, void* key) {
+    u64 irq_flags = irq_save();
+    struct wait_queue_entry* entry = wq->first;
+    u32 woken = 0;
+    
+    while (entry) {
+        struct wait_queue_entry* next = entry->next;
+        u32 flags = entry->flags;
+        
+        if (entry->func(entry, key)) {
+            woken++;
+            if ((flags & WQ_FLAG_EXCLUSIVE) && nr_exclusive && --nr_exclusive == 0) {
+                break;
+            }
+        }
+        entry = next;
+    }
+    
+    irq_restore(irq_flags);
+    return woken;
+}
+
+/* Sleep on wq until woken. Call with interrupts disabled, after the wait
+ * condition was found false; the entry is off the queue on return. */
+void wait_queue_sleep(struct wait_queue_head* wq, struct wait_queue_entry* entry) {
+    struct process* current = scheduler.current_process;
+    
+    entry->proc = current;
+    add_wait_queue(wq, entry);
+    current->state = PROCESS_BLOCKED;
+    schedule();
+    
+    /* Timeouts and signals wake us without going through the queue */
+    remove_wait_queue(entry);
+}
+
+/* Process termination */
+void process_exit(u32 exit_code) {
+    struct process* proc = scheduler.current_process;
+    if (!proc || proc == scheduler.idle_process) {
+        return;
+    }
+    
+    /* Never returns: the next task's context brings its own flags back */
+    disable_interrupts();
+    proc->state = PROCESS_ZOMBIE;
+    proc->exit_code = exit_code;
+    proc->group->nr_tasks--;
+    
+    /* Release the deadline reservation and leave the runqueue or the
+     * throttled list now; the replenish tick must never see this PCB again */
+    if (proc->policy == SCHED_DEADLINE) {
+        switch_out_class(proc, true);
+        dl_rq.total_bw -= proc->dl.dl_bw;
+    }
+    
+    process_release(proc);
+    
+    /* schedule() takes the zombie off the runqueue */
+    
+    /* The leader's exit drops the channel rings its group still holds */
+    if (proc->tgid == proc->pid) {
+        shm_exit(proc->tgid);
+    }
+    
+    /* Children of an exiting process: zombies go now, live ones are detached */
+    if (proc->tgid == proc->pid) {
+        struct process* child = task_list;
+        while (child) {
+            struct process* next = child->task_next;
+            if (child->ppid == proc->tgid && child->tgid == child->pid) {
+                if (child->state == PROCESS_ZOMBIE) {
+                    process_reap(child);
+                } else {
+                    child->ppid = 0;
+                }
+            }
+            child = next;
+        }
+    }
+    
+    /* Nobody waits for threads or parentless tasks: reap after the switch */
+    if (proc->tgid != proc->pid || proc->ppid == 0) {
+        process_reap(scheduler.dead_task);
+        scheduler.dead_task = proc;
+    } else {
+        /* Notify parent */
+        signal_send(proc->ppid, SIGCHLD);
+        wake_up_all(&scheduler.child_exit);
+    }
+    
+    /* Reschedule */
+    schedule();
+}
+
+/* Throw away a kernel thread that has not run yet, for creators that fail to
+ * finish setting it up. Keep interrupts off from kthread_create to here so
+ * the tick cannot run it in between. */
+void kthread_discard(u32 pid) {
+    struct process* proc = get_process_by_pid(pid);
+    if (!proc || proc->last_scheduled || proc->policy != SCHED_NORMAL) {
+        return;
+    }
+    
+    if (proc->se.on_rq) {
+        cfs_dequeue_task(proc);
+    }
+    proc->state = PROCESS_ZOMBIE;
+    proc->group->nr_tasks--;
+    process_release(proc);
+    process_reap(proc);
+}
+
+/* Wait for a child process to exit (pid -1: any child) and reap it.
+ * Returns the child's pid, 0 with WNOHANG if none has exited yet. */
+i32 process_wait(i32 pid, i32* status, i32 options, struct rusage* rusage) {
+    struct process* current = scheduler.current_process;
+    struct wait_queue_entry wait;
+    wait_entry_init(&wait, 0, NULL, NULL);
+    (void)rusage;
+    
+    disable_interrupts();
+    while (1) {
+        bool have_child = false;
+    
+        for (struct process* proc = task_list; proc; proc = proc->task_next) {
+            if (proc->ppid != current->tgid || proc->tgid != proc->pid ||
+                (pid > 0 && proc->pid != (u32)pid)) {
+                continue;
+            }
+            have_child = true;
+    
+            if (proc->state == PROCESS_ZOMBIE) {
+                i32 child_pid = proc->pid;
+                if (status) {
+                    *status = (proc->exit_code & 0xFF) << 8;
+                }
+                process_reap(proc);
+                enable_interrupts();
+                return child_pid;
+            }
+        }
+    
+        if (!have_child) {
+            enable_interrupts();
+            return -ECHILD;
+        }
+        if (options & WNOHANG) {
+            enable_interrupts();
+            return 0;
+        }
+        if (signal_pending(current)) {
+            enable_interrupts();
+            return -EINTR;
+        }
+    
+        wait_queue_sleep(&scheduler.child_exit, &wait);
     }
-    
-    /* Reschedule */
-    schedule();
 }
 
 /* Get current process */
@@ -383,31 +2585,88 @@ struct process* get_current_process(void) {
     return scheduler.current_process;
 }
 
-/* Get process by PID */
+/* FPU state of the running thread, for the #NM handler */
+struct fpu_context* get_current_fpu(void) {
+    if (!scheduler.current_process) {
+        return NULL;
+    }
+    return &scheduler.current_process->fpu;
+}
+
+/* Get process by PID - hashed, O(1) on average */
 struct process* get_process_by_pid(u32 pid) {
-    for (u32 i = 0; i < MAX_PROCESSES; i++) {
-        if (processes[i].in_use && processes[i].pid == pid) {
-            return &processes[i];
+    for (struct process* proc = pid_hash[pid_hashfn(pid)]; proc; proc = proc->pid_next) {
+        if (proc->pid == pid) {
+            return proc;
         }
     }
     return NULL;
 }
 
+/* True if proc has an unblocked signal waiting; sleepers give up on it */
+bool signal_pending(struct process* proc) {
+    return (proc->sigpending & ~proc->sigblocked) != 0;
+}
+
+/* Threads cloned without a user stack run kernel code only and never
+ * pass through the return-to-user path that delivers signals */
+bool process_is_kernel_thread(struct process* proc) {
+    return proc->kernel_stack != NULL;
+}
+
+/* Release a zombie's PCB and PID once its exit status has been collected */
+void process_reap(struct process* proc) {
+    if (!proc || proc->state != PROCESS_ZOMBIE || proc == scheduler.current_process) {
+        return;
+    }
+    
+    unpublish_task(proc);
+    proc->state = PROCESS_TERMINATED;
+    
+    mm_put(proc->mm);
+    proc->mm = NULL;
+    kfree(proc->kernel_stack);
+    proc->kernel_stack = NULL;
+    
+    free_process_slot(proc);
+}
+
 /* Process statistics */
 void get_process_stats(struct process_stats* stats) {
     stats->total_processes = 0;
     stats->running_processes = scheduler.nr_running;
     stats->zombie_processes = 0;
     
-    for (u32 i = 0; i < MAX_PROCESSES; i++) {
-        if (processes[i].in_use) {
-            stats->total_processes++;
-            if (processes[i].state == PROCESS_ZOMBIE) {
-                stats->zombie_processes++;
-            }
+    for (struct process* proc = task_list; proc; proc = proc->task_next) {
+        stats->total_processes++;
+        if (proc->state == PROCESS_ZOMBIE) {
+            stats->zombie_processes++;
         }
     }
     
     stats->current_pid = scheduler.current_process ? scheduler.current_process->pid : 0;
     stats->scheduler_enabled = scheduler.scheduler_enabled;
+    
+    /* Per-group usage counters */
+    stats->group_count = 0;
+    for (u32 i = 0; i < MAX_TASK_GROUPS; i++) {
+        struct task_group* tg = &task_groups[i];
+        if (!tg->in_use) {
+            continue;
+        }
+    
+        struct task_group_stats* gs = &stats->groups[stats->group_count++];
+        gs->id = tg->id;
+        gs->parent_id = tg->parent ? tg->parent->id : 0;
+        strcpy(gs->name, tg->name);
+        gs->shares = tg->shares;
+        gs->quota_us = tg->quota_ns / 1000;
+        gs->period_us = tg->period_ns / 1000;
+        gs->usage_us = tg->usage_ns / 1000;
+        gs->nr_periods = tg->nr_periods;
+        gs->nr_throttled = tg->nr_throttled;
+        gs->throttled_us = tg->throttled_ns / 1000;
+        gs->nr_tasks = tg->nr_tasks;
+        gs->throttled = tg->throttled;
+    }
 }
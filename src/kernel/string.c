@@ -102,3 +102,50 @@ char* strtok(char* str, const char* delim) {
     
     return token_start;
 }
+
+/* Copy at most n bytes, zero-padding; not terminated if src fills n */
+char* strncpy(char* dest, const char* src, size_t n) {
+    char* original_dest = dest;
+    while (n > 0 && *src) {
+        *dest++ = *src++;
+        n--;
+    }
+    while (n > 0) {
+        *dest++ = '\0';
+        n--;
+    }
+    return original_dest;
+}
+
+/* Copy into a buffer of size bytes, always NUL-terminating when size > 0 */
+size_t strlcpy(char* dest, const char* src, size_t size) {
+    size_t len = strlen(src);
+    if (size > 0) {
+        size_t copy = len < size - 1 ? len : size - 1;
+        memcpy(dest, src, copy);
+        dest[copy] = '\0';
+    }
+    return len;
+}
+
+/* Parse a decimal integer */
+int atoi(const char* str) {
+    int result = 0;
+    int sign = 1;
+    
+    while (*str == ' ' || *str == '\t') {
+        str++;
+    }
+    
+    if (*str == '-' || *str == '+') {
+        sign = (*str == '-') ? -1 : 1;
+        str++;
+    }
+    
+    while (*str >= '0' && *str <= '9') {
+        result = result * 10 + (*str - '0');
+        str++;
+    }
+    
+    return sign * result;
+}
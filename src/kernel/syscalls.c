@@ -104,9 +104,23 @@
 #define SYS_GETRUSAGE   98
 #define SYS_SYSINFO     99
 #define SYS_TIMES       100
+#define SYS_GETTID      186
+#define SYS_FUTEX       202
+#define SYS_SCHED_SETAFFINITY 203
+#define SYS_SCHED_GETAFFINITY 204
+#define SYS_EPOLL_WAIT  232
+#define SYS_EPOLL_CTL   233
+#define SYS_SPLICE      275
+#define SYS_VMSPLICE    278
+#define SYS_EPOLL_CREATE1 291
+
+/* Kronos-private calls, above the Linux range */
+#define SYS_IO_RING_SETUP   500  /* Returns the ring's address in the caller */
+#define SYS_IO_RING_ENTER   501
+#define SYS_IO_RING_DESTROY 502
 
 /* Maximum number of system calls */
-#define MAX_SYSCALLS    256
+#define MAX_SYSCALLS    512
 
 /* System call handler function pointer */
 typedef i64 (*syscall_handler_t)(u64 arg1, u64 arg2, u64 arg3, u64 arg4, u64 arg5, u64 arg6);
@@ -123,7 +137,7 @@ i64 sys_read(i32 fd, void* buf, size_t count) {
         return -EBADF;
     }
     
-    struct file_descriptor* file = current->fd_table[fd];
+    struct file_descriptor* file = current->files->fd_table[fd];
     if (!file) {
         return -EBADF;
     }
@@ -137,7 +151,7 @@ i64 sys_write(i32 fd, const void* buf, size_t count) {
         return -EBADF;
     }
     
-    struct file_descriptor* file = current->fd_table[fd];
+    struct file_descriptor* file = current->files->fd_table[fd];
     if (!file) {
         return -EBADF;
     }
@@ -159,7 +173,7 @@ i64 sys_open(const char* pathname, i32 flags, mode_t mode) {
     /* Find free file descriptor */
     i32 fd = -1;
     for (i32 i = 0; i < MAX_FD_PER_PROCESS; i++) {
-        if (!current->fd_table[i]) {
+        if (!current->files->fd_table[i]) {
             fd = i;
             break;
         }
@@ -181,7 +195,7 @@ i64 sys_open(const char* pathname, i32 flags, mode_t mode) {
     fd_entry->offset = 0;
     fd_entry->flags = flags;
     
-    current->fd_table[fd] = fd_entry;
+    current->files->fd_table[fd] = fd_entry;
     
     return fd;
 }
@@ -192,14 +206,19 @@ i64 sys_close(i32 fd) {
         return -EBADF;
     }
     
-    struct file_descriptor* file = current->fd_table[fd];
+    struct file_descriptor* file = current->files->fd_table[fd];
     if (!file) {
         return -EBADF;
     }
     
+    if (pipe_end_put(file, fd)) {
+        current->files->fd_table[fd] = NULL;
+        return 0;
+    }
+    
     vfs_close(file->file);
     kfree(file);
-    current->fd_table[fd] = NULL;
+    current->files->fd_table[fd] = NULL;
     
     return 0;
 }
@@ -234,10 +253,69 @@ i64 sys_wait4(pid_t pid, i32* status, i32 options, struct rusage* rusage) {
 }
 
 i64 sys_getpid(void) {
+    struct process* current = get_current_process();
+    return current ? current->tgid : -1;
+}
+
+i64 sys_gettid(void) {
     struct process* current = get_current_process();
     return current ? current->pid : -1;
 }
 
+/* Kronos clone: the child starts at entry(arg) on child_stack rather than
+ * returning from the syscall, since the trap frame is not exposed here */
+i64 sys_clone(u64 flags, void* child_stack, void* entry, void* arg, i32* parent_tid) {
+    struct process* parent = get_current_process();
+    if (!parent) {
+        return -ESRCH;
+    }
+    
+    /* Without CLONE_VM this is a plain fork */
+    if (!(flags & CLONE_VM)) {
+        return sys_fork();
+    }
+    
+    if (!entry || !child_stack) {
+        return -EINVAL;
+    }
+    
+    i32 tid = process_clone(parent, flags, entry, child_stack, arg);
+    if (tid < 0) {
+        return -EAGAIN;
+    }
+    
+    if ((flags & CLONE_PARENT_SETTID) && parent_tid) {
+        *parent_tid = tid;
+    }
+    
+    return tid;
+}
+
+/* Affinity masks are a single u64: bit n = CPU n */
+i64 sys_sched_setaffinity(pid_t pid, size_t len, const u64* user_mask) {
+    if (!user_mask || len < sizeof(u64)) {
+        return -EINVAL;
+    }
+    
+    if (sched_setaffinity(pid, *user_mask) < 0) {
+        return pid && !get_process_by_pid(pid) ? -ESRCH : -EINVAL;
+    }
+    
+    return 0;
+}
+
+i64 sys_sched_getaffinity(pid_t pid, size_t len, u64* user_mask) {
+    if (!user_mask || len < sizeof(u64)) {
+        return -EINVAL;
+    }
+    
+    if (sched_getaffinity(pid, user_mask) < 0) {
+        return -ESRCH;
+    }
+    
+    return sizeof(u64);  /* Bytes written, as Linux returns */
+}
+
 i64 sys_getppid(void) {
     struct process* current = get_current_process();
     return current ? current->ppid : -1;
@@ -259,11 +337,11 @@ i64 sys_brk(void* addr) {
     }
     
     if (!addr) {
-        return current->heap_base + current->heap_size;  /* Return current break */
+        return current->mm->heap_base + current->mm->heap_size;  /* Return current break */
     }
     
     u64 new_break = (u64)addr;
-    u64 old_break = current->heap_base + current->heap_size;
+    u64 old_break = current->mm->heap_base + current->mm->heap_size;
     
     if (new_break > old_break) {
         /* Expand heap */
@@ -273,12 +351,12 @@ i64 sys_brk(void* addr) {
         if (result == MAP_FAILED) {
             return -ENOMEM;
         }
-        current->heap_size += expand_size;
+        current->mm->heap_size += expand_size;
     } else if (new_break < old_break) {
         /* Shrink heap */
         u64 shrink_size = old_break - new_break;
         munmap((void*)new_break, shrink_size);
-        current->heap_size -= shrink_size;
+        current->mm->heap_size -= shrink_size;
     }
     
     return new_break;
@@ -293,11 +371,101 @@ i64 sys_rt_sigaction(i32 signum, const struct sigaction* act, struct sigaction*
     return signal_action(signum, act, oldact);
 }
 
+i64 sys_rt_sigprocmask(i32 how, const u64* set, u64* oldset) {
+    return signal_procmask(how, set, oldset);
+}
+
 /* IPC operations */
 i64 sys_pipe(i32 pipefd[2]) {
     return pipe_create(pipefd);
 }
 
+/* Only the pipe size commands exist; there is no file status to get or set */
+i64 sys_fcntl(i32 fd, i32 cmd, u64 arg) {
+    return pipe_fcntl(fd, cmd, (u32)arg);
+}
+
+/* futex(uaddr, op, val, timeout, uaddr2, val3); REQUEUE takes its count in the timeout slot */
+i64 sys_futex(u32* uaddr, i32 op, u32 val, const struct timespec* timeout, u32* uaddr2, u32 val3) {
+    /* A user word outside the caller's mappings would be read as kernel memory */
+    if (!vmm_access_ok((u64)uaddr, sizeof(u32), false)) {
+        return -EFAULT;
+    }
+    
+    switch (op & ~FUTEX_PRIVATE_FLAG) {
+        case FUTEX_WAIT:
+            if (!timeout) {
+                return futex_wait(uaddr, val, 0);
+            }
+            if (!vmm_access_ok((u64)timeout, sizeof(struct timespec), false)) {
+                return -EFAULT;
+            }
+            if (timeout->tv_sec < 0 || timeout->tv_nsec < 0 || timeout->tv_nsec >= 1000000000L) {
+                return -EINVAL;
+            }
+            /* Round up to whole ticks; a zero timeout still waits one, and
+             * anything past ~49 days waits the longest the u32 allows */
+            u64 timeout_ms = 0xFFFFFFFFULL;
+            if ((u64)timeout->tv_sec < 0xFFFFFFFFULL / 1000) {
+                timeout_ms = (u64)timeout->tv_sec * 1000 + (timeout->tv_nsec + 999999) / 1000000;
+                if (timeout_ms > 0xFFFFFFFFULL) {
+                    timeout_ms = 0xFFFFFFFFULL;
+                }
+            }
+            return futex_wait(uaddr, val, timeout_ms ? (u32)timeout_ms : 1);
+            
+        case FUTEX_WAKE:
+            return futex_wake(uaddr, val);
+            
+        case FUTEX_REQUEUE:
+        case FUTEX_CMP_REQUEUE:
+            if (!vmm_access_ok((u64)uaddr2, sizeof(u32), false)) {
+                return -EFAULT;
+            }
+            if ((op & ~FUTEX_PRIVATE_FLAG) == FUTEX_REQUEUE) {
+                return futex_requeue(uaddr, val, uaddr2, (u32)(u64)timeout, false, 0);
+            }
+            return futex_requeue(uaddr, val, uaddr2, (u32)(u64)timeout, true, val3);
+            
+        default:
+            return -ENOSYS;
+    }
+}
+
+i64 sys_epoll_create1(i32 flags) {
+    (void)flags;
+    return epoll_create();
+}
+
+i64 sys_epoll_ctl(i32 epfd, i32 op, u32 target, const struct epoll_event* event) {
+    return epoll_ctl(epfd, op, target, event);
+}
+
+i64 sys_epoll_wait(i32 epfd, struct epoll_event* events, i32 maxevents, i32 timeout) {
+    return epoll_wait(epfd, events, maxevents, timeout);
+}
+
+i64 sys_io_ring_setup(u32 entries) {
+    struct io_ring* ring = io_ring_setup(entries);
+    return ring ? (i64)ring : -ENOMEM;
+}
+
+i64 sys_io_ring_enter(struct io_ring* ring, u32 min_complete) {
+    return io_ring_enter(ring, min_complete);
+}
+
+i64 sys_io_ring_destroy(struct io_ring* ring) {
+    return io_ring_destroy(ring);
+}
+
+i64 sys_splice(i32 fd_in, i64* off_in, i32 fd_out, i64* off_out, size_t len, u32 flags) {
+    return splice(fd_in, off_in, fd_out, off_out, len, flags);
+}
+
+i64 sys_vmsplice(i32 fd, const struct iovec* iov, u32 nr_segs, u32 flags) {
+    return vmsplice(fd, iov, nr_segs, flags);
+}
+
 i64 sys_msgget(key_t key, i32 msgflg) {
     return msgget(key, msgflg);
 }
@@ -314,6 +482,23 @@ i64 sys_semget(key_t key, i32 nsems, i32 semflg) {
     return semget(key, nsems, semflg);
 }
 
+i64 sys_shmget(key_t key, size_t size, i32 shmflg) {
+    return shmget(key, size, shmflg);
+}
+
+i64 sys_shmat(i32 shmid, const void* shmaddr, i32 shmflg) {
+    return (i64)shmat(shmid, shmaddr, shmflg);
+}
+
+i64 sys_shmdt(const void* shmaddr) {
+    return shmdt(shmaddr);
+}
+
+i64 sys_shmctl(i32 shmid, i32 cmd, void* buf) {
+    (void)buf;  /* No shmid_ds yet; IPC_RMID ignores it */
+    return shmctl(shmid, cmd);
+}
+
 /* Filesystem operations */
 i64 sys_stat(const char* pathname, struct stat* statbuf) {
     return vfs_stat(pathname, statbuf);
@@ -342,16 +527,26 @@ i64 sys_getcwd(char* buf, size_t size) {
 /* Time operations */
 i64 sys_gettimeofday(struct timeval* tv, struct timezone* tz) {
     if (tv) {
-        u64 time = get_system_time();
-        tv->tv_sec = time / 1000000;
-        tv->tv_usec = time % 1000000;
+        u64 ns = clock_monotonic_ns();
+        tv->tv_sec = ns / 1000000000ULL;
+        tv->tv_usec = (ns % 1000000000ULL) / 1000;
     }
     return 0;
 }
 
 i64 sys_nanosleep(const struct timespec* req, struct timespec* rem) {
+    if (!req || req->tv_nsec < 0 || req->tv_nsec >= 1000000000L) {
+        return -EINVAL;
+    }
+    
     u64 nanoseconds = req->tv_sec * 1000000000ULL + req->tv_nsec;
-    return timer_sleep(nanoseconds);
+    clock_sleep_ns(nanoseconds);
+    
+    if (rem) {
+        rem->tv_sec = 0;
+        rem->tv_nsec = 0;
+    }
+    return 0;
 }
 
 /* System information */
@@ -392,18 +587,38 @@ void syscall_init(void) {
     syscall_table[SYS_MUNMAP] = (syscall_handler_t)sys_munmap;
     syscall_table[SYS_BRK] = (syscall_handler_t)sys_brk;
     syscall_table[SYS_PIPE] = (syscall_handler_t)sys_pipe;
+    syscall_table[SYS_FCNTL] = (syscall_handler_t)sys_fcntl;
+    syscall_table[SYS_EPOLL_CREATE1] = (syscall_handler_t)sys_epoll_create1;
+    syscall_table[SYS_EPOLL_CTL] = (syscall_handler_t)sys_epoll_ctl;
+    syscall_table[SYS_EPOLL_WAIT] = (syscall_handler_t)sys_epoll_wait;
+    syscall_table[SYS_IO_RING_SETUP] = (syscall_handler_t)sys_io_ring_setup;
+    syscall_table[SYS_IO_RING_ENTER] = (syscall_handler_t)sys_io_ring_enter;
+    syscall_table[SYS_IO_RING_DESTROY] = (syscall_handler_t)sys_io_ring_destroy;
+    syscall_table[SYS_SPLICE] = (syscall_handler_t)sys_splice;
+    syscall_table[SYS_VMSPLICE] = (syscall_handler_t)sys_vmsplice;
     syscall_table[SYS_SCHED_YIELD] = (syscall_handler_t)sys_sched_yield;
     syscall_table[SYS_GETPID] = (syscall_handler_t)sys_getpid;
     syscall_table[SYS_FORK] = (syscall_handler_t)sys_fork;
+    syscall_table[SYS_CLONE] = (syscall_handler_t)sys_clone;
+    syscall_table[SYS_GETTID] = (syscall_handler_t)sys_gettid;
+    syscall_table[SYS_FUTEX] = (syscall_handler_t)sys_futex;
+    syscall_table[SYS_SCHED_SETAFFINITY] = (syscall_handler_t)sys_sched_setaffinity;
+    syscall_table[SYS_SCHED_GETAFFINITY] = (syscall_handler_t)sys_sched_getaffinity;
     syscall_table[SYS_EXECVE] = (syscall_handler_t)sys_execve;
     syscall_table[SYS_EXIT] = (syscall_handler_t)sys_exit;
     syscall_table[SYS_WAIT4] = (syscall_handler_t)sys_wait4;
     syscall_table[SYS_KILL] = (syscall_handler_t)sys_kill;
+    syscall_table[SYS_RT_SIGACTION] = (syscall_handler_t)sys_rt_sigaction;
+    syscall_table[SYS_RT_SIGPROCMASK] = (syscall_handler_t)sys_rt_sigprocmask;
     syscall_table[SYS_UNAME] = (syscall_handler_t)sys_uname;
     syscall_table[SYS_MSGGET] = (syscall_handler_t)sys_msgget;
     syscall_table[SYS_MSGSND] = (syscall_handler_t)sys_msgsnd;
     syscall_table[SYS_MSGRCV] = (syscall_handler_t)sys_msgrcv;
     syscall_table[SYS_SEMGET] = (syscall_handler_t)sys_semget;
+    syscall_table[SYS_SHMGET] = (syscall_handler_t)sys_shmget;
+    syscall_table[SYS_SHMAT] = (syscall_handler_t)sys_shmat;
+    syscall_table[SYS_SHMDT] = (syscall_handler_t)sys_shmdt;
+    syscall_table[SYS_SHMCTL] = (syscall_handler_t)sys_shmctl;
     syscall_table[SYS_MKDIR] = (syscall_handler_t)sys_mkdir;
     syscall_table[SYS_RMDIR] = (syscall_handler_t)sys_rmdir;
     syscall_table[SYS_UNLINK] = (syscall_handler_t)sys_unlink;
@@ -425,3 +640,242 @@ i64 syscall_handler(u64 syscall_num, u64 arg1, u64 arg2, u64 arg3, u64 arg4, u64
     /* Call the system call handler */
     return syscall_table[syscall_num](arg1, arg2, arg3, arg4, arg5, arg6);
 }
+
+/* int 0x80 entry: number in rax, arguments in rdi, rsi, rdx, r10, r8, r9 */
+void syscall_entry(struct trap_frame* regs) {
+    /* rt_sigreturn replaces the whole frame, including rax */
+    if (regs->rax == SYS_RT_SIGRETURN) {
+        signal_return(regs);
+        return;
+    }
+    
+    regs->rax = syscall_handler(regs->rax, regs->rdi, regs->rsi, regs->rdx,
+                                regs->r10, regs->r8, regs->r9);
+    
+    /* Run a woken higher-priority process before returning to the caller */
+    scheduler_preempt_return(regs);
+}
+
+/* Asynchronous submission rings */
+
+#define MAX_IO_RINGS 16
+#define IO_RING_MAX_ENTRIES 4096
+
+/* Kernel-side ring state; the ring itself is user-writable and not trusted */
+static struct io_ring_ctx {
+    struct io_ring* ring;
+    struct io_sqe* sqes;
+    struct io_cqe* cqes;
+    u32 sq_mask;                        /* Trusted copies of the ring geometry */
+    u32 cq_mask;
+    u32 cq_entries;
+    u32 tgid;                           /* Process that set the ring up */
+    u32 worker_pid;
+    volatile u32 wake_seq;              /* Worker sleeps on this; bumped to wake it */
+    volatile bool stopping;
+    bool in_use;
+} io_rings[MAX_IO_RINGS];
+
+/* Operations map onto the syscalls that implement them */
+static const u16 io_ring_ops[IO_OP_COUNT] = {
+    [IO_OP_READ]   = SYS_READ,
+    [IO_OP_WRITE]  = SYS_WRITE,
+    [IO_OP_OPEN]   = SYS_OPEN,
+    [IO_OP_CLOSE]  = SYS_CLOSE,
+    [IO_OP_PIPE]   = SYS_PIPE,
+    [IO_OP_MSGSND] = SYS_MSGSND,
+    [IO_OP_MSGRCV] = SYS_MSGRCV,
+    [IO_OP_SPLICE] = SYS_SPLICE,
+};
+
+/* A ring address means something only in the process that set it up;
+ * another one may have anything mapped there */
+static struct io_ring_ctx* io_ring_ctx_of(struct io_ring* ring) {
+    u32 tgid = get_current_process()->tgid;
+    for (u32 i = 0; i < MAX_IO_RINGS; i++) {
+        if (io_rings[i].in_use && io_rings[i].ring == ring && io_rings[i].tgid == tgid) {
+            return &io_rings[i];
+        }
+    }
+    return NULL;
+}
+
+/* Take one snapshot of a user-writable SQE; everything after validates and
+ * dispatches from the copy, so a racing writer cannot change the opcode
+ * between the bounds check and the table lookup */
+static void io_ring_read_sqe(struct io_sqe* dst, const struct io_sqe* src) {
+    dst->opcode = __atomic_load_n(&src->opcode, __ATOMIC_RELAXED);
+    dst->flags = __atomic_load_n(&src->flags, __ATOMIC_RELAXED);
+    dst->user_data = __atomic_load_n(&src->user_data, __ATOMIC_RELAXED);
+    for (u32 i = 0; i < 6; i++) {
+        dst->args[i] = __atomic_load_n(&src->args[i], __ATOMIC_RELAXED);
+    }
+}
+
+static i64 io_ring_dispatch(const struct io_sqe* sqe) {
+    if (sqe->opcode == IO_OP_NOP) {
+        return 0;
+    }
+    if (sqe->opcode >= IO_OP_COUNT || !syscall_table[io_ring_ops[sqe->opcode]]) {
+        return -EINVAL;
+    }
+    
+    const u64* args = sqe->args;
+    return syscall_table[io_ring_ops[sqe->opcode]](args[0], args[1], args[2], args[3], args[4], args[5]);
+}
+
+/* Worker thread: shares the submitter's address space and files, so each
+ * operation runs exactly as the syscall would have. Drains everything
+ * submitted, then sleeps until io_ring_enter finds it idle. */
+static void io_ring_worker(void* arg) {
+    struct io_ring_ctx* ctx = (struct io_ring_ctx*)arg;
+    struct io_ring* ring = ctx->ring;
+    
+    while (!ctx->stopping) {
+        u32 head = ring->sq_head;
+        u32 tail = __atomic_load_n(&ring->sq_tail, __ATOMIC_ACQUIRE);
+        
+        if (head == tail) {
+            /* Advertise the sleep before the last look at the tail; a
+             * submitter that missed the flag is seen here */
+            u32 seq = ctx->wake_seq;
+            __sync_fetch_and_or(&ring->flags, IO_RING_NEED_WAKEUP);
+            if (ring->sq_tail == head && !ctx->stopping) {
+                futex_wait((u32*)&ctx->wake_seq, seq, 0);
+            }
+            __sync_fetch_and_and(&ring->flags, ~IO_RING_NEED_WAKEUP);
+            continue;
+        }
+        
+        u32 done = 0;
+        while (head != tail) {
+            u32 cq_tail = ring->cq_tail;
+            if (cq_tail - __atomic_load_n(&ring->cq_head, __ATOMIC_ACQUIRE) >= ctx->cq_entries) {
+                break;  /* Completion ring full */
+            }
+            
+            struct io_sqe sqe;
+            io_ring_read_sqe(&sqe, &ctx->sqes[head & ctx->sq_mask]);
+            struct io_cqe* cqe = &ctx->cqes[cq_tail & ctx->cq_mask];
+            cqe->user_data = sqe.user_data;
+            cqe->result = io_ring_dispatch(&sqe);
+            
+            __atomic_store_n(&ring->cq_tail, cq_tail + 1, __ATOMIC_RELEASE);
+            __atomic_store_n(&ring->sq_head, ++head, __ATOMIC_RELEASE);
+            done++;
+        }
+        
+        if (done) {
+            futex_wake((u32*)&ring->cq_tail, ~0U);
+        } else {
+            /* The process is not reaping; look again next tick */
+            futex_wait((u32*)&ring->cq_head, ring->cq_head, 1);
+        }
+    }
+    
+    shmdt(ring);
+    ctx->in_use = false;
+    process_exit(0);
+}
+
+/* Create a ring with entries submission slots (rounded up to a power of
+ * two) and twice as many completion slots, mapped into the caller */
+struct io_ring* io_ring_setup(u32 entries) {
+    if (entries == 0 || entries > IO_RING_MAX_ENTRIES) {
+        return NULL;
+    }
+    
+    struct io_ring_ctx* ctx = NULL;
+    for (u32 i = 0; i < MAX_IO_RINGS; i++) {
+        if (!io_rings[i].in_use) {
+            ctx = &io_rings[i];
+            break;
+        }
+    }
+    if (!ctx) {
+        return NULL;
+    }
+    
+    u32 sq_entries = 1;
+    while (sq_entries < entries) {
+        sq_entries <<= 1;
+    }
+    u32 cq_entries = sq_entries * 2;
+    u32 sqes_offset = sizeof(struct io_ring);
+    u32 cqes_offset = sqes_offset + sq_entries * sizeof(struct io_sqe);
+    u32 size = cqes_offset + cq_entries * sizeof(struct io_cqe);
+    
+    /* Private segment, removed at once: it goes away when the worker detaches */
+    i32 shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (shmid < 0) {
+        return NULL;
+    }
+    struct io_ring* ring = shmat(shmid, NULL, 0);
+    shmctl(shmid, IPC_RMID);
+    if (ring == (void*)-1) {
+        return NULL;
+    }
+    
+    memset(ring, 0, sizeof(struct io_ring));
+    ring->sq_entries = sq_entries;
+    ring->sq_mask = sq_entries - 1;
+    ring->cq_entries = cq_entries;
+    ring->cq_mask = cq_entries - 1;
+    ring->sqes_offset = sqes_offset;
+    ring->cqes_offset = cqes_offset;
+    
+    ctx->ring = ring;
+    ctx->sqes = io_ring_sqes(ring);
+    ctx->cqes = io_ring_cqes(ring);
+    ctx->sq_mask = sq_entries - 1;
+    ctx->cq_mask = cq_entries - 1;
+    ctx->cq_entries = cq_entries;
+    ctx->tgid = get_current_process()->tgid;
+    ctx->wake_seq = 0;
+    ctx->stopping = false;
+    ctx->in_use = true;
+    
+    i32 worker = process_clone(get_current_process(), CLONE_VM | CLONE_FILES | CLONE_THREAD,
+                               (void*)io_ring_worker, NULL, ctx);
+    if (worker < 0) {
+        ctx->in_use = false;
+        shmdt(ring);
+        return NULL;
+    }
+    ctx->worker_pid = worker;
+    
+    return ring;
+}
+
+/* Wake the worker if it is idle, then wait until at least min_complete
+ * completions are ready. Returns the number ready. */
+i32 io_ring_enter(struct io_ring* ring, u32 min_complete) {
+    struct io_ring_ctx* ctx = io_ring_ctx_of(ring);
+    if (!ctx || min_complete > ctx->cq_entries) {
+        return -EINVAL;
+    }
+    
+    if (ring->flags & IO_RING_NEED_WAKEUP) {
+        __sync_fetch_and_add(&ctx->wake_seq, 1);
+        futex_wake((u32*)&ctx->wake_seq, 1);
+    }
+    
+    u32 ready;
+    while ((ready = __atomic_load_n(&ring->cq_tail, __ATOMIC_ACQUIRE) - ring->cq_head) < min_complete) {
+        futex_wait((u32*)&ring->cq_tail, ring->cq_head + ready, 0);
+    }
+    return ready;
+}
+
+/* Stop the worker; it finishes the operation in hand, unmaps the ring and exits */
+i32 io_ring_destroy(struct io_ring* ring) {
+    struct io_ring_ctx* ctx = io_ring_ctx_of(ring);
+    if (!ctx || ctx->stopping) {
+        return -EINVAL;
+    }
+    
+    ctx->stopping = true;
+    __sync_fetch_and_add(&ctx->wake_seq, 1);
+    futex_wake((u32*)&ctx->wake_seq, 1);
+    return 0;
+}
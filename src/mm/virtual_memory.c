@@ -6,6 +6,7 @@
 #define PAGE_MASK 0xFFFFFFFFFFFFF000
 #define PAGE_OFFSET_MASK 0x0FFF
 #define PAGES_PER_TABLE 512
+#define PAGES_PER_HUGE_PAGE (HUGE_PAGE_SIZE / PAGE_SIZE)
 #define KERNEL_VIRTUAL_BASE 0xFFFFFFFF80000000
 #define USER_VIRTUAL_BASE 0x400000
 #define USER_STACK_TOP 0x7FFFFFFFFFFF
@@ -32,20 +33,18 @@ struct vma {
     u32 permissions;
     struct file* file;  /* For memory-mapped files */
     u64 file_offset;
+    vma_fault_t fault;  /* Supplies pages of shared mappings on demand */
+    vma_close_t close;  /* Tells the backing object the mapping is gone */
+    void* private;
     struct vma* next;
 };
 
-/* Memory mapping permissions */
-#define PROT_READ   0x1
-#define PROT_WRITE  0x2
-#define PROT_EXEC   0x4
-#define PROT_NONE   0x0
-
 /* Memory mapping flags */
 #define MAP_SHARED    0x01
 #define MAP_PRIVATE   0x02
 #define MAP_FIXED     0x10
 #define MAP_ANONYMOUS 0x20
+#define MAP_HUGETLB   0x40000  /* Mapped with 2 MB pages */
 
 /* Page table entry */
 typedef u64 pte_t;
@@ -71,6 +70,10 @@ struct memory_stats {
     u64 user_pages;
 };
 
+/* Page frame flags */
+#define FRAME_FREE 0x1  /* On the free list */
+#define FRAME_HUGE 0x2  /* First frame of a 2 MB page; holds its ref_count */
+
 /* Physical page frame */
 struct page_frame {
     u64 physical_addr;
@@ -87,6 +90,7 @@ static struct {
     u64 available_memory;
     struct memory_stats stats;
     bool paging_enabled;
+    pgd_t* kernel_pgd;          /* Boot tables, template for new address spaces */
 } mm_state;
 
 /* Swap management */
@@ -134,6 +138,7 @@ void pmm_init(void) {
         
         /* Add to free list if not reserved */
         if (!is_memory_reserved(frame->physical_addr)) {
+            frame->flags = FRAME_FREE;
             frame->next = mm_state.free_pages;
             mm_state.free_pages = frame;
             mm_state.stats.free_pages++;
@@ -154,6 +159,7 @@ u64 pmm_alloc_page(void) {
     mm_state.free_pages = frame->next;
     
     frame->ref_count = 1;
+    frame->flags &= ~FRAME_FREE;
     frame->next = NULL;
     
     mm_state.stats.free_pages--;
@@ -175,6 +181,7 @@ void pmm_free_page(u64 physical_addr) {
         
         if (frame->ref_count == 0) {
             /* Add back to free list */
+            frame->flags |= FRAME_FREE;
             frame->next = mm_state.free_pages;
             mm_state.free_pages = frame;
             
@@ -184,14 +191,77 @@ void pmm_free_page(u64 physical_addr) {
     }
 }
 
+/* Allocate a 2 MB aligned run of free frames. The free list is unordered,
+ * so this scans the frame array; it is meant for large, long-lived buffers. */
+u64 pmm_alloc_huge_page(void) {
+    struct page_frame* frames = mm_state.page_frames;
+    
+    for (u64 base = 0; base + PAGES_PER_HUGE_PAGE <= mm_state.stats.total_pages; base += PAGES_PER_HUGE_PAGE) {
+        u64 i = 0;
+        while (i < PAGES_PER_HUGE_PAGE && (frames[base + i].flags & FRAME_FREE)) {
+            i++;
+        }
+        if (i < PAGES_PER_HUGE_PAGE) {
+            continue;
+        }
+        
+        /* Claim the run, then drop it from the free list in one pass */
+        for (i = 0; i < PAGES_PER_HUGE_PAGE; i++) {
+            frames[base + i].flags &= ~FRAME_FREE;
+        }
+        struct page_frame** link = &mm_state.free_pages;
+        while (*link) {
+            if (!((*link)->flags & FRAME_FREE)) {
+                *link = (*link)->next;
+            } else {
+                link = &(*link)->next;
+            }
+        }
+        
+        frames[base].flags |= FRAME_HUGE;
+        frames[base].ref_count = 1;
+        mm_state.stats.free_pages -= PAGES_PER_HUGE_PAGE;
+        mm_state.stats.used_pages += PAGES_PER_HUGE_PAGE;
+        
+        memset((void*)frames[base].physical_addr, 0, HUGE_PAGE_SIZE);
+        return frames[base].physical_addr;
+    }
+    
+    return 0;
+}
+
+/* Drop a reference to a 2 MB page; the last one frees all its frames */
+void pmm_free_huge_page(u64 physical_addr) {
+    u64 base = physical_addr / PAGE_SIZE;
+    struct page_frame* head = &mm_state.page_frames[base];
+    
+    if (!(head->flags & FRAME_HUGE) || head->ref_count == 0 || --head->ref_count > 0) {
+        return;
+    }
+    
+    head->flags &= ~FRAME_HUGE;
+    for (u64 i = 0; i < PAGES_PER_HUGE_PAGE; i++) {
+        struct page_frame* frame = &mm_state.page_frames[base + i];
+        frame->flags |= FRAME_FREE;
+        frame->next = mm_state.free_pages;
+        mm_state.free_pages = frame;
+    }
+    mm_state.stats.free_pages += PAGES_PER_HUGE_PAGE;
+    mm_state.stats.used_pages -= PAGES_PER_HUGE_PAGE;
+}
+
+/* Take another reference on an allocated page */
+void pmm_page_get(u64 physical_addr) {
+    mm_state.page_frames[physical_addr / PAGE_SIZE].ref_count++;
+}
+
 /* Page Table Management */
 
-/* Get page table entry */
-pte_t* get_pte(pgd_t* pgd, u64 virtual_addr, bool create) {
+/* Get page directory entry (the level that maps 2 MB pages) */
+static pmd_t* get_pmd(pgd_t* pgd, u64 virtual_addr, bool create) {
     u64 pgd_index = (virtual_addr >> 39) & 0x1FF;
     u64 pud_index = (virtual_addr >> 30) & 0x1FF;
     u64 pmd_index = (virtual_addr >> 21) & 0x1FF;
-    u64 pte_index = (virtual_addr >> 12) & 0x1FF;
     
     /* Check PGD entry */
     if (!(pgd[pgd_index] & PAGE_PRESENT)) {
@@ -217,17 +287,29 @@ pte_t* get_pte(pgd_t* pgd, u64 virtual_addr, bool create) {
     
     pmd_t* pmd = (pmd_t*)(pud[pud_index] & PAGE_MASK);
     
+    return &pmd[pmd_index];
+}
+
+/* Get page table entry */
+pte_t* get_pte(pgd_t* pgd, u64 virtual_addr, bool create) {
+    u64 pte_index = (virtual_addr >> 12) & 0x1FF;
+    
+    pmd_t* pmd = get_pmd(pgd, virtual_addr, create);
+    if (!pmd || (*pmd & PAGE_SIZE_FLAG)) {
+        return NULL;  /* Covered by a 2 MB page, there is no PTE */
+    }
+    
     /* Check PMD entry */
-    if (!(pmd[pmd_index] & PAGE_PRESENT)) {
+    if (!(*pmd & PAGE_PRESENT)) {
         if (!create) return NULL;
         
         u64 pte_phys = pmm_alloc_page();
         if (!pte_phys) return NULL;
         
-        pmd[pmd_index] = pte_phys | PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER;
+        *pmd = pte_phys | PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER;
     }
     
-    pte_t* pte_table = (pte_t*)(pmd[pmd_index] & PAGE_MASK);
+    pte_t* pte_table = (pte_t*)(*pmd & PAGE_MASK);
     
     return &pte_table[pte_index];
 }
@@ -262,6 +344,164 @@ void unmap_page(pgd_t* pgd, u64 virtual_addr) {
     }
 }
 
+/* Map a 2 MB page; fails if 4 KB mappings already use that range */
+i32 map_huge_page(pgd_t* pgd, u64 virtual_addr, u64 physical_addr, u32 flags) {
+    pmd_t* pmd = get_pmd(pgd, virtual_addr, true);
+    if (!pmd || ((*pmd & PAGE_PRESENT) && !(*pmd & PAGE_SIZE_FLAG))) {
+        return -1;
+    }
+    
+    *pmd = physical_addr | flags | PAGE_SIZE_FLAG;
+    
+    /* Invalidate TLB entry */
+    __asm__ volatile ("invlpg (%0)" :: "r" (virtual_addr) : "memory");
+    
+    return 0;
+}
+
+/* Unmap a 2 MB page */
+void unmap_huge_page(pgd_t* pgd, u64 virtual_addr) {
+    pmd_t* pmd = get_pmd(pgd, virtual_addr, false);
+    if (pmd && (*pmd & PAGE_PRESENT) && (*pmd & PAGE_SIZE_FLAG)) {
+        u64 physical_addr = *pmd & PAGE_MASK & ~(u64)(HUGE_PAGE_SIZE - 1);
+        *pmd = 0;
+        
+        pmm_free_huge_page(physical_addr);
+        
+        /* Invalidate TLB entry */
+        __asm__ volatile ("invlpg (%0)" :: "r" (virtual_addr) : "memory");
+    }
+}
+
+/* Physical address of a page directory, as loaded into CR3 */
+u64 vmm_page_directory_phys(struct page_directory* pd) {
+    return pd->physical_addr;
+}
+
+/* Copy one low-half PML4 slot of the kernel tables. The identity map shares
+ * these slots with user space, so the directory levels are made private and
+ * only the kernel's leaf entries are shared. */
+static bool copy_kernel_pgd_entry(pgd_t* pgd, u32 index) {
+    u64 pud_phys = pmm_alloc_page();
+    if (!pud_phys) {
+        return false;
+    }
+    pgd[index] = pud_phys | PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER;
+    
+    pud_t* kernel_pud = (pud_t*)(mm_state.kernel_pgd[index] & PAGE_MASK);
+    pud_t* pud = (pud_t*)pud_phys;
+    for (u32 i = 0; i < PAGES_PER_TABLE; i++) {
+        if (!(kernel_pud[i] & PAGE_PRESENT) || (kernel_pud[i] & PAGE_SIZE_FLAG)) {
+            pud[i] = kernel_pud[i];
+            continue;
+        }
+    
+        u64 pmd_phys = pmm_alloc_page();
+        if (!pmd_phys) {
+            return false;
+        }
+        memcpy((void*)pmd_phys, (void*)(kernel_pud[i] & PAGE_MASK), PAGE_SIZE);
+        pud[i] = pmd_phys | PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER;
+    }
+    
+    return true;
+}
+
+/* Create an address space holding only the kernel mappings */
+struct page_directory* vmm_create_page_directory(void) {
+    /* The tables the kernel booted on are the template */
+    if (!mm_state.kernel_pgd) {
+        u64 cr3;
+        __asm__ volatile ("mov %%cr3, %0" : "=r"(cr3));
+        mm_state.kernel_pgd = (pgd_t*)(cr3 & PAGE_MASK);
+    }
+    
+    struct page_directory* pd = (struct page_directory*)kmalloc(sizeof(struct page_directory));
+    if (!pd) {
+        return NULL;
+    }
+    
+    u64 pgd_phys = pmm_alloc_page();
+    if (!pgd_phys) {
+        kfree(pd);
+        return NULL;
+    }
+    pd->pgd = (pgd_t*)pgd_phys;
+    pd->physical_addr = pgd_phys;
+    pd->ref_count = 1;
+    
+    /* The upper half belongs to the kernel alone and is shared as is */
+    for (u32 i = PAGES_PER_TABLE / 2; i < PAGES_PER_TABLE; i++) {
+        pd->pgd[i] = mm_state.kernel_pgd[i];
+    }
+    
+    for (u32 i = 0; i < PAGES_PER_TABLE / 2; i++) {
+        if ((mm_state.kernel_pgd[i] & PAGE_PRESENT) && !copy_kernel_pgd_entry(pd->pgd, i)) {
+            vmm_destroy_page_directory(pd);
+            return NULL;
+        }
+    }
+    
+    return pd;
+}
+
+/* Free an address space: drop the pages still mapped in the user half and
+ * every table not shared with the kernel */
+void vmm_destroy_page_directory(struct page_directory* pd) {
+    pgd_t* kernel_pgd = mm_state.kernel_pgd;
+    
+    /* Never free the tables the CPU is walking */
+    u64 cr3;
+    __asm__ volatile ("mov %%cr3, %0" : "=r"(cr3));
+    if ((cr3 & PAGE_MASK) == pd->physical_addr) {
+        __asm__ volatile ("mov %0, %%cr3" :: "r"((u64)kernel_pgd) : "memory");
+    }
+    
+    for (u32 i = 0; i < PAGES_PER_TABLE / 2; i++) {
+        if (!(pd->pgd[i] & PAGE_PRESENT)) {
+            continue;
+        }
+        pud_t* pud = (pud_t*)(pd->pgd[i] & PAGE_MASK);
+        pud_t* kernel_pud = (kernel_pgd[i] & PAGE_PRESENT) ? (pud_t*)(kernel_pgd[i] & PAGE_MASK) : NULL;
+    
+        for (u32 j = 0; j < PAGES_PER_TABLE; j++) {
+            if (!(pud[j] & PAGE_PRESENT) || (pud[j] & PAGE_SIZE_FLAG)) {
+                continue;
+            }
+            pmd_t* pmd = (pmd_t*)(pud[j] & PAGE_MASK);
+            pmd_t* kernel_pmd = NULL;
+            if (kernel_pud && (kernel_pud[j] & PAGE_PRESENT) && !(kernel_pud[j] & PAGE_SIZE_FLAG)) {
+                kernel_pmd = (pmd_t*)(kernel_pud[j] & PAGE_MASK);
+            }
+    
+            for (u32 k = 0; k < PAGES_PER_TABLE; k++) {
+                /* Entries copied from the kernel may have gained A/D bits; compare addresses */
+                if (!(pmd[k] & PAGE_PRESENT) ||
+                    (kernel_pmd && (kernel_pmd[k] & PAGE_MASK) == (pmd[k] & PAGE_MASK))) {
+                    continue;
+                }
+                if (pmd[k] & PAGE_SIZE_FLAG) {
+                    pmm_free_huge_page(pmd[k] & PAGE_MASK & ~(u64)(HUGE_PAGE_SIZE - 1));
+                    continue;
+                }
+    
+                pte_t* pte_table = (pte_t*)(pmd[k] & PAGE_MASK);
+                for (u32 l = 0; l < PAGES_PER_TABLE; l++) {
+                    if (pte_table[l] & PAGE_PRESENT) {
+                        pmm_free_page(pte_table[l] & PAGE_MASK);
+                    }
+                }
+                pmm_free_page((u64)pte_table);
+            }
+            pmm_free_page((u64)pmd);
+        }
+        pmm_free_page((u64)pud);
+    }
+    
+    pmm_free_page(pd->physical_addr);
+    kfree(pd);
+}
+
 /* Virtual Memory Areas (VMAs) */
 
 /* Create new VMA */
@@ -277,14 +517,29 @@ struct vma* vma_create(u64 start, u64 end, u32 permissions, u32 flags) {
     vma->flags = flags;
     vma->file = NULL;
     vma->file_offset = 0;
+    vma->fault = NULL;
+    vma->close = NULL;
+    vma->private = NULL;
     vma->next = NULL;
     
     return vma;
 }
 
+/* Free a whole VMA list; the pages behind it go with the page tables */
+void vma_free_list(struct vma* vma) {
+    while (vma) {
+        struct vma* next = vma->next;
+        if (vma->close) {
+            vma->close(vma->private);
+        }
+        kfree(vma);
+        vma = next;
+    }
+}
+
 /* Find VMA containing address */
 struct vma* vma_find(struct process* proc, u64 addr) {
-    struct vma* vma = proc->vma_list;
+    struct vma* vma = proc->mm->vma_list;
     
     while (vma) {
         if (addr >= vma->start && addr < vma->end) {
@@ -296,6 +551,83 @@ struct vma* vma_find(struct process* proc, u64 addr) {
     return NULL;
 }
 
+/* Share the current process's page at vaddr with the kernel (e.g. a pipe):
+ * a writable mapping becomes copy-on-write so later stores by the process
+ * cannot change what the holder sees. Returns the physical page with a new
+ * reference taken, or 0 if nothing is mapped there. */
+u64 vmm_share_user_page(u64 vaddr) {
+    struct process* current = get_current_process();
+    pte_t* pte = get_pte(current->mm->page_directory->pgd, vaddr, false);
+    if (!pte || (*pte & (PAGE_PRESENT | PAGE_USER)) != (PAGE_PRESENT | PAGE_USER)) {
+        return 0;
+    }
+    
+    if (*pte & PAGE_WRITABLE) {
+        *pte = (*pte & ~(u64)PAGE_WRITABLE) | PAGE_COW;
+        __asm__ volatile ("invlpg (%0)" :: "r" (vaddr) : "memory");
+    }
+    
+    u64 physical_addr = *pte & PAGE_MASK;
+    pmm_page_get(physical_addr);
+    return physical_addr;
+}
+
+/* Map a shared page copy-on-write at vaddr in the current process, replacing
+ * whatever was there. The caller's reference passes to the mapping. Only
+ * writable areas qualify, since the alternative would have been a copy. */
+i32 vmm_map_cow_page(u64 vaddr, u64 physical_addr) {
+    struct process* current = get_current_process();
+    struct vma* vma = vma_find(current, vaddr);
+    if (!vma || !(vma->permissions & PROT_WRITE)) {
+        return -1;
+    }
+    
+    pte_t* pte = get_pte(current->mm->page_directory->pgd, vaddr, true);
+    if (!pte) {
+        return -1;
+    }
+    
+    if (*pte & PAGE_PRESENT) {
+        pmm_free_page(*pte & PAGE_MASK);
+    }
+    
+    *pte = physical_addr | PAGE_PRESENT | PAGE_USER | PAGE_COW;
+    __asm__ volatile ("invlpg (%0)" :: "r" (vaddr) : "memory");
+    
+    return 0;
+}
+
+/* Physical address behind vaddr in the current process, or 0 if the user
+ * page is not mapped. Addresses outside any VMA are kernel memory, which is
+ * identity-mapped. */
+u64 vmm_virt_to_phys(u64 vaddr) {
+    struct process* current = get_current_process();
+    if (!current || !current->mm->page_directory || !vma_find(current, vaddr)) {
+        return vaddr;
+    }
+    
+    pte_t* pte = get_pte(current->mm->page_directory->pgd, vaddr, false);
+    if (!pte || !(*pte & PAGE_PRESENT)) {
+        return 0;
+    }
+    return (*pte & PAGE_MASK) | (vaddr & PAGE_OFFSET_MASK);
+}
+
+/* Whether [addr, addr + size) lies inside one mapping of the current
+ * process that allows the access; checked before the kernel writes user stacks */
+bool vmm_access_ok(u64 addr, u64 size, bool write) {
+    struct process* current = get_current_process();
+    if (!current || addr + size < addr) {
+        return false;
+    }
+    
+    struct vma* vma = vma_find(current, addr);
+    if (!vma || addr + size > vma->end) {
+        return false;
+    }
+    return !write || (vma->permissions & PROT_WRITE);
+}
+
 /* Memory Mapping */
 
 /* Map memory region */
@@ -330,8 +662,8 @@ void* mmap(void* addr, size_t length, i32 prot, i32 flags, i32 fd, off_t offset)
     }
     
     /* Add to process VMA list */
-    vma->next = current->vma_list;
-    current->vma_list = vma;
+    vma->next = current->mm->vma_list;
+    current->mm->vma_list = vma;
     
     /* Map pages */
     for (u64 vaddr = start_addr; vaddr < start_addr + aligned_length; vaddr += PAGE_SIZE) {
@@ -345,7 +677,7 @@ void* mmap(void* addr, size_t length, i32 prot, i32 flags, i32 fd, off_t offset)
         u32 page_flags = PAGE_PRESENT | PAGE_USER;
         if (prot & PROT_WRITE) page_flags |= PAGE_WRITABLE;
         
-        map_page(current->page_directory->pgd, vaddr, paddr, page_flags);
+        map_page(current->mm->page_directory->pgd, vaddr, paddr, page_flags);
     }
     
     return (void*)start_addr;
@@ -363,23 +695,32 @@ i32 munmap(void* addr, size_t length) {
     
     /* Find and remove VMAs */
     struct vma* prev = NULL;
-    struct vma* vma = current->vma_list;
+    struct vma* vma = current->mm->vma_list;
     
     while (vma) {
         if (vma->start >= start_addr && vma->end <= end_addr) {
             /* Unmap pages */
-            for (u64 vaddr = vma->start; vaddr < vma->end; vaddr += PAGE_SIZE) {
-                unmap_page(current->page_directory->pgd, vaddr);
+            if (vma->flags & MAP_HUGETLB) {
+                for (u64 vaddr = vma->start; vaddr < vma->end; vaddr += HUGE_PAGE_SIZE) {
+                    unmap_huge_page(current->mm->page_directory->pgd, vaddr);
+                }
+            } else {
+                for (u64 vaddr = vma->start; vaddr < vma->end; vaddr += PAGE_SIZE) {
+                    unmap_page(current->mm->page_directory->pgd, vaddr);
+                }
             }
             
             /* Remove from list */
             if (prev) {
                 prev->next = vma->next;
             } else {
-                current->vma_list = vma->next;
+                current->mm->vma_list = vma->next;
             }
             
             struct vma* next = vma->next;
+            if (vma->close) {
+                vma->close(vma->private);
+            }
             kfree(vma);
             vma = next;
         } else {
@@ -391,6 +732,60 @@ i32 munmap(void* addr, size_t length) {
     return 0;
 }
 
+/* Map a shared object into the current process, populated lazily through
+ * fault. addr 0 picks a free range; huge mappings are 2 MB aligned. */
+void* vmm_map_shared(u64 addr, u64 size, u32 prot, bool huge, vma_fault_t fault,
+                     vma_close_t close, void* private) {
+    struct process* current = get_current_process();
+    if (!current || !current->mm->page_directory) {
+        return NULL;  /* Kernel threads have no address space of their own */
+    }
+    
+    u64 align = huge ? HUGE_PAGE_SIZE : PAGE_SIZE;
+    size = (size + align - 1) & ~(align - 1);
+    
+    if (!addr) {
+        addr = find_free_vma_space(current, size + align - PAGE_SIZE);
+        if (!addr) {
+            return NULL;
+        }
+        addr = (addr + align - 1) & ~(align - 1);
+    } else if (addr & (align - 1)) {
+        return NULL;
+    }
+    
+    struct vma* vma = vma_create(addr, addr + size, prot, MAP_SHARED | (huge ? MAP_HUGETLB : 0));
+    if (!vma) {
+        return NULL;
+    }
+    vma->fault = fault;
+    vma->close = close;
+    vma->private = private;
+    
+    vma->next = current->mm->vma_list;
+    current->mm->vma_list = vma;
+    
+    return (void*)addr;
+}
+
+/* Undo vmm_map_shared at addr (running its close hook); returns the
+ * mapping's private pointer, or NULL */
+void* vmm_unmap_shared(u64 addr) {
+    struct process* current = get_current_process();
+    if (!current || !current->mm->page_directory) {
+        return NULL;
+    }
+    
+    struct vma* vma = vma_find(current, addr);
+    if (!vma || vma->start != addr || !vma->fault) {
+        return NULL;
+    }
+    
+    void* private = vma->private;
+    munmap((void*)vma->start, vma->end - vma->start);
+    return private;
+}
+
 /* Page Fault Handler */
 void page_fault_handler(u64 fault_addr, u32 error_code) {
     struct process* current = get_current_process();
@@ -413,8 +808,32 @@ void page_fault_handler(u64 fault_addr, u32 error_code) {
         return;
     }
     
+    /* Shared mappings are populated from their backing object */
+    if (vma->fault) {
+        u64 page_size = PAGE_SIZE;
+        u64 physical_page = vma->fault(vma->private, fault_addr - vma->start, &page_size);
+        if (!physical_page) {
+            signal_send(current->pid, SIGKILL);
+            return;
+        }
+        
+        u64 page_addr = fault_addr & ~(page_size - 1);
+        u32 flags = PAGE_PRESENT | PAGE_USER;
+        if (vma->permissions & PROT_WRITE) flags |= PAGE_WRITABLE;
+        
+        if (page_size == HUGE_PAGE_SIZE) {
+            if (map_huge_page(current->mm->page_directory->pgd, page_addr, physical_page, flags) < 0) {
+                pmm_free_huge_page(physical_page);
+                signal_send(current->pid, SIGBUS);
+            }
+        } else {
+            map_page(current->mm->page_directory->pgd, page_addr, physical_page, flags);
+        }
+        return;
+    }
+    
     /* Handle copy-on-write */
-    pte_t* pte = get_pte(current->page_directory->pgd, fault_addr, false);
+    pte_t* pte = get_pte(current->mm->page_directory->pgd, fault_addr, false);
     if (pte && (*pte & PAGE_COW)) {
         handle_cow_fault(fault_addr, pte);
         return;
@@ -438,12 +857,20 @@ void page_fault_handler(u64 fault_addr, u32 error_code) {
     u32 flags = PAGE_PRESENT | PAGE_USER;
     if (vma->permissions & PROT_WRITE) flags |= PAGE_WRITABLE;
     
-    map_page(current->page_directory->pgd, page_addr, physical_page, flags);
+    map_page(current->mm->page_directory->pgd, page_addr, physical_page, flags);
 }
 
 /* Copy-on-Write handling */
 void handle_cow_fault(u64 fault_addr, pte_t* pte) {
     u64 old_physical = *pte & PAGE_MASK;
+    
+    /* Last reference (e.g. a spliced page the pipe has released): reuse it */
+    if (mm_state.page_frames[old_physical / PAGE_SIZE].ref_count == 1) {
+        *pte = old_physical | PAGE_PRESENT | PAGE_WRITABLE | PAGE_USER;
+        __asm__ volatile ("invlpg (%0)" :: "r" (fault_addr) : "memory");
+        return;
+    }
+    
     u64 new_physical = pmm_alloc_page();
     
     if (!new_physical) {
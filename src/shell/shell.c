@@ -16,6 +16,10 @@ static void cmd_halt(void);
 static void cmd_meminfo(void);
 static void cmd_uptime(void);
 static void cmd_echo(char* args);
+static void cmd_cgroup(char* args);
+static void cmd_schedlat(char* args);
+static void cmd_taskset(char* args);
+static void cmd_irqlat(char* args);
 
 /* Command structure */
 struct command {
@@ -33,6 +37,10 @@ static struct command commands[] = {
     {"meminfo", "Show memory information", (void(*)(char*))cmd_meminfo},
     {"uptime", "Show system uptime", (void(*)(char*))cmd_uptime},
     {"echo", "Echo arguments", cmd_echo},
+    {"cgroup", "Manage CPU bandwidth groups", cmd_cgroup},
+    {"schedlat", "Show scheduling latency histogram", cmd_schedlat},
+    {"taskset", "Show or set a task's CPU affinity", cmd_taskset},
+    {"irqlat", "Show interrupt latency per IRQ line", cmd_irqlat},
     {"gui", "Start graphical user interface", (void(*)(char*))cmd_gui},
     {"desktop", "Launch desktop environment", (void(*)(char*))cmd_desktop},
     {"demo", "Show GUI demo", (void(*)(char*))cmd_gui_demo},
@@ -163,7 +171,7 @@ static void cmd_meminfo(void) {
 
 static void cmd_uptime(void) {
     u64 uptime = get_uptime();
-    vga_printf("System uptime: %d seconds\n", uptime);
+    vga_printf("System uptime: %d seconds\n", (u32)uptime);
 }
 
 static void cmd_echo(char* args) {
@@ -204,3 +212,278 @@ static void cmd_gui_demo(void) {
 
     gui_show_demo();
 }
+
+/* vga_printf has no field widths, so table columns are padded by hand */
+static void shell_put_padded(const char* str, u32 width, bool left) {
+    u32 len = strlen(str);
+    
+    if (!left) {
+        for (u32 i = len; i < width; i++) {
+            vga_putchar(' ');
+        }
+    }
+    vga_puts(str);
+    if (left) {
+        for (u32 i = len; i < width; i++) {
+            vga_putchar(' ');
+        }
+    }
+}
+
+/* Format a u64 in decimal; %d would truncate it to int */
+static const char* shell_format_u64(u64 value, char buffer[24]) {
+    char* ptr = buffer + 23;
+    *ptr = '\0';
+    do {
+        *--ptr = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+    return ptr;
+}
+
+static void shell_put_u64(u64 value, u32 width, bool left) {
+    char buffer[24];
+    shell_put_padded(shell_format_u64(value, buffer), width, left);
+}
+
+/* cgroup list | create <name> [parent] [shares] | destroy <id> |
+ * shares <id> <n> | quota <id> <quota_us> [period_us] | attach <id> <pid> */
+static void cmd_cgroup(char* args) {
+    char* sub = args ? strtok(args, " ") : NULL;
+    
+    if (!sub || strcmp(sub, "list") == 0) {
+        struct process_stats stats;
+        get_process_stats(&stats);
+        
+        vga_puts("  ID PARENT NAME             SHARES TASKS    QUOTA/PERIOD us      USAGE us  THROTTLED\n");
+        for (u32 i = 0; i < stats.group_count; i++) {
+            struct task_group_stats* gs = &stats.groups[i];
+            shell_put_u64(gs->id, 4, false);
+            vga_putchar(' ');
+            shell_put_u64(gs->parent_id, 6, false);
+            vga_putchar(' ');
+            shell_put_padded(gs->name, 16, true);
+            vga_putchar(' ');
+            shell_put_u64(gs->shares, 6, false);
+            vga_putchar(' ');
+            shell_put_u64(gs->nr_tasks, 5, false);
+            vga_putchar(' ');
+            shell_put_u64(gs->quota_us, 8, false);
+            vga_putchar('/');
+            shell_put_u64(gs->period_us, 8, true);
+            vga_putchar(' ');
+            shell_put_u64(gs->usage_us, 12, false);
+            vga_puts("  ");
+            shell_put_u64(gs->nr_throttled, 0, false);
+            vga_puts(gs->throttled ? " *\n" : "\n");
+        }
+        return;
+    }
+    
+    char* a1 = strtok(NULL, " ");
+    char* a2 = strtok(NULL, " ");
+    char* a3 = strtok(NULL, " ");
+    i32 result = -1;
+    
+    /* Shares are a weight and quotas a duration: neither may be negative */
+    if ((strcmp(sub, "create") == 0 && a3 && atoi(a3) <= 0) ||
+        (strcmp(sub, "shares") == 0 && a2 && atoi(a2) <= 0)) {
+        vga_puts("cgroup: shares must be a positive number\n");
+        return;
+    }
+    if (strcmp(sub, "quota") == 0 && ((a2 && atoi(a2) < 0) || (a3 && atoi(a3) < 0))) {
+        vga_puts("cgroup: quota and period must not be negative\n");
+        return;
+    }
+    
+    if (strcmp(sub, "create") == 0 && a1) {
+        result = task_group_create(a1, a2 ? atoi(a2) : 0, a3 ? atoi(a3) : 0);
+        if (result >= 0) {
+            vga_printf("Created group %d\n", result);
+            return;
+        }
+    } else if (strcmp(sub, "destroy") == 0 && a1) {
+        result = task_group_destroy(atoi(a1));
+    } else if (strcmp(sub, "shares") == 0 && a1 && a2) {
+        result = task_group_set_shares(atoi(a1), atoi(a2));
+    } else if (strcmp(sub, "quota") == 0 && a1 && a2) {
+        result = task_group_set_bandwidth(atoi(a1), atoi(a2), a3 ? atoi(a3) : 0);
+    } else if (strcmp(sub, "attach") == 0 && a1 && a2) {
+        result = task_group_attach(atoi(a2), atoi(a1));
+    } else {
+        vga_puts("Usage: cgroup list | create <name> [parent] [shares] | destroy <id>\n");
+        vga_puts("       cgroup shares <id> <n> | quota <id> <quota_us> [period_us] | attach <id> <pid>\n");
+        return;
+    }
+    
+    if (result < 0) {
+        vga_printf("cgroup: %s failed\n", sub);
+    }
+}
+
+/* Log2 latency histogram: bucket i starts at 2^i ns, bars scaled to the fullest */
+static void print_latency_histogram(const u64* buckets, u32 nr_buckets) {
+    u64 peak = 0;
+    for (u32 i = 0; i < nr_buckets; i++) {
+        if (buckets[i] > peak) {
+            peak = buckets[i];
+        }
+    }
+    
+    for (u32 i = 0; i < nr_buckets; i++) {
+        if (buckets[i] == 0) {
+            continue;
+        }
+    
+        shell_put_u64(1ULL << i, 10, false);
+        vga_puts(" ns ");
+        shell_put_u64(buckets[i], 8, false);
+        vga_puts(" |");
+        u32 width = (u32)((buckets[i] * 40) / peak);
+        for (u32 j = 0; j < width; j++) {
+            vga_putchar('#');
+        }
+        vga_putchar('\n');
+    }
+}
+
+/* schedlat [pid] | reset - wake-to-run delay histogram, global or per task */
+static void cmd_schedlat(char* args) {
+    char* arg = args ? strtok(args, " ") : NULL;
+    struct sched_latency_stats stats;
+    
+    if (arg && strcmp(arg, "reset") == 0) {
+        sched_reset_latency_stats();
+        vga_puts("Scheduling latency statistics cleared\n");
+        return;
+    }
+    
+    if (arg) {
+        if (sched_get_task_latency(atoi(arg), &stats) < 0) {
+            vga_printf("schedlat: no such pid %s\n", arg);
+            return;
+        }
+    } else {
+        sched_get_latency_stats(&stats);
+    }
+    
+    if (stats.count == 0) {
+        vga_puts("No wakeups recorded\n");
+        return;
+    }
+    
+    vga_puts("Wakeups: ");
+    shell_put_u64(stats.count, 0, false);
+    vga_puts("  avg: ");
+    shell_put_u64(stats.total_ns / stats.count, 0, false);
+    vga_puts(" ns  max: ");
+    shell_put_u64(stats.max_ns, 0, false);
+    vga_puts(" ns\np50: ");
+    shell_put_u64(sched_latency_percentile(&stats, 5000), 0, false);
+    vga_puts(" ns  p99: ");
+    shell_put_u64(sched_latency_percentile(&stats, 9900), 0, false);
+    vga_puts(" ns  p99.9: ");
+    shell_put_u64(sched_latency_percentile(&stats, 9990), 0, false);
+    vga_puts(" ns\n");
+    
+    print_latency_histogram(stats.buckets, SCHED_LAT_BUCKETS);
+}
+
+/* irqlat [irq] | reset - interrupt latency summary, or one line's histogram */
+static void cmd_irqlat(char* args) {
+    char* arg = args ? strtok(args, " ") : NULL;
+    struct irq_latency_stats stats;
+    
+    if (arg && strcmp(arg, "reset") == 0) {
+        irq_reset_latency_stats();
+        vga_puts("Interrupt latency statistics cleared\n");
+        return;
+    }
+    
+    u64 budget = irq_get_latency_budget();
+    
+    if (!arg) {
+        vga_puts("Budget: ");
+        shell_put_u64(budget, 0, false);
+        vga_puts(" ns\n");
+        for (u32 irq = 0; irq < IRQ_LINES; irq++) {
+            irq_get_latency_stats(irq, &stats);
+            if (stats.count == 0) {
+                continue;
+            }
+            vga_printf("IRQ%d", irq);
+            vga_puts(irq < 10 ? "  " : " ");
+            shell_put_u64(stats.count, 8, false);
+            vga_puts(" irqs  min ");
+            shell_put_u64(stats.min_ns, 6, false);
+            vga_puts("  avg ");
+            shell_put_u64(stats.total_ns / stats.count, 6, false);
+            vga_puts("  max ");
+            shell_put_u64(stats.max_ns, 6, false);
+            vga_puts(" ns  over ");
+            shell_put_u64(stats.over_budget, 0, false);
+            vga_putchar('\n');
+        }
+        return;
+    }
+    
+    if (irq_get_latency_stats(atoi(arg), &stats) < 0 || stats.count == 0) {
+        vga_printf("irqlat: no samples for IRQ %s\n", arg);
+        return;
+    }
+    
+    vga_printf("IRQ%s: ", arg);
+    shell_put_u64(stats.count, 0, false);
+    vga_puts(" irqs  min: ");
+    shell_put_u64(stats.min_ns, 0, false);
+    vga_puts(" ns  avg: ");
+    shell_put_u64(stats.total_ns / stats.count, 0, false);
+    vga_puts(" ns  max: ");
+    shell_put_u64(stats.max_ns, 0, false);
+    vga_puts(" ns\n");
+    
+    print_latency_histogram(stats.buckets, IRQ_LAT_BUCKETS);
+}
+
+/* taskset <pid> [hexmask] - show or set CPU affinity */
+static void cmd_taskset(char* args) {
+    char* pid_str = args ? strtok(args, " ") : NULL;
+    char* mask_str = strtok(NULL, " ");
+    
+    if (!pid_str) {
+        vga_puts("Usage: taskset <pid> [hexmask]\n");
+        return;
+    }
+    
+    u32 pid = atoi(pid_str);
+    u64 mask = 0;
+    
+    if (mask_str) {
+        if (mask_str[0] == '0' && (mask_str[1] == 'x' || mask_str[1] == 'X')) {
+            mask_str += 2;
+        }
+        for (char* c = mask_str; *c; c++) {
+            u32 digit;
+            if (*c >= '0' && *c <= '9') digit = *c - '0';
+            else if (*c >= 'a' && *c <= 'f') digit = *c - 'a' + 10;
+            else if (*c >= 'A' && *c <= 'F') digit = *c - 'A' + 10;
+            else {
+                vga_printf("taskset: bad mask %s\n", mask_str);
+                return;
+            }
+            mask = (mask << 4) | digit;
+        }
+    
+        if (sched_setaffinity(pid, mask) < 0) {
+            vga_puts("taskset: failed (no such pid or no online CPU in mask)\n");
+            return;
+        }
+    }
+    
+    if (sched_getaffinity(pid, &mask) < 0) {
+        vga_printf("taskset: no such pid %d\n", pid);
+        return;
+    }
+    vga_printf("pid %d affinity mask: 0x%x (housekeeping 0x%x)\n",
+              pid, mask, sched_housekeeping_mask());
+}
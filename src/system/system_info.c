@@ -129,7 +129,7 @@ void system_info_init(void) {
     strcpy(sys_info.hostname, "kronos-desktop");
     strcpy(sys_info.username, "user");
     
-    sys_info.boot_time = get_system_time() - 172800000000ULL; /* 2 days ago */
+    sys_info.boot_time = 0;  /* The monotonic clock counts from clocksource_init */
     
     /* Initialize CPU information */
     init_cpu_info();
@@ -295,7 +295,8 @@ void system_info_update(void) {
     if (!info_initialized) return;
     
     /* Update uptime */
-    sys_info.uptime = (get_system_time() - sys_info.boot_time) / 1000000; /* Convert to seconds */
+    u64 now = get_system_time();
+    sys_info.uptime = now > sys_info.boot_time ? (now - sys_info.boot_time) / 1000000 : 0; /* Convert to seconds */
     
     /* Update CPU usage (simulated) */
     sys_info.cpu.usage_percent = 10.0f + (rand() % 30);
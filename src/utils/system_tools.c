@@ -7,8 +7,7 @@ void cmd_ps(char* args) {
     vga_puts("  PID  PPID STAT  TIME COMMAND\n");
     vga_puts("===== ===== ===== ===== =======\n");
     
-    for (u32 i = 0; i < MAX_PROCESSES; i++) {
-        struct process* proc = &processes[i];
+    for (struct process* proc = task_list; proc; proc = proc->task_next) {
         if (proc->in_use) {
             char state_char;
             switch (proc->state) {
@@ -19,10 +18,10 @@ void cmd_ps(char* args) {
                 default: state_char = '?'; break;
             }
             
-            u64 cpu_time_sec = proc->total_cpu_time / 1000000;
+            u64 cpu_time_sec = proc->total_cpu_time / 1000000000ULL;
             vga_printf("%5d %5d   %c   %3d %s\n", 
                       proc->pid, proc->ppid, state_char, 
-                      cpu_time_sec, proc->name);
+                      (u32)cpu_time_sec, proc->name);
         }
     }
 }
@@ -74,15 +73,15 @@ void cmd_top(char* args) {
                   stats.total_processes, stats.running_processes);
         vga_printf("Memory: %d KB total, %d KB used, %d KB free\n",
                   mem_stats.total / 1024, mem_stats.used / 1024, mem_stats.free / 1024);
-        vga_printf("Uptime: %d seconds\n\n", get_uptime());
+        vga_printf("Uptime: %d seconds\n\n", (u32)get_uptime());
         
         /* Process list header */
         vga_puts("  PID USER     %CPU %MEM    VSZ   RSS STAT COMMAND\n");
         vga_puts("===== ======== ==== ==== ====== ===== ==== =======\n");
         
         /* Process list */
-        for (u32 i = 0; i < MAX_PROCESSES && i < 15; i++) {
-            struct process* proc = &processes[i];
+        u32 shown = 0;
+        for (struct process* proc = task_list; proc && shown < 15; proc = proc->task_next, shown++) {
             if (proc->in_use) {
                 char state_char;
                 switch (proc->state) {
@@ -93,15 +92,16 @@ void cmd_top(char* args) {
                     default: state_char = '?'; break;
                 }
                 
-                u32 cpu_percent = (proc->total_cpu_time * 100) / get_uptime();
+                u64 uptime_ns = clock_monotonic_ns();
+                u32 cpu_percent = uptime_ns ? (u32)((proc->total_cpu_time * 100) / uptime_ns) : 0;
                 if (cpu_percent > 100) cpu_percent = 100;
                 
-                u32 mem_percent = (proc->virtual_memory_size * 100) / mem_stats.total;
+                u32 mem_percent = (proc->mm->virtual_memory_size * 100) / mem_stats.total;
                 
                 vga_printf("%5d %-8s %3d%% %3d%% %6d %5d  %c   %s\n",
                           proc->pid, "user", cpu_percent, mem_percent,
-                          proc->virtual_memory_size / 1024,
-                          proc->virtual_memory_size / 1024,
+                          proc->mm->virtual_memory_size / 1024,
+                          proc->mm->virtual_memory_size / 1024,
                           state_char, proc->name);
             }
         }